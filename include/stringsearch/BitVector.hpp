@@ -0,0 +1,43 @@
+#pragma once
+#include "Definitions.hpp"
+#include "Storage.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace stringsearch {
+	// Bits with rank support. Stores the number of ones before every block of 512 bits, 12.5% on top of the bits.
+	class BitVector {
+		Storage<std::uint64_t> words_;
+		Storage<std::uint64_t> ranks_;
+		size_t size_ = 0;
+
+	public:
+		static constexpr size_t WordBits = 64;
+		static constexpr size_t BlockWords = 8;
+
+		BitVector() noexcept = default;
+		// Takes the bits of size bits, the unused bits of the last word have to be 0
+		BitVector(std::vector<std::uint64_t> words, size_t size);
+		BitVector(Storage<std::uint64_t> words, Storage<std::uint64_t> ranks, size_t size) noexcept;
+
+		[[nodiscard]] static size_t WordCount(size_t size) noexcept { return (size + WordBits - 1) / WordBits; }
+
+		[[nodiscard]] static size_t RankCount(size_t size) noexcept { return WordCount(size) / BlockWords + 1; }
+
+		[[nodiscard]] size_t size() const noexcept { return size_; }
+
+		[[nodiscard]] bool empty() const noexcept { return size_ == 0; }
+
+		[[nodiscard]] bool operator[](const size_t index) const noexcept {
+			return (words_[index / WordBits] >> (index % WordBits) & 1) != 0;
+		}
+
+		// Number of ones in [0, index), index <= size()
+		[[nodiscard]] size_t rank(size_t index) const noexcept;
+
+		[[nodiscard]] Span<const std::uint64_t> wordsArray() const noexcept { return words_.get(); }
+
+		[[nodiscard]] Span<const std::uint64_t> ranksArray() const noexcept { return ranks_.get(); }
+	};
+}
\ No newline at end of file
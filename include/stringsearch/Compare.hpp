@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+
+namespace stringsearch {
+	// Number of equal code units at the start of a and b, both have to have count code units. Compares 16 (AVX2) or 8
+	// (SSE2) code units at a time, the instruction set is chosen on the first call.
+	[[nodiscard]] size_t MismatchLengthVectorized(const char16_t *a, const char16_t *b, size_t count) noexcept;
+
+	// Like MismatchLengthVectorized, but compares the first code units inline. Most comparisons of a search or sort end
+	// there, only long equal prefixes pay for the call.
+	[[nodiscard]] inline size_t MismatchLength(const char16_t *a, const char16_t *b, const size_t count) noexcept {
+		const auto inlineCount = count < 8 ? count : 8;
+		size_t i = 0;
+		while(i < inlineCount && a[i] == b[i])
+			++i;
+		if(i < inlineCount || i == count)
+			return i;
+		return i + MismatchLengthVectorized(a + i, b + i, count - i);
+	}
+
+	// Name of the instruction set MismatchLengthVectorized uses, "AVX2", "SSE2" or "Scalar"
+	[[nodiscard]] const char *MismatchInstructionSet() noexcept;
+}
\ No newline at end of file
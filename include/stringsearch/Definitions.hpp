@@ -1,5 +1,6 @@
 #pragma once
 #include <tcb/span.hpp>
+#include <cstdint>
 #include <type_traits>
 
 #define DEFINE_CONSTRUCTORS(clsbase, cls, what)\
@@ -16,6 +17,43 @@ namespace stringsearch {
 
 	static_assert(std::is_signed_v<int>);
 
+	// Signed index packed into 5 bytes for texts of up to 2^39 characters, 5 instead of 8 bytes per entry.
+	class Index40 {
+		std::uint8_t bytes_[5];
+
+	public:
+		Index40() noexcept = default;
+
+		Index40(const std::int64_t value) noexcept {
+			for(size_t i = 0; i < sizeof(bytes_); ++i)
+				bytes_[i] = std::uint8_t(std::uint64_t(value) >> (8 * i));
+		}
+
+		operator std::int64_t() const noexcept {
+			std::uint64_t value = 0;
+			for(size_t i = 0; i < sizeof(bytes_); ++i)
+				value |= std::uint64_t(bytes_[i]) << (8 * i);
+			// Sign extend from bit 39
+			return std::int64_t(value << 24) >> 24;
+		}
+	};
+
+	static_assert(sizeof(Index40) == 5);
+
+	// Type indices stored as IndexT are computed with
+	template<typename IndexT>
+	struct IndexValueType {
+		using Type = IndexT;
+	};
+
+	template<>
+	struct IndexValueType<Index40> {
+		using Type = std::int64_t;
+	};
+
+	template<typename IndexT>
+	using IndexValue = typename IndexValueType<IndexT>::Type;
+
 	template<typename T, std::size_t Extent = tcb::dynamic_extent>
 	using Span = tcb::span<T, Extent>;
 
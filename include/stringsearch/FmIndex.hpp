@@ -0,0 +1,164 @@
+#pragma once
+#include "BitVector.hpp"
+#include "Definitions.hpp"
+#include "Search.hpp"
+#include "Storage.hpp"
+#include "WaveletMatrix.hpp"
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace stringsearch {
+	// Rows [Begin, End) of an FmIndex
+	struct FmRange {
+		size_t Begin;
+		size_t End;
+
+		[[nodiscard]] size_t size() const noexcept { return End - Begin; }
+	};
+
+	// Self index of a text (Ferragina & Manzini): the Burrows-Wheeler transform of the text in a wavelet matrix over its
+	// characters, and the suffix array entry of every SampleRate-th text position. Row 0 is the empty suffix, row r is
+	// suffix array entry r - 1, so ranges are in the order of the suffix array. Counts a pattern in O(m log sigma)
+	// without the text, locating a row walks back to the previous sampled position in at most SampleRate - 1 steps of
+	// O(log sigma).
+	class FmIndex {
+		// Characters of the text in ascending order, symbol s > 0 of the BWT is alphabet_[s - 1] and 0 the end of the text
+		Storage<char16_t> alphabet_;
+		// starts_[s] is the first row starting with symbol s, starts_[alphabet_.size() + 1] the number of rows
+		Storage<std::uint64_t> starts_;
+		WaveletMatrix bwt_;
+		// Set at the rows of the sampled positions
+		BitVector sampled_;
+		// Sampled positions divided by sampleRate_ in row order
+		Storage<std::uint32_t> samples_;
+		size_t sampleRate_ = 0;
+
+		// Builds from the suffix array with T entries
+		template<typename T>
+		void build(std::u16string_view text, const BuildOptions &options);
+
+	public:
+		// Uses Threads, Algorithm and SampleRate of options. Throws std::length_error if the text is too long for the
+		// samples.
+		explicit FmIndex(std::u16string_view text, const BuildOptions &options = {});
+
+		DISABLE_COPY(FmIndex);
+		DEFAULT_MOVE(FmIndex);
+
+		// Text characters + 1
+		[[nodiscard]] size_t size() const noexcept { return bwt_.size(); }
+
+		// Symbol of the BWT of c, 0 if c isn't in the text
+		[[nodiscard]] size_t symbol(char16_t c) const noexcept;
+
+		// Rows of the suffixes starting with pattern by backward search, every row but the empty suffix for an empty
+		// pattern
+		[[nodiscard]] FmRange find(std::u16string_view pattern) const noexcept;
+
+		// Symbol before the suffix of row and the number of rows before row with that symbol (LF mapping)
+		[[nodiscard]] std::pair<size_t, size_t> previous(const size_t row) const noexcept {
+			const auto [symbol, rank] = bwt_.accessRank(row);
+			return {size_t(symbol), rank};
+		}
+
+		// Row of the suffix one position before the one of a row whose previous symbol and its rank are given
+		[[nodiscard]] size_t previousRow(const size_t symbol, const size_t rank) const noexcept {
+			return size_t(starts_[symbol]) + rank;
+		}
+
+		[[nodiscard]] size_t start(const size_t symbol) const noexcept { return size_t(starts_[symbol]); }
+
+		[[nodiscard]] bool sampled(const size_t row) const noexcept { return sampled_[row]; }
+
+		// Text position of a sampled row
+		[[nodiscard]] size_t sampledPosition(const size_t row) const noexcept {
+			return size_t(samples_[sampled_.rank(row)]) * sampleRate_;
+		}
+
+		// Text position of the suffix of row
+		[[nodiscard]] size_t locate(size_t row) const noexcept;
+
+		[[nodiscard]] size_t sampleRate() const noexcept { return sampleRate_; }
+
+		[[nodiscard]] Span<const char16_t> alphabetArray() const noexcept { return alphabet_.get(); }
+
+		[[nodiscard]] Span<const std::uint64_t> startsArray() const noexcept { return starts_.get(); }
+
+		[[nodiscard]] const WaveletMatrix& bwt() const noexcept { return bwt_; }
+
+		[[nodiscard]] const BitVector& sampledRows() const noexcept { return sampled_; }
+
+		[[nodiscard]] Span<const std::uint32_t> samplesArray() const noexcept { return samples_.get(); }
+	};
+
+	// Items of the rows of an FmIndex. Finding the item of a row walks back to the start of its item, whose item is
+	// stored, or to a sampled position, whichever comes first. There are no previous entries of the same item, so pages
+	// after the first one find the items of the entries before them again.
+	class FmItemsLookup : public ItemsLookup {
+		const FmIndex &index_;
+		// Symbol of \0, 0 if the text has none
+		size_t separator_;
+		// Item of every row whose suffix starts an item after a \0, in row order
+		Storage<Index> itemStarts_;
+
+	public:
+		FmItemsLookup(std::u16string_view text, const FmIndex &index);
+
+		[[nodiscard]] Index itemOf(size_t row) const noexcept;
+
+		[[nodiscard]] size_t countDistinct(FmRange range) const;
+
+		// Returns the items of the first entries of the items in the range starting at offset in row order, unlike
+		// BasicUniqueSearchLookup::findUnique the items and not the entries. Consumed is the offset of the first entry of
+		// the next item.
+		[[nodiscard]] FindUniqueResult findUnique(FmRange range, Span<Index> outputItems, size_t offset = 0) const;
+
+		// findUnique with the items of the entries before offset in seen, which gets the items of the page. Continues a
+		// page where the previous one was consumed without visiting the entries before it again.
+		[[nodiscard]] FindUniqueResult findUnique(FmRange range, Span<Index> outputItems, size_t offset, std::unordered_set<Index> &seen) const;
+
+		// Items with an entry in the range in ascending order
+		[[nodiscard]] std::vector<Index> uniqueItems(FmRange range) const;
+
+		// The ones of the ascending items with an entry in the range
+		[[nodiscard]] std::vector<Index> itemsContainedIn(Span<const Index> items, FmRange range) const;
+
+		[[nodiscard]] Span<const Index> itemStartsArray() const noexcept { return itemStarts_.get(); }
+	};
+
+	// Memory of an FmSearch built with options from a text of characters code units with items items and at most
+	// alphabet different characters. Exact if alphabet is the number of different characters.
+	[[nodiscard]] MemoryUsage EstimateFmMemoryUsage(size_t characters, size_t items, size_t alphabet, const BuildOptions &options = {});
+
+	// Search over an FmIndex instead of a suffix array, for many catalogs on little memory: about log2(sigma) * 1.125
+	// bits per character plus the samples instead of 2 suffix arrays, and the text isn't needed after building. Counting
+	// is about as fast, but every entry whose item is needed costs up to SampleRate - 1 steps of the LF mapping, so pages
+	// of items are tens of times slower. The const member functions can be called by any number of threads at once like
+	// those of BasicSearch.
+	class FmSearch {
+		FmIndex index_;
+		FmItemsLookup itemsLookup_;
+		size_t buildPeak_ = 0;
+
+	public:
+		// Uses Threads, Algorithm and SampleRate of options, the tables of the suffix array engine don't apply
+		explicit FmSearch(std::u16string_view text, const BuildOptions &options = {});
+
+		DISABLE_COPY(FmSearch);
+		DISABLE_MOVE(FmSearch);
+
+		[[nodiscard]] FmRange find(const std::u16string_view pattern) const noexcept { return index_.find(pattern); }
+
+		// Backward search extends patterns at the front, so this searches pattern again
+		[[nodiscard]] FmRange refine(FmRange range, size_t matched, std::u16string_view pattern) const noexcept;
+
+		[[nodiscard]] const FmIndex& index() const noexcept { return index_; }
+
+		[[nodiscard]] const FmItemsLookup& itemsLookup() const noexcept { return itemsLookup_; }
+
+		[[nodiscard]] MemoryUsage memoryUsage() const noexcept;
+	};
+}
\ No newline at end of file
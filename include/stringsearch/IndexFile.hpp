@@ -0,0 +1,90 @@
+#pragma once
+#include "Definitions.hpp"
+#include "Search.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace stringsearch {
+	// Layout of an index file (native byte order, checked on load):
+	//   IndexFileHeader
+	//   IndexFileSection[SectionCount]
+	//   section data, every section starts at a multiple of IndexFileAlignment
+	// Unknown sections are ignored, so sections may be added without breaking older readers of the same version.
+	constexpr char IndexFileMagic[8] = {'s', 't', 'r', 's', 'r', 'c', 'h', '\0'};
+	// Version 2 stores the item ends as a bit vector instead of the item of every character
+	constexpr std::uint32_t IndexFileVersion = 2;
+	constexpr std::uint32_t IndexFileByteOrderMark = 0x01020304;
+	constexpr size_t IndexFileAlignment = 64;
+
+	enum class IndexFileSectionId : std::uint32_t {
+		Text = 1,
+		SuffixArray = 2,
+		ItemEnds = 3,
+		PreviousEntryOfSameItem = 4,
+		// Optional, except ItemEndRanks
+		LcpLeft = 5,
+		LcpRight = 6,
+		PrefixStarts = 7,
+		PrefixBigrams = 8,
+		PrefixBigramStarts = 9,
+		UniqueRangeMinimum = 10,
+		DistinctWords = 11,
+		DistinctRanks = 12,
+		ItemEndRanks = 13
+	};
+
+	struct IndexFileHeader {
+		char Magic[8];
+		std::uint32_t Version;
+		std::uint32_t ByteOrderMark;
+		std::uint32_t IndexSize;
+		std::uint32_t SectionCount;
+		std::uint64_t ItemCount;
+	};
+
+	struct IndexFileSection {
+		IndexFileSectionId Id;
+		std::uint32_t ElementSize;
+		std::uint64_t Offset;
+		std::uint64_t Count;
+	};
+
+	// Writes all arrays of search to path, IndexSize is sizeof(IndexT). Throws std::runtime_error if the file can't be
+	// written. Instantiated for Index, std::int64_t and Index40.
+	template<typename IndexT>
+	void WriteIndexFile(const BasicSearch<IndexT> &search, const char *path);
+
+	// Validates the header, the sizes of the sections and the prefix table and returns views into bytes without reading
+	// the other arrays, see VerifyIndexFile. Throws std::runtime_error if bytes is not a valid index file or was written
+	// with a different IndexT.
+	template<typename IndexT = Index>
+	[[nodiscard]] BasicSearchData<IndexT> ReadIndexFile(Span<const std::byte> bytes);
+
+	// Checks the values ReadIndexFile leaves unchecked so loading doesn't read the pages of the big arrays: the positions
+	// of the suffix array, the previous entries and the lcp table are in the text, the ranks match their bits and the
+	// range minimum table matches the previous entries. Reads every page, O(n). Throws std::runtime_error if a query
+	// could read out of bounds or not terminate on data, which comes from ReadIndexFile or BasicSearch::data.
+	template<typename IndexT>
+	void VerifyIndexFile(const BasicSearchData<IndexT> &data);
+
+	// IndexSize of the header, to pick the IndexT to read bytes with. Throws std::runtime_error if bytes is too small.
+	[[nodiscard]] size_t ReadIndexFileIndexSize(Span<const std::byte> bytes);
+
+	// Read only view of a whole file. The pages are shared between all processes mapping the same file.
+	class MappedFile {
+		const std::byte *data_ = nullptr;
+		size_t size_ = 0;
+
+	public:
+		// Throws std::runtime_error if the file can't be opened or mapped.
+		explicit MappedFile(const char *path);
+		~MappedFile() noexcept;
+
+		MappedFile(MappedFile &&o) noexcept;
+		MappedFile &operator=(MappedFile &&o) noexcept;
+		DISABLE_COPY(MappedFile);
+
+		[[nodiscard]] Span<const std::byte> bytes() const noexcept { return Span<const std::byte>(data_, size_); }
+	};
+}
\ No newline at end of file
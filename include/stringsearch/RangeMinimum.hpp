@@ -0,0 +1,42 @@
+#pragma once
+#include "Definitions.hpp"
+#include "Storage.hpp"
+
+namespace stringsearch {
+	// Position of the minimum of any range of an array in constant time. A sparse table stores the position of the
+	// minimum of 2^k consecutive blocks for every block and k, the blocks at the ends of a range are scanned.
+	// Refers to the values, they have to outlive the instance.
+	template<typename IndexT>
+	class BasicRangeMinimum {
+		using Value = IndexValue<IndexT>;
+
+		Span<const IndexT> values_;
+		Storage<IndexT> sparse_;
+		size_t blockCount_ = 0;
+
+		[[nodiscard]] Value smaller(const Value a, const Value b) const noexcept {
+			return Value(values_[size_t(b)]) < Value(values_[size_t(a)]) ? b : a;
+		}
+
+		[[nodiscard]] Value scan(Value begin, Value end) const noexcept;
+
+	public:
+		static constexpr size_t BlockSize = 32;
+
+		BasicRangeMinimum() noexcept = default;
+		explicit BasicRangeMinimum(Span<const IndexT> values);
+		BasicRangeMinimum(Span<const IndexT> values, Storage<IndexT> sparse) noexcept;
+
+		// Number of entries of the sparse table for count values
+		[[nodiscard]] static size_t SparseSize(size_t count) noexcept;
+
+		[[nodiscard]] bool empty() const noexcept { return sparse_.empty(); }
+
+		// Position of the leftmost minimum in [begin, end), begin < end
+		[[nodiscard]] Value minimum(Value begin, Value end) const noexcept;
+
+		[[nodiscard]] Span<const IndexT> sparseArray() const noexcept { return sparse_.get(); }
+	};
+
+	using RangeMinimum = BasicRangeMinimum<Index>;
+}
\ No newline at end of file
@@ -1,6 +1,10 @@
 #pragma once
 #include "Definitions.hpp"
+#include "RangeMinimum.hpp"
+#include "Storage.hpp"
+#include "WaveletMatrix.hpp"
 
+#include <cstdint>
 #include <string_view>
 #include <vector>
 
@@ -12,35 +16,166 @@ namespace stringsearch {
 		return span.subspan(offset, count);
 	}
 
-	using IndexPtr = std::vector<Index>::const_iterator;
+	// The engine is instantiated for Index, std::int64_t and Index40, the names without Basic are the ones for Index.
+	// Item ids stay Index for all of them.
+	template<typename IndexT>
+	using BasicIndexPtr = const IndexT *;
 
-	class FindResult {
-		IndexPtr begin_;
-		IndexPtr end_;
+	using IndexPtr = BasicIndexPtr<Index>;
+
+	template<typename IndexT>
+	class BasicFindResult {
+		BasicIndexPtr<IndexT> begin_;
+		BasicIndexPtr<IndexT> end_;
 
 	public:
-		FindResult(const IndexPtr begin, const IndexPtr end)
+		BasicFindResult(const BasicIndexPtr<IndexT> begin, const BasicIndexPtr<IndexT> end)
 			: begin_(begin),
 				end_(end) {}
 
-		[[nodiscard]] IndexPtr begin() const noexcept { return begin_; }
+		[[nodiscard]] BasicIndexPtr<IndexT> begin() const noexcept { return begin_; }
 
-		[[nodiscard]] IndexPtr end() const noexcept { return end_; }
+		[[nodiscard]] BasicIndexPtr<IndexT> end() const noexcept { return end_; }
 
 		[[nodiscard]] size_t size() const noexcept { return std::distance(begin_, end_); }
 	};
 
-	void CreateArray(std::wstring_view text, Span<Index> sa);
-	
-	class SuffixArray {
-		std::vector<Index> sa_;
+	using FindResult = BasicFindResult<Index>;
+
+	enum class SuffixSortAlgorithm {
+		// Byte wise MSD radix sort, fast on typical text
+		Radix,
+		// SA-IS, linear time even on very repetitive text
+		InducedSorting,
+		// Radix sort over the used characters, about half the passes of Radix on text with few different characters.
+		// Sequential.
+		AlphabetRadix,
+		// Radix sort over cached keys of the next characters, for text much bigger than the CPU caches. Sequential,
+		// costs 16 extra bytes per character while building.
+		CachedKeyRadix
+	};
+
+	struct BuildOptions {
+		// Threads used by the radix sort, 0 uses all hardware threads. The induced sorting is sequential.
+		unsigned int Threads = 1;
+		SuffixSortAlgorithm Algorithm = SuffixSortAlgorithm::Radix;
+		// Build an LcpTable, costs 4 bytes per character
+		bool LcpSearch = false;
+		// Build a PrefixTable, costs 256 KiB plus 8 bytes per frequent pair of first characters. Searches narrowed by it
+		// don't use the LcpTable.
+		bool PrefixSearch = false;
+		// Build a RangeMinimum over the previous entries of the same item, costs about n / 8 * log2(n / 32) bytes. Lets
+		// findUnique report the items of a range in time proportional to the number of items.
+		bool UniqueReporting = false;
+		// Build a WaveletMatrix over the previous entries of the same item, costs about n * log2(n) / 7 bytes. Lets
+		// countDistinct count the items of a range in O(log n).
+		bool DistinctCounting = false;
+		// Every how many text positions an FmSearch keeps the suffix array entry of, 4 / SampleRate bytes per character.
+		// Smaller rates find the items of a range in fewer steps.
+		size_t SampleRate = 32;
+	};
+
+	void CreateArray(std::u16string_view text, Span<Index> sa, const BuildOptions &options = {});
+	void CreateArray(std::u16string_view text, Span<std::int64_t> sa, const BuildOptions &options = {});
+
+	// lcp[i] is the length of the longest common prefix of the suffixes sa[i - 1] and sa[i], lcp[0] is 0 (Kasai et al.)
+	void CreateLcpArray(std::u16string_view text, Span<const Index> sa, Span<Index> lcp);
+	void CreateLcpArray(std::u16string_view text, Span<const std::int64_t> sa, Span<std::int64_t> lcp);
+
+	// Longest common prefix of every suffix array entry with the lower and upper bound of the binary search interval it
+	// is the middle of (Manber & Myers). Lets a search skip characters it already knows to match. Saturates at Max.
+	class LcpTable {
+		Storage<std::uint16_t> left_;
+		Storage<std::uint16_t> right_;
+
+	public:
+		static constexpr size_t Max = 0xFFFF;
+
+		LcpTable() noexcept = default;
+		template<typename IndexT>
+		LcpTable(std::u16string_view text, Span<const IndexT> sa);
+		LcpTable(Storage<std::uint16_t> left, Storage<std::uint16_t> right) noexcept;
+
+		[[nodiscard]] bool empty() const noexcept { return left_.empty(); }
+
+		[[nodiscard]] size_t left(const size_t middle) const noexcept { return left_[middle]; }
+
+		[[nodiscard]] size_t right(const size_t middle) const noexcept { return right_[middle]; }
+
+		[[nodiscard]] Span<const std::uint16_t> leftArray() const noexcept { return left_.get(); }
+
+		[[nodiscard]] Span<const std::uint16_t> rightArray() const noexcept { return right_.get(); }
+	};
+
+	template<typename IndexT>
+	struct BasicPrefixRange {
+		IndexValue<IndexT> Begin;
+		IndexValue<IndexT> End;
+		// Number of characters of the pattern all entries in the range are known to match
+		size_t Length;
+	};
+
+	using PrefixRange = BasicPrefixRange<Index>;
+
+	// Suffix array range of every first character, and of the first two characters if the range of the first one is
+	// bigger than a threshold. Lets a search skip the first probes of the binary search and answers patterns of one or
+	// two characters without searching.
+	template<typename IndexT>
+	class BasicPrefixTable {
+		// starts_[c] is the first entry starting with a character >= c
+		Storage<IndexT> starts_;
+		// first << 16 | second for the entries of frequent first characters, sorted
+		Storage<std::uint32_t> bigrams_;
+		Storage<IndexT> bigramStarts_;
+
+	public:
+		static constexpr size_t DefaultBigramThreshold = 1024;
+
+		BasicPrefixTable() noexcept = default;
+		BasicPrefixTable(std::u16string_view text, Span<const IndexT> sa, size_t bigramThreshold = DefaultBigramThreshold);
+		BasicPrefixTable(Storage<IndexT> starts, Storage<std::uint32_t> bigrams, Storage<IndexT> bigramStarts) noexcept;
+
+		[[nodiscard]] bool empty() const noexcept { return starts_.empty(); }
+
+		// pattern must not be empty
+		[[nodiscard]] BasicPrefixRange<IndexT> find(std::u16string_view pattern) const noexcept;
+
+		[[nodiscard]] Span<const IndexT> startsArray() const noexcept { return starts_.get(); }
+
+		[[nodiscard]] Span<const std::uint32_t> bigramsArray() const noexcept { return bigrams_.get(); }
+
+		[[nodiscard]] Span<const IndexT> bigramStartsArray() const noexcept { return bigramStarts_.get(); }
+	};
+
+	using PrefixTable = BasicPrefixTable<Index>;
+
+	template<typename IndexT>
+	class BasicSuffixArray {
+		using Value = IndexValue<IndexT>;
+		using IndexPtr = BasicIndexPtr<IndexT>;
+		using FindResult = BasicFindResult<IndexT>;
+
+		Storage<IndexT> sa_;
+		LcpTable lcp_;
+		BasicPrefixTable<IndexT> prefix_;
 
 	public:
-		explicit SuffixArray(Span<const Index> array);
-		explicit SuffixArray(std::u16string_view text);
+		explicit BasicSuffixArray(Span<const IndexT> array);
+		// Index40 arrays are sorted as std::int64_t and packed afterwards
+		explicit BasicSuffixArray(std::u16string_view text, const BuildOptions &options = {});
+		explicit BasicSuffixArray(Storage<IndexT> sa, LcpTable lcp = {}, BasicPrefixTable<IndexT> prefix = {}) noexcept;
+
+		// Finds the range with a Manber & Myers search that doesn't compare characters it knows to match. Starts in the
+		// range of the PrefixTable if there is one. Uses the LcpTable if there is one and the whole array is searched,
+		// otherwise the smaller lcp of the interval bounds. The upper bound search continues from where the lower bound
+		// search found the first match.
 
 		[[nodiscard]] FindResult find(std::u16string_view text, std::u16string_view pattern) const;
 
+		// Range of pattern within range, which must be the range of its first matched characters. Compares from there on
+		// and only visits range, so extending a pattern by a few characters costs O(log range.size()) comparisons.
+		[[nodiscard]] FindResult refine(std::u16string_view text, FindResult range, size_t matched, std::u16string_view pattern) const;
+
 		[[nodiscard]] static IndexPtr lowerBound(IndexPtr begin, IndexPtr end, std::u16string_view text,
 																std::u16string_view pattern);
 
@@ -51,11 +186,17 @@ namespace stringsearch {
 
 		[[nodiscard]] IndexPtr end() const noexcept { return sa_.end(); }
 
-		[[nodiscard]] const std::vector<Index>& get() const { return sa_; }
+		[[nodiscard]] Span<const IndexT> get() const noexcept { return sa_.get(); }
+
+		[[nodiscard]] const LcpTable& lcpTable() const noexcept { return lcp_; }
+
+		[[nodiscard]] const BasicPrefixTable<IndexT>& prefixTable() const noexcept { return prefix_; }
 
-		[[nodiscard]] Index indexOf(IndexPtr it) const noexcept;
+		[[nodiscard]] Value indexOf(IndexPtr it) const noexcept;
 	};
 
+	using SuffixArray = BasicSuffixArray<Index>;
+
 	struct FindUniqueResult {
 		size_t Count;
 		size_t Consumed;
@@ -78,15 +219,20 @@ namespace stringsearch {
 	void SortCountDescendingFirstContainedAscending(Span<std::pair<Index, ContainedInfo>> items);
 
 	class ItemsLookup {
-		std::vector<Index> items_;
+		// Set at every \0, the item of a character is the number of \0 before it. Costs 1.125 bits per character.
+		BitVector itemEnds_;
 		size_t itemCount_;
 
 	public:
+		// Throws std::length_error if text has more items than Index can count
 		explicit ItemsLookup(std::u16string_view text);
+		ItemsLookup(BitVector itemEnds, size_t itemCount) noexcept;
 
-		[[nodiscard]] Index getItem(const Index suffix) const { return items_[suffix]; }
+		[[nodiscard]] Index getItem(const size_t suffix) const { return Index(itemEnds_.rank(suffix)); }
 
 		[[nodiscard]] size_t itemCount() const noexcept { return itemCount_; }
+
+		[[nodiscard]] const BitVector& itemEnds() const noexcept { return itemEnds_; }
 	};
 
 	class OldUniqueSearchLookup : ItemsLookup {
@@ -112,62 +258,196 @@ namespace stringsearch {
 																	Span<Index> buffer) const;
 	};
 
-	class UniqueItemsIterator;
+	template<typename IndexT>
+	class BasicUniqueItemsIterator;
+
+	enum class FindUniqueMode {
+		// Scan a few entries per requested item, report the rest if there is a RangeMinimum
+		Auto,
+		// Visit every entry of the range
+		Scan,
+		// Report the entries whose previous entry of the same item is before the range (Muthukrishnan), two range
+		// minimum queries per item. Scans if there is no RangeMinimum.
+		Report
+	};
 	
-	class UniqueSearchLookup : public ItemsLookup {
-		const SuffixArray &suffixArray_;
-		std::vector<Index> previousEntryOfSameItem_;
+	template<typename IndexT>
+	class BasicUniqueSearchLookup : public ItemsLookup {
+		using Value = IndexValue<IndexT>;
+		using IndexPtr = BasicIndexPtr<IndexT>;
+		using FindResult = BasicFindResult<IndexT>;
+
+		const BasicSuffixArray<IndexT> &suffixArray_;
+		Storage<IndexT> previousEntryOfSameItem_;
+		BasicRangeMinimum<IndexT> rangeMinimum_;
+		// Over previousEntryOfSameItem_ + 1, the first entries of the items in [l, r) are the values < l + 1 there
+		WaveletMatrix distinctItems_;
+
+		// Calls f(saIndex) for the first entry of every item in [result.begin() + offset, result.end()) in suffix array
+		// order until f returns false
+		template<typename F>
+		void reportUnique(FindResult result, size_t offset, F &&f) const;
+
+		// Calls f(suffix) for the first entry of every item in result
+		template<typename F>
+		void forEachUnique(FindResult result, F &&f) const;
 
 	public:
-		UniqueSearchLookup(std::u16string_view text, const SuffixArray &sa);
+		// Uses UniqueReporting and DistinctCounting of options
+		BasicUniqueSearchLookup(std::u16string_view text, const BasicSuffixArray<IndexT> &sa, const BuildOptions &options = {});
+		BasicUniqueSearchLookup(ItemsLookup items, const BasicSuffixArray<IndexT> &sa, Storage<IndexT> previousEntryOfSameItem,
+										Storage<IndexT> rangeMinimum = {}, WaveletMatrix distinctItems = {}) noexcept;
 
-		[[nodiscard]] Index previousEntryOf(Index saIndex) const noexcept;
+		[[nodiscard]] Value previousEntryOf(Value saIndex) const noexcept;
 
-		[[nodiscard]] bool isDuplicateInRange(IndexPtr begin, Index prev) const noexcept;
+		[[nodiscard]] bool isDuplicateInRange(IndexPtr begin, Value prev) const noexcept;
 		
 		[[nodiscard]] bool isDuplicateInRange(IndexPtr begin, IndexPtr ptr) const noexcept;
 
-		[[nodiscard]] const std::vector<Index>& previousEntryOfSameItem() const noexcept {
-			return previousEntryOfSameItem_;
+		[[nodiscard]] Span<const IndexT> previousEntryOfSameItem() const noexcept {
+			return previousEntryOfSameItem_.get();
 		}
 
-		[[nodiscard]] FindUniqueResult findUnique(FindResult result, Span<Index> outputIndices, unsigned int offset = 0) const;
+		[[nodiscard]] const BasicRangeMinimum<IndexT>& rangeMinimum() const noexcept { return rangeMinimum_; }
+
+		[[nodiscard]] const WaveletMatrix& distinctItems() const noexcept { return distinctItems_; }
+
+		// Number of items with an entry in the range, visits the unique items if there is no WaveletMatrix
+		[[nodiscard]] size_t countDistinct(FindResult result) const;
+
+		// Returns the first entries of the items in the range starting at offset in suffix array order. Consumed is the
+		// offset of the entry after the last one returned.
+		[[nodiscard]] FindUniqueResult findUnique(FindResult result, Span<Value> outputIndices, size_t offset = 0,
+																FindUniqueMode mode = FindUniqueMode::Auto) const;
+
+		// Items with an entry in the range in ascending order
+		[[nodiscard]] std::vector<Index> uniqueItems(FindResult result) const;
+
+		// The ones of the ascending items with an entry in the range, visits the range once instead of sorting its items
+		[[nodiscard]] std::vector<Index> itemsContainedIn(Span<const Index> items, FindResult result) const;
 
 		[[nodiscard]] std::vector<std::pair<Index, ContainedInfo>> findUniquePatterns(Span<const FindResult> results) const;
 		[[nodiscard]] std::vector<Index> findUniqueInAllPatterns(Span<const FindResult> results) const;
 
-		[[nodiscard]] UniqueItemsIterator uniqueItemsInRange(FindResult result, unsigned int offset) const noexcept;
+		[[nodiscard]] BasicUniqueItemsIterator<IndexT> uniqueItemsInRange(FindResult result, size_t offset) const noexcept;
 	};
 
-	[[nodiscard]] std::u16string_view GetSuffix(std::u16string_view text, Index index, size_t length);
+	using UniqueSearchLookup = BasicUniqueSearchLookup<Index>;
+
+	[[nodiscard]] std::u16string_view GetSuffix(std::u16string_view text, size_t index, size_t length);
+
+	// The arrays a Search is made of. Used to store an instance and to restore it without rebuilding.
+	template<typename IndexT>
+	struct BasicSearchData {
+		std::u16string_view Text;
+		Span<const IndexT> Suffixes;
+		Span<const std::uint64_t> ItemEnds;
+		Span<const std::uint64_t> ItemEndRanks;
+		size_t ItemCount;
+		Span<const IndexT> PreviousEntryOfSameItem;
+		// Empty if the instance has no LcpTable
+		Span<const std::uint16_t> LcpLeft;
+		Span<const std::uint16_t> LcpRight;
+		// Empty if the instance has no PrefixTable
+		Span<const IndexT> PrefixStarts;
+		Span<const std::uint32_t> PrefixBigrams;
+		Span<const IndexT> PrefixBigramStarts;
+		// Empty if the instance has no RangeMinimum
+		Span<const IndexT> UniqueRangeMinimum;
+		// Empty if the instance has no WaveletMatrix of the previous entries
+		Span<const std::uint64_t> DistinctWords;
+		Span<const std::uint64_t> DistinctRanks;
+	};
 
-	class Search {
-		SuffixArray suffixArray_;
-		UniqueSearchLookup itemsLookup_;
+	using SearchData = BasicSearchData<Index>;
+
+	// Bytes of the arrays of a search. Arrays of a mapped index file count too, their pages are shared by all processes
+	// mapping it.
+	struct MemoryUsage {
+		// Owned by the caller
+		size_t Text = 0;
+		size_t SuffixArray = 0;
+		size_t LcpTable = 0;
+		size_t PrefixTable = 0;
+		size_t ItemEnds = 0;
+		size_t PreviousEntryOfSameItem = 0;
+		size_t RangeMinimum = 0;
+		size_t DistinctItems = 0;
+		// Wavelet matrix of the BWT and the first row of every character of an FmSearch, whose SuffixArray is the samples
+		size_t Bwt = 0;
+		// Most bytes allocated at once while building, the arrays built so far included. Estimated from the sizes and the
+		// options, a bound that holds for repetitive text too, where the radix sorts fall back to SA-IS. 0 if the
+		// instance wasn't built.
+		size_t BuildPeak = 0;
+
+		// Everything the instance keeps, without Text
+		[[nodiscard]] size_t total() const noexcept {
+			return SuffixArray + LcpTable + PrefixTable + ItemEnds + PreviousEntryOfSameItem + RangeMinimum + DistinctItems + Bwt;
+		}
+	};
+
+	// Bytes a suffix sort with options allocates next to the sorted array of n entries of value bytes at most, the
+	// fallback of the radix sorts included
+	[[nodiscard]] size_t SuffixSortScratch(size_t n, size_t value, const BuildOptions &options) noexcept;
+
+	// Memory of a BasicSearch<IndexT> built with options from a text of characters code units and items items, to size
+	// a machine before building. Exact except for the PrefixTable, which is counted without the pairs of frequent first
+	// characters.
+	template<typename IndexT>
+	[[nodiscard]] MemoryUsage EstimateMemoryUsage(size_t characters, size_t items, const BuildOptions &options = {});
+
+	// The const member functions, like those of suffixArray() and itemsLookup(), only read the arrays and keep their
+	// state on the stack, so any number of threads can query one instance at once without locking.
+	template<typename IndexT>
+	class BasicSearch {
+		BasicSuffixArray<IndexT> suffixArray_;
+		BasicUniqueSearchLookup<IndexT> itemsLookup_;
 		std::u16string_view text_;
+		size_t buildPeak_ = 0;
 
 	public:
-		explicit Search(std::u16string_view text);
+		using IndexType = IndexT;
+
+		explicit BasicSearch(std::u16string_view text, const BuildOptions &options = {});
+
+		// Doesn't copy the arrays, they have to outlive the instance.
+		explicit BasicSearch(const BasicSearchData<IndexT> &data);
 
-		DISABLE_COPY(Search);
-		DISABLE_MOVE(Search);
+		DISABLE_COPY(BasicSearch);
+		DISABLE_MOVE(BasicSearch);
 
-		[[nodiscard]] FindResult find(std::u16string_view pattern) const;
+		[[nodiscard]] BasicFindResult<IndexT> find(std::u16string_view pattern) const;
 
-		[[nodiscard]] const SuffixArray& suffixArray() const noexcept { return suffixArray_; }
+		// See BasicSuffixArray::refine
+		[[nodiscard]] BasicFindResult<IndexT> refine(BasicFindResult<IndexT> range, size_t matched, std::u16string_view pattern) const;
 
-		[[nodiscard]] const UniqueSearchLookup& itemsLookup() const noexcept { return itemsLookup_; }
+		[[nodiscard]] const BasicSuffixArray<IndexT>& suffixArray() const noexcept { return suffixArray_; }
+
+		[[nodiscard]] const BasicUniqueSearchLookup<IndexT>& itemsLookup() const noexcept { return itemsLookup_; }
+
+		[[nodiscard]] std::u16string_view text() const noexcept { return text_; }
+
+		[[nodiscard]] BasicSearchData<IndexT> data() const noexcept;
+
+		[[nodiscard]] MemoryUsage memoryUsage() const noexcept;
 	};
 
+	using Search = BasicSearch<Index>;
+
 	class UniqueItemsIteratorEnd {};
 
-	class UniqueItemsIterator {
+	template<typename IndexT>
+	class BasicUniqueItemsIterator {
+		using IndexPtr = BasicIndexPtr<IndexT>;
+		using FindResult = BasicFindResult<IndexT>;
+		using UniqueSearchLookup = BasicUniqueSearchLookup<IndexT>;
+
 		const FindResult result_;
 		IndexPtr it_;
 		const UniqueSearchLookup& itemsLookup_;
 
 	public:
-		UniqueItemsIterator(const FindResult result, const IndexPtr it, const UniqueSearchLookup& itemsLookup)
+		BasicUniqueItemsIterator(const FindResult result, const IndexPtr it, const UniqueSearchLookup& itemsLookup)
 			: result_(result),
 				it_(it),
 				itemsLookup_(itemsLookup) {
@@ -175,18 +455,18 @@ namespace stringsearch {
 				next();
 		}
 
-		UniqueItemsIterator(const FindResult result, const UniqueSearchLookup& itemsLookup)
-			: UniqueItemsIterator(result, result.begin(), itemsLookup) {}
+		BasicUniqueItemsIterator(const FindResult result, const UniqueSearchLookup& itemsLookup)
+			: BasicUniqueItemsIterator(result, result.begin(), itemsLookup) {}
 
 		[[nodiscard]] explicit operator bool() const noexcept {
 			return it_ == result_.end();
 		}
 
-		[[nodiscard]] const Index& operator*() const noexcept {
+		[[nodiscard]] IndexValue<IndexT> operator*() const noexcept {
 			return *it_;
 		}
 
-		UniqueItemsIterator& operator++() noexcept {
+		BasicUniqueItemsIterator& operator++() noexcept {
 			next();
 			return *this;
 		}
@@ -205,4 +485,6 @@ namespace stringsearch {
 
 		size_t offsetFromResultBegin() const noexcept;
 	};
+
+	using UniqueItemsIterator = BasicUniqueItemsIterator<Index>;
 }
@@ -0,0 +1,43 @@
+#pragma once
+#include "Definitions.hpp"
+
+#include <vector>
+
+namespace stringsearch {
+	// Array that either owns its elements or refers to elements owned by someone else (e.g. a mapped index file).
+	template<typename T>
+	class Storage {
+		std::vector<T> owned_;
+		Span<const T> view_;
+
+	public:
+		Storage() noexcept = default;
+
+		explicit Storage(std::vector<T> owned) noexcept
+			: owned_(std::move(owned)),
+				view_(owned_) {}
+
+		explicit Storage(const Span<const T> view) noexcept
+			: view_(view) {}
+
+		DISABLE_COPY(Storage);
+		// Moving a vector keeps its buffer, so the view stays valid
+		DEFAULT_MOVE(Storage);
+
+		[[nodiscard]] const T *data() const noexcept { return view_.data(); }
+
+		[[nodiscard]] size_t size() const noexcept { return view_.size(); }
+
+		[[nodiscard]] bool empty() const noexcept { return view_.empty(); }
+
+		[[nodiscard]] const T *begin() const noexcept { return view_.data(); }
+
+		[[nodiscard]] const T *end() const noexcept { return view_.data() + view_.size(); }
+
+		[[nodiscard]] const T &operator[](const size_t index) const noexcept { return view_[index]; }
+
+		[[nodiscard]] Span<const T> get() const noexcept { return view_; }
+
+		[[nodiscard]] bool owning() const noexcept { return !owned_.empty() || view_.empty(); }
+	};
+}
\ No newline at end of file
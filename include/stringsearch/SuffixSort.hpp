@@ -12,6 +12,14 @@ namespace stringsearch {
 		return view.data() + view.size();
 	}
 	
+	// How the *Max sorts sort the buckets below max
+	enum class SmallBucketSort {
+		// std::sort, every comparison starts at the depth of the bucket
+		Comparison,
+		// Multikey quicksort, partitions by one code unit at a time and never compares a common prefix again
+		Multikey
+	};
+
 	void SuffixSortStd(std::u16string_view characters, Span<Index> sa);
 	
 	void SuffixSortSharedBuffer(std::u16string_view characters, Span<Index> sa);
@@ -19,10 +27,62 @@ namespace stringsearch {
 	void SuffixSortOwnBuffer(std::u16string_view characters, Span<Index> sa);
 
 	void SuffixSortInPlace(std::u16string_view characters, Span<Index> sa);
+
+	// Reuses one scratch buffer of at most 1/16 of sa for all buckets. The bigger buckets are permuted in place with a
+	// byte per suffix, so the scratch is n/16 Indexes plus n bytes, about 31% of the n Indexes of
+	// SuffixSortSharedBuffer (19% for 64 bit entries), and it doesn't allocate per bucket.
+	void SuffixSortPooledBuffer(std::u16string_view characters, Span<Index> sa);
+
+	// Linear time regardless of how repetitive the text is. Doesn't read sa, it has to be as big as characters.
+	void SuffixSortInducedSorting(std::u16string_view characters, Span<Index> sa);
+	
+	void SuffixSortSharedBufferMax(std::u16string_view characters, Span<Index> sa, size_t max = 80, SmallBucketSort small = SmallBucketSort::Multikey);
+
+	void SuffixSortOwnBufferMax(std::u16string_view characters, Span<Index> sa, size_t max = 80, SmallBucketSort small = SmallBucketSort::Multikey);
+
+	void SuffixSortInPlaceMax(std::u16string_view characters, Span<Index> sa, size_t max = 80, SmallBucketSort small = SmallBucketSort::Multikey);
+
+	void SuffixSortPooledBufferMax(std::u16string_view characters, Span<Index> sa, size_t max = 80, SmallBucketSort small = SmallBucketSort::Multikey);
+
+	// Like SuffixSortSharedBufferMax but sorts independent buckets on threads threads (0 uses all hardware threads).
+	void SuffixSortParallel(std::u16string_view characters, Span<Index> sa, unsigned int threads, size_t max = 80,
+							SmallBucketSort small = SmallBucketSort::Multikey);
+
+	// Radix sort over the used characters mapped to a dense range, one pass per character instead of one per byte, and
+	// several characters per pass for alphabets of up to 15 characters. With more than 255 different characters the
+	// rare ones take two passes. Costs a byte per character, plus an Index per character in that case.
+	void SuffixSortAlphabet(std::u16string_view characters, Span<Index> sa, size_t max = 80);
+
+	// Radix sort that gathers the next 4 code units of every suffix into a key once and sorts the following 8 bytes and
+	// small buckets by the keys, so the passes don't read the text at random. Faster than SuffixSortSharedBufferMax once
+	// the text is much bigger than the caches, slower while it fits. Costs 2 * 8 + sizeof(Index) bytes per suffix.
+	void SuffixSortCachedKeys(std::u16string_view characters, Span<Index> sa, size_t max = 80);
+
+	// 64 bit variants for texts with more than 2^31 - 1 characters, the comments above apply
+	void SuffixSortStd(std::u16string_view characters, Span<std::int64_t> sa);
+	
+	void SuffixSortSharedBuffer(std::u16string_view characters, Span<std::int64_t> sa);
+
+	void SuffixSortOwnBuffer(std::u16string_view characters, Span<std::int64_t> sa);
+
+	void SuffixSortInPlace(std::u16string_view characters, Span<std::int64_t> sa);
+
+	void SuffixSortPooledBuffer(std::u16string_view characters, Span<std::int64_t> sa);
+
+	void SuffixSortInducedSorting(std::u16string_view characters, Span<std::int64_t> sa);
 	
-	void SuffixSortSharedBufferMax(std::u16string_view characters, Span<Index> sa, size_t max = 80);
+	void SuffixSortSharedBufferMax(std::u16string_view characters, Span<std::int64_t> sa, size_t max = 80, SmallBucketSort small = SmallBucketSort::Multikey);
+
+	void SuffixSortOwnBufferMax(std::u16string_view characters, Span<std::int64_t> sa, size_t max = 80, SmallBucketSort small = SmallBucketSort::Multikey);
+
+	void SuffixSortInPlaceMax(std::u16string_view characters, Span<std::int64_t> sa, size_t max = 80, SmallBucketSort small = SmallBucketSort::Multikey);
+
+	void SuffixSortPooledBufferMax(std::u16string_view characters, Span<std::int64_t> sa, size_t max = 80, SmallBucketSort small = SmallBucketSort::Multikey);
+
+	void SuffixSortParallel(std::u16string_view characters, Span<std::int64_t> sa, unsigned int threads, size_t max = 80,
+							SmallBucketSort small = SmallBucketSort::Multikey);
 
-	void SuffixSortOwnBufferMax(std::u16string_view characters, Span<Index> sa, size_t max = 80);
+	void SuffixSortAlphabet(std::u16string_view characters, Span<std::int64_t> sa, size_t max = 80);
 
-	void SuffixSortInPlaceMax(std::u16string_view characters, Span<Index> sa, size_t max = 80);
+	void SuffixSortCachedKeys(std::u16string_view characters, Span<std::int64_t> sa, size_t max = 80);
 }
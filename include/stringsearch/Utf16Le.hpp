@@ -1,10 +1,15 @@
 #pragma once
+#include "Compare.hpp"
+
 #include <iterator>
 #include <algorithm>
+#include <string_view>
 
 namespace stringsearch {
 	[[nodiscard]] inline bool LessThan(const std::u16string_view a, const std::u16string_view b) noexcept {
-		return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
+		const auto count = std::min(a.size(), b.size());
+		const auto length = MismatchLength(a.data(), b.data(), count);
+		return length == count ? a.size() < b.size() : a[length] < b[length];
 	}
 	
 	class Utf16LETextIterator {
@@ -0,0 +1,47 @@
+#pragma once
+#include "BitVector.hpp"
+#include "Definitions.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace stringsearch {
+	// Wavelet matrix over values in [0, 2^levels). Level l holds bit levels - 1 - l of every value, after every level the
+	// values are stably partitioned by that bit. All levels are stored in one BitVector of levels * size bits.
+	class WaveletMatrix {
+		BitVector bits_;
+		size_t size_ = 0;
+		size_t levels_ = 0;
+		// Ones before every level and zeros of every level
+		std::vector<size_t> levelRanks_;
+		std::vector<size_t> zeros_;
+
+		void countLevels();
+
+	public:
+		WaveletMatrix() noexcept = default;
+		// values have to be in [0, 2^levels), instantiated for Index and std::int64_t
+		template<typename T>
+		WaveletMatrix(std::vector<T> values, size_t levels);
+		WaveletMatrix(BitVector bits, size_t size, size_t levels);
+
+		// Number of levels for values in [0, maxValue]
+		[[nodiscard]] static size_t LevelCount(size_t maxValue) noexcept;
+
+		[[nodiscard]] bool empty() const noexcept { return size_ == 0; }
+
+		[[nodiscard]] size_t size() const noexcept { return size_; }
+
+		// Number of values in [begin, end) smaller than value in O(levels)
+		[[nodiscard]] size_t countLess(size_t begin, size_t end, std::uint64_t value) const noexcept;
+
+		// Numbers of values equal to value in [0, begin) and in [0, end) in O(levels)
+		[[nodiscard]] std::pair<size_t, size_t> rank(std::uint64_t value, size_t begin, size_t end) const noexcept;
+
+		// Value at index and the number of values equal to it in [0, index) in O(levels)
+		[[nodiscard]] std::pair<std::uint64_t, size_t> accessRank(size_t index) const noexcept;
+
+		[[nodiscard]] const BitVector& bits() const noexcept { return bits_; }
+	};
+}
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include "ApiFunction.h"
 #include "stringsearch/SuffixSort.hpp"
 #include "stringsearch/Search.hpp"
+#include "stringsearch/FmIndex.hpp"
+#include "stringsearch/IndexFile.hpp"
 
 #include <iostream>
 #include <chrono>
@@ -10,12 +12,26 @@
 #include <codecvt>
 #include <algorithm>
 #include <sstream>
+#include <optional>
+#include <mutex>
+#include <memory>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <variant>
+#include <array>
+#include <cstddef>
+#include <unordered_set>
 #include "MappingIterator.h"
 #include "ApiDefinitions.h"
+#include "ThreadPool.h"
+#include "Statistics.h"
+#include "KeywordCache.h"
 
 using namespace stringsearch;
 using namespace api;
 
+// Messages of creating, loading, saving and destroying instances, queries don't log
 class Logger {
 	const LogCallback log_;
 	std::stringstream stream_;
@@ -45,27 +61,334 @@ Logger::~Logger() noexcept {
 }
 
 class SearchInstance {
-	Search search_;
+	using SearchVariant = std::variant<std::unique_ptr<const Search>, std::unique_ptr<const BasicSearch<std::int64_t>>,
+												std::unique_ptr<const BasicSearch<Index40>>, std::unique_ptr<const FmSearch>>;
+
+	// Owns the text and the arrays of search_ if the instance was loaded from a file
+	std::optional<MappedFile> file_;
+	SearchVariant search_;
 	LogCallback log_;
+	unsigned int queryThreads_;
+	// Created by the first batch
+	mutable std::once_flag poolCreated_;
+	mutable std::unique_ptr<WorkStealingPool> pool_;
+	// The pool only waits for all tasks, so concurrent batches take turns
+	mutable std::mutex poolMutex_;
+	mutable QueryStatistics statistics_;
+	// Replaced as a whole by SetKeywordCacheCapacity while queries may use the old one, nullptr if disabled. A raw
+	// pointer, loading a std::shared_ptr atomically takes a lock in the standard library.
+	mutable std::atomic<KeywordCache *> keywordCache_{nullptr};
+	// Queries between loading keywordCache_ and being done with it. Sequentially consistent with keywordCache_, so a
+	// query counted after a replacement saw the count of 0 loads the new cache.
+	mutable std::atomic<size_t> keywordCacheUsers_{0};
+	// Owns keywordCache_ and the replaced caches, which are emptied and freed once no query uses a cache
+	mutable std::mutex cachesMutex_;
+	mutable std::unique_ptr<KeywordCache> cache_;
+	mutable std::vector<std::unique_ptr<KeywordCache>> retiredCaches_;
+	mutable std::atomic<bool> cachesRetired_{false};
+
+	// cachesMutex_ must be locked
+	void freeRetiredCaches() const noexcept {
+		if(keywordCacheUsers_.load() == 0) {
+			retiredCaches_.clear();
+			cachesRetired_.store(false);
+		}
+	}
+
+	template<typename IndexT>
+	static SearchVariant Build(const std::u16string_view text, const BuildOptions &options) {
+		return std::make_unique<const BasicSearch<IndexT>>(text, options);
+	}
+
+	static SearchVariant Build(const std::u16string_view text, const BuildOptions &options, const SearchEngine engine, const IndexWidth width) {
+		if(engine == SearchEngine::FmIndex)
+			return std::make_unique<const FmSearch>(text, options);
+
+		switch(width) {
+			case IndexWidth::Bits64:
+				return Build<std::int64_t>(text, options);
+			case IndexWidth::Bits40:
+				return Build<Index40>(text, options);
+			default:
+				return Build<Index>(text, options);
+		}
+	}
+
+	template<typename IndexT>
+	static SearchVariant Load(const Span<const std::byte> bytes) {
+		return std::make_unique<const BasicSearch<IndexT>>(ReadIndexFile<IndexT>(bytes));
+	}
+
+	static SearchVariant Load(const Span<const std::byte> bytes) {
+		switch(ReadIndexFileIndexSize(bytes)) {
+			case sizeof(Index):
+				return Load<Index>(bytes);
+			case sizeof(std::int64_t):
+				return Load<std::int64_t>(bytes);
+			case sizeof(Index40):
+				return Load<Index40>(bytes);
+			default:
+				throw std::runtime_error("Index file has an unsupported index size");
+		}
+	}
 
 public:
-	SearchInstance(const std::u16string_view text, const LogCallback callback)
-		: search_(text),
-			log_(callback) {}
+	// Throws std::length_error if the text is too long for width or the samples of the FmIndex
+	SearchInstance(const std::u16string_view text, const BuildOptions &options, const SearchEngine engine, const IndexWidth width,
+						const unsigned int queryThreads, const LogCallback callback)
+		: search_(Build(text, options, engine, width)),
+			log_(callback),
+			queryThreads_(queryThreads) {
+		setKeywordCache(std::make_unique<KeywordCache>(DefaultKeywordCacheEntries, DefaultKeywordCacheItems));
+	}
+
+	SearchInstance(MappedFile file, const LogCallback callback)
+		: file_(std::move(file)),
+			search_(Load(file_->bytes())),
+			log_(callback),
+			queryThreads_(0) {
+		setKeywordCache(std::make_unique<KeywordCache>(DefaultKeywordCacheEntries, DefaultKeywordCacheItems));
+	}
 	
 	DISABLE_COPY(SearchInstance);
 	DISABLE_MOVE(SearchInstance);
 	
-	[[nodiscard]] const Search& search() const { return search_; }
+	[[nodiscard]] bool mapped() const noexcept { return file_.has_value(); }
+
+	// Calls f with the BasicSearch of the index width of the instance or the FmSearch
+	template<typename F>
+	decltype(auto) visit(F &&f) const {
+		return std::visit([&](const auto &search) -> decltype(auto) { return f(*search); }, search_);
+	}
 
 	[[nodiscard]] Logger log() const { return Logger(log_); }
 
+	[[nodiscard]] QueryStatistics &statistics() const noexcept { return statistics_; }
+
+	// The keyword cache of the instance when it was created, kept alive until it is destroyed even if it is replaced
+	class KeywordCacheUse {
+		const SearchInstance &instance_;
+		KeywordCache *cache_;
+
+	public:
+		explicit KeywordCacheUse(const SearchInstance &instance) noexcept
+			: instance_(instance) {
+			instance_.keywordCacheUsers_.fetch_add(1);
+			cache_ = instance_.keywordCache_.load();
+		}
+
+		~KeywordCacheUse() noexcept {
+			// The last query frees the replaced caches unless SetKeywordCacheCapacity holds the lock, then it does
+			if(instance_.keywordCacheUsers_.fetch_sub(1) == 1 && instance_.cachesRetired_.load()) {
+				std::unique_lock lock(instance_.cachesMutex_, std::try_to_lock);
+				if(lock.owns_lock())
+					instance_.freeRetiredCaches();
+			}
+		}
+
+		DISABLE_COPY(KeywordCacheUse);
+		DISABLE_MOVE(KeywordCacheUse);
+
+		// nullptr if the cache is disabled
+		[[nodiscard]] KeywordCache *get() const noexcept { return cache_; }
+	};
+
+	void setKeywordCache(std::unique_ptr<KeywordCache> cache) const {
+		std::lock_guard lock(cachesMutex_);
+		keywordCache_.store(cache.get());
+		if(cache_) {
+			cache_->clear();
+			retiredCaches_.emplace_back(std::move(cache_));
+			cachesRetired_.store(true);
+		}
+		cache_ = std::move(cache);
+		freeRetiredCaches();
+	}
+
+	// Calls f(i) for every i in [0, count), split into a few chunks per query thread
+	template<typename F>
+	void parallelFor(const size_t count, F &&f) const {
+		if(count > 1 && ResolveThreadCount(queryThreads_) > 1) {
+			std::call_once(poolCreated_, [&]() { pool_ = std::make_unique<WorkStealingPool>(queryThreads_); });
+
+			const auto chunks = std::min(count, pool_->threadCount() * 4);
+			std::lock_guard lock(poolMutex_);
+			pool_->parallelFor(chunks, [&](const size_t chunk) {
+				for(auto i = count * chunk / chunks; i < count * (chunk + 1) / chunks; ++i)
+					f(i);
+			});
+		} else {
+			for(size_t i = 0; i < count; ++i)
+				f(i);
+		}
+	}
+
 	static SearchInstance &fromHandle(const InstanceHandle ptr) {
 		return *reinterpret_cast<SearchInstance *>(ptr);
 	}
 };
 
+// Entries of the suffix array of s, the FmIndex has a row of the empty suffix before them
+template<typename IndexT>
+size_t EntryCount(const BasicSearch<IndexT> &s) noexcept {
+	return s.suffixArray().get().size();
+}
+
+size_t EntryCount(const FmSearch &s) noexcept {
+	return s.index().size() - 1;
+}
+
+// First and last entry of range, the same for both engines
+template<typename IndexT>
+std::pair<size_t, size_t> EntriesOf(const BasicSearch<IndexT> &s, const BasicFindResult<IndexT> &range) noexcept {
+	const auto sa = s.suffixArray().begin();
+	return {size_t(range.begin() - sa), size_t(range.end() - sa)};
+}
+
+std::pair<size_t, size_t> EntriesOf(const FmSearch &, const FmRange range) noexcept {
+	if(range.size() == 0)
+		return {0, 0};
+	return {range.Begin - 1, range.End - 1};
+}
+
+template<typename IndexT>
+BasicFindResult<IndexT> RangeOf(const BasicSearch<IndexT> &s, const size_t first, const size_t last) noexcept {
+	const auto sa = s.suffixArray().begin();
+	return BasicFindResult<IndexT>(sa + first, sa + last);
+}
+
+FmRange RangeOf(const FmSearch &, const size_t first, const size_t last) noexcept {
+	return FmRange{first + 1, last + 1};
+}
+
+// The pattern of a typeahead session and the ranges of the prefixes it was set to before
+class QuerySession {
+	struct Prefix {
+		size_t Length;
+		size_t First;
+		size_t Last;
+	};
+
+	const SearchInstance &search_;
+	std::u16string pattern_;
+	// Increasing lengths, the first one is the empty prefix with the whole array and the last one is the pattern
+	std::vector<Prefix> prefixes_;
+
+public:
+	explicit QuerySession(const SearchInstance &search)
+		: search_(search),
+			prefixes_{Prefix{0, 0, search.visit([](const auto &s) { return EntryCount(s); })}} {}
+
+	DISABLE_COPY(QuerySession);
+	DISABLE_MOVE(QuerySession);
+
+	[[nodiscard]] const SearchInstance &search() const noexcept { return search_; }
+
+	[[nodiscard]] std::u16string_view pattern() const noexcept { return pattern_; }
+
+	// First and last entry of the range of the pattern
+	[[nodiscard]] std::pair<size_t, size_t> range() const noexcept { return {prefixes_.back().First, prefixes_.back().Last}; }
+
+	// Calls f with the search of the instance and the range of the pattern
+	template<typename F>
+	decltype(auto) visit(F &&f) const {
+		return search_.visit([&](const auto &s) -> decltype(auto) {
+			const auto &range = prefixes_.back();
+			return f(s, RangeOf(s, range.First, range.Last));
+		});
+	}
+
+	// Returns the occurrences of pattern
+	size_t set(const std::u16string_view pattern) {
+		const auto shared = size_t(std::mismatch(pattern_.begin(), pattern_.end(), pattern.begin(), pattern.end()).first - pattern_.begin());
+		while(prefixes_.back().Length > shared)
+			prefixes_.pop_back();
+		pattern_ = pattern;
+		if(prefixes_.back().Length == pattern.size())
+			return prefixes_.back().Last - prefixes_.back().First;
+
+		return search_.visit([&](const auto &s) {
+			const auto &prefix = prefixes_.back();
+			// Only the search of the whole array can use the PrefixTable and the LcpTable
+			const auto range = prefix.Length == 0 ? s.find(pattern) : s.refine(RangeOf(s, prefix.First, prefix.Last), prefix.Length, pattern);
+			const auto [first, last] = EntriesOf(s, range);
+			prefixes_.emplace_back(Prefix{pattern.size(), first, last});
+			return range.size();
+		});
+	}
+
+	size_t extend(const std::u16string_view characters) {
+		return set(pattern_ + std::u16string(characters));
+	}
+
+	static QuerySession &fromHandle(const SessionHandle ptr) {
+		return *reinterpret_cast<QuerySession *>(ptr);
+	}
+};
+
+// Unique items of a range, one page after the other
+class ResultCursor {
+	const SearchInstance &search_;
+	size_t first_;
+	size_t last_;
+	// Offset in the range of the next entry that may be the first of its item
+	size_t position_ = 0;
+	// Items of the pages so far, FmSearch can't tell the first entry of an item without them
+	std::unordered_set<Index> seen_;
+
+public:
+	ResultCursor(const SearchInstance &search, const size_t first, const size_t last) noexcept
+		: search_(search),
+			first_(first),
+			last_(last) {}
+
+	DISABLE_COPY(ResultCursor);
+	DISABLE_MOVE(ResultCursor);
+
+	[[nodiscard]] const SearchInstance &search() const noexcept { return search_; }
+
+	// Calls f with the search of the instance, the range and the offset of the next page in it
+	template<typename F>
+	decltype(auto) visit(F &&f) const {
+		return search_.visit([&](const auto &s) -> decltype(auto) { return f(s, RangeOf(s, first_, last_), position_); });
+	}
+
+	[[nodiscard]] bool done() const noexcept { return position_ == last_ - first_; }
+
+	void advance(const size_t position) noexcept { position_ = position; }
+
+	[[nodiscard]] std::unordered_set<Index> &seen() noexcept { return seen_; }
+
+	static ResultCursor &fromHandle(const CursorHandle ptr) {
+		return *reinterpret_cast<ResultCursor *>(ptr);
+	}
+};
+
 namespace stringsearch::api {
+	template<>
+	struct APIArg<ResultCursor> {
+		static constexpr size_t argc = 1;
+		static Result validate(const CursorHandle cursor) noexcept {
+			return cursor != nullptr ? Result::Ok : Result::InvalidCursor;
+		}
+
+		static ResultCursor& convert(const CursorHandle cursor) noexcept {
+			return ResultCursor::fromHandle(cursor);
+		}
+	};
+
+	template<>
+	struct APIArg<QuerySession> {
+		static constexpr size_t argc = 1;
+		static Result validate(const SessionHandle session) noexcept {
+			return session != nullptr ? Result::Ok : Result::InvalidSession;
+		}
+
+		static QuerySession& convert(const SessionHandle session) noexcept {
+			return QuerySession::fromHandle(session);
+		}
+	};
+
 	template<>
 	struct APIArg<SearchInstance> {
 		static constexpr size_t argc = 1;
@@ -99,24 +422,187 @@ decltype(auto) Time(ClockDuration &duration, F && f) {
 	return res;
 }
 
-template<typename F>
-decltype(auto) Time(TimeDuration &duration, F && f) {
-	const auto before = Clock::now();
-	decltype(auto) res = f();
-	const auto after = Clock::now();
-	duration = (after - before).count();
-	return res;
+// Phases of one query. Reading the clock costs about as much as a short find, so they are only timed if the caller
+// asked for the timings or the instance collects statistics.
+class QueryTimer {
+	bool timed_;
+	Clock::time_point start_;
+	std::array<ClockDuration, QueryPhaseCount> phases_{};
+	unsigned int run_ = 0;
+
+	static std::uint64_t Nanoseconds(const ClockDuration duration) noexcept {
+		return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+	}
+
+public:
+	explicit QueryTimer(const bool timed) noexcept : timed_(timed), start_(timed ? Clock::now() : Clock::time_point()) {}
+
+	template<typename F>
+	decltype(auto) time(const QueryPhase phase, F &&f) {
+		run_ |= 1u << unsigned(phase);
+		if(!timed_)
+			return f();
+
+		const auto before = Clock::now();
+		decltype(auto) res = f();
+		phases_[size_t(phase)] = Clock::now() - before;
+		return res;
+	}
+
+	// Copy counts as Unique, the timings of the api predate it
+	[[nodiscard]] FindUniqueItemsKeywordsTimings timings() const noexcept {
+		FindUniqueItemsKeywordsTimings timings{};
+		timings.Find = phases_[size_t(QueryPhase::Find)].count();
+		timings.Unique = (phases_[size_t(QueryPhase::Unique)] + phases_[size_t(QueryPhase::Copy)]).count();
+		timings.Parse = phases_[size_t(QueryPhase::Parse)].count();
+		return timings;
+	}
+
+	void record(QueryStatistics &statistics, const Result status, const size_t itemsEmitted) const noexcept {
+		if(!timed_ || !statistics.enabled())
+			return;
+
+		QueryMeasurement measurement;
+		for(size_t i = 0; i < QueryPhaseCount; ++i)
+			measurement.Nanoseconds[i] = Nanoseconds(phases_[i]);
+		measurement.Phases = run_;
+		measurement.TotalNanoseconds = Nanoseconds(Clock::now() - start_);
+		measurement.Status = status;
+		measurement.ItemsEmitted = itemsEmitted;
+		statistics.record(measurement);
+	}
+};
+
+// The fields of options its StructSize covers, nullptr stands for InstanceOptions{}
+InstanceOptions OptionsOrDefaults(const InstanceOptions *options) noexcept {
+	InstanceOptions read{};
+	if(!options)
+		return read;
+
+	const auto size = options->StructSize;
+#define READ_FIELD(field) if(offsetof(InstanceOptions, field) + sizeof(read.field) <= size) read.field = options->field
+	READ_FIELD(Threads);
+	READ_FIELD(Algorithm);
+	READ_FIELD(LcpSearch);
+	READ_FIELD(PrefixSearch);
+	READ_FIELD(QueryThreads);
+	READ_FIELD(UniqueReporting);
+	READ_FIELD(DistinctCounting);
+	READ_FIELD(Width);
+	READ_FIELD(Engine);
+	READ_FIELD(SampleRate);
+#undef READ_FIELD
+	return read;
 }
 
-InstanceHandle CreateSearchInstanceFromText(const char16_t *charactersBegin, const size_t count, const LogCallback callback) {
-	Logger(callback) << "Creating instance";
+BuildOptions ToBuildOptions(const InstanceOptions &options) {
+	BuildOptions buildOptions;
+	buildOptions.Threads = options.Threads;
+	switch(options.Algorithm) {
+		case api::SuffixSortAlgorithm::InducedSorting:
+			buildOptions.Algorithm = stringsearch::SuffixSortAlgorithm::InducedSorting;
+			break;
+		case api::SuffixSortAlgorithm::AlphabetRadix:
+			buildOptions.Algorithm = stringsearch::SuffixSortAlgorithm::AlphabetRadix;
+			break;
+		case api::SuffixSortAlgorithm::CachedKeyRadix:
+			buildOptions.Algorithm = stringsearch::SuffixSortAlgorithm::CachedKeyRadix;
+			break;
+		default:
+			buildOptions.Algorithm = stringsearch::SuffixSortAlgorithm::Radix;
+			break;
+	}
+	buildOptions.LcpSearch = options.LcpSearch;
+	buildOptions.PrefixSearch = options.PrefixSearch;
+	buildOptions.UniqueReporting = options.UniqueReporting;
+	buildOptions.DistinctCounting = options.DistinctCounting;
+	if(options.SampleRate != 0)
+		buildOptions.SampleRate = options.SampleRate;
+	return buildOptions;
+}
+
+const char *ToString(const IndexWidth width) noexcept {
+	switch(width) {
+		case IndexWidth::Bits64:
+			return "64";
+		case IndexWidth::Bits40:
+			return "40";
+		default:
+			return "32";
+	}
+}
+
+InstanceHandle CreateSearchInstanceFromText(const char16_t *charactersBegin, const size_t count, const InstanceOptions *options, const LogCallback callback) {
+	const auto instanceOptions = OptionsOrDefaults(options);
+	const auto buildOptions = ToBuildOptions(instanceOptions);
+	const auto engine = instanceOptions.Engine;
+	const auto width = instanceOptions.Width;
+	const auto threads = ResolveThreadCount(buildOptions.Threads);
+	if(engine == SearchEngine::FmIndex)
+		Logger(callback) << "Creating FM-index instance sampling every " << buildOptions.SampleRate << " positions using " << threads << " threads";
+	else
+		Logger(callback) << "Creating instance with " << ToString(width) << " bit indices using " << threads << " threads";
 	const auto text = std::u16string_view(charactersBegin, count);
-	ClockDuration createTime;
-	const auto ptr = Time(createTime, [&]() {
-		return new SearchInstance(text, callback);
-	});
-	ptr->log() << "Create took " << std::chrono::duration_cast<std::chrono::milliseconds>(createTime).count() << "ms";
-	return ptr;
+	try {
+		ClockDuration createTime;
+		const auto ptr = Time(createTime, [&]() {
+			return new SearchInstance(text, buildOptions, engine, width, instanceOptions.QueryThreads, callback);
+		});
+		ptr->log() << "Create took " << std::chrono::duration_cast<std::chrono::milliseconds>(createTime).count() << "ms";
+		return ptr;
+	} catch(const std::length_error &e) {
+		Logger(callback) << "Creating instance failed: " << e.what();
+		return nullptr;
+	}
+}
+
+InstanceHandle CreateSearchInstanceFromFile(const char *path, const LogCallback callback) {
+	if(!path)
+		return nullptr;
+
+	Logger(callback) << "Loading instance from " << path;
+	try {
+		ClockDuration loadTime;
+		const auto ptr = Time(loadTime, [&]() {
+			return new SearchInstance(MappedFile(path), callback);
+		});
+		ptr->log() << "Load took " << std::chrono::duration_cast<std::chrono::milliseconds>(loadTime).count() << "ms";
+		return ptr;
+	} catch(const std::exception &e) {
+		Logger(callback) << "Loading " << path << " failed: " << e.what();
+		return nullptr;
+	}
+}
+
+template<typename IndexT>
+static void Verify(const Span<const std::byte> bytes) {
+	VerifyIndexFile(ReadIndexFile<IndexT>(bytes));
+}
+
+Result VerifySearchInstanceFile(const char *path, const LogCallback callback) {
+	if(!path)
+		return Result::NullPointer;
+
+	try {
+		const MappedFile file(path);
+		switch(ReadIndexFileIndexSize(file.bytes())) {
+			case sizeof(Index):
+				Verify<Index>(file.bytes());
+				break;
+			case sizeof(std::int64_t):
+				Verify<std::int64_t>(file.bytes());
+				break;
+			case sizeof(Index40):
+				Verify<Index40>(file.bytes());
+				break;
+			default:
+				throw std::runtime_error("Index file has an unsupported index size");
+		}
+		return Result::Ok;
+	} catch(const std::exception &e) {
+		Logger(callback) << "Verifying " << path << " failed: " << e.what();
+		return Result::IoError;
+	}
 }
 
 #define FORWARD_EVERYTHING_LAMBDA(func) [](auto &&... args) -> decltype(auto) { return func(std::forward<decltype(args)>(args)...); }
@@ -130,9 +616,41 @@ void DestroySearchInstance(const InstanceHandle instance) {
 	CallApiFunctionImplementation<decltype(DestroyInstanceImpl)>(FORWARD_EVERYTHING_LAMBDA(DestroyInstanceImpl), std::forward_as_tuple(instance));
 }
 
+template<typename IndexT>
+Result Save(const BasicSearch<IndexT> &search, const char *path) {
+	WriteIndexFile(search, path);
+	return Result::Ok;
+}
+
+// The index file format only stores suffix arrays
+Result Save(const FmSearch &, const char *) {
+	return Result::NotSupported;
+}
+
+Result SaveSearchInstanceImpl(const SearchInstance &search, const char *path) {
+	try {
+		return search.visit([&](const auto &s) { return Save(s, path); });
+	} catch(const std::exception &e) {
+		search.log() << "Saving to " << path << " failed: " << e.what();
+		return Result::IoError;
+	}
+}
+
+Result SaveSearchInstance(const InstanceHandle instance, const char *path) {
+	return CallApiFunctionImplementation<decltype(SaveSearchInstanceImpl)>(
+		FORWARD_EVERYTHING_LAMBDA(SaveSearchInstanceImpl),
+		std::forward_as_tuple(instance, path)
+	);
+}
+
 Result CountOccurencesImpl(const SearchInstance &search, const std::u16string_view pattern, int *occurrences) {
-	const auto result = search.search().find(pattern);
-	*occurrences = int(std::distance(result.begin(), result.end()));
+	QueryTimer timer(search.statistics().enabled());
+	const auto size = timer.time(QueryPhase::Find, [&]() {
+		return search.visit([&](const auto &s) { return s.find(pattern).size(); });
+	});
+	search.statistics().recordRangeSize(size);
+	*occurrences = int(std::min(size, size_t(std::numeric_limits<int>::max())));
+	timer.record(search.statistics(), Result::Ok, 0);
 	return Result::Ok;
 }
 
@@ -143,38 +661,182 @@ Result CountOccurences(const InstanceHandle instance, const char16_t *patternBeg
 	);
 }
 
-FindUniqueResult MakeUniqueAndGetItems(const Search &search, const FindResult &searchResult, const Span<Index> outputIndices, const unsigned int offset) {
-	const auto res = search.itemsLookup().findUnique(searchResult, outputIndices, offset);
-	for(auto &index : outputIndices.subspan(0, res.Count))
-		index = search.itemsLookup().getItem(index);
-	return res;
+Result CountDistinctItemsImpl(const SearchInstance &search, const std::u16string_view pattern, size_t *distinctItems) {
+	QueryTimer timer(search.statistics().enabled());
+	if(!distinctItems) {
+		timer.record(search.statistics(), Result::NullPointer, 0);
+		return Result::NullPointer;
+	}
+
+	*distinctItems = search.visit([&](const auto &s) {
+		const auto range = timer.time(QueryPhase::Find, [&]() { return s.find(pattern); });
+		search.statistics().recordRangeSize(range.size());
+		return timer.time(QueryPhase::Unique, [&]() { return s.itemsLookup().countDistinct(range); });
+	});
+	timer.record(search.statistics(), Result::Ok, 0);
+	return Result::Ok;
+}
+
+Result CountDistinctItems(const InstanceHandle instance, const char16_t *patternBegin, const size_t count, size_t *distinctItems) {
+	return CallApiFunctionImplementation<decltype(CountDistinctItemsImpl)>(
+		FORWARD_EVERYTHING_LAMBDA(CountDistinctItemsImpl),
+		std::forward_as_tuple(instance, patternBegin, count, distinctItems)
+	);
 }
 
-Result FindUniqueItemsInternal(const SearchInstance &search, const std::u16string_view pattern, Span<Index> outputIndices, FindUniqueItemsResult &result, const unsigned int offset, FindUniqueItemsTimings &timings) {
-	const auto searchResult = Time(timings.Find, [&]() {
-		return search.search().find(pattern);
+template<typename IndexT>
+FindUniqueResult MakeUniqueAndGetItems(const BasicSearch<IndexT> &search, const BasicFindResult<IndexT> &searchResult, const Span<Index> outputIndices, const size_t offset, QueryTimer &timer) {
+	if constexpr(std::is_same_v<IndexT, Index>) {
+		const auto res = timer.time(QueryPhase::Unique, [&]() {
+			return search.itemsLookup().findUnique(searchResult, outputIndices, offset);
+		});
+		timer.time(QueryPhase::Copy, [&]() {
+			for(auto &index : outputIndices.subspan(0, res.Count))
+				index = search.itemsLookup().getItem(size_t(index));
+			return res.Count;
+		});
+		return res;
+	} else {
+		// Wider suffixes don't fit into the output of the items
+		std::vector<IndexValue<IndexT>> suffixes(outputIndices.size());
+		const auto res = timer.time(QueryPhase::Unique, [&]() {
+			return search.itemsLookup().findUnique(searchResult, suffixes, offset);
+		});
+		timer.time(QueryPhase::Copy, [&]() {
+			return std::transform(suffixes.begin(), suffixes.begin() + res.Count, outputIndices.begin(), [&](const IndexValue<IndexT> suffix) {
+				return search.itemsLookup().getItem(size_t(suffix));
+			});
+		});
+		return res;
+	}
+}
+
+// Items of the entries of the range of an FmSearch, which finds the items and not the entries
+FindUniqueResult MakeUniqueAndGetItems(const FmSearch &search, const FmRange range, const Span<Index> outputIndices, const size_t offset, QueryTimer &timer) {
+	return timer.time(QueryPhase::Unique, [&]() {
+		return search.itemsLookup().findUnique(range, outputIndices, offset);
 	});
-	
-	if(searchResult.size() < size_t(offset))
-		return Result::OffsetOutOfBounds;
-	
-	const auto uniqueResult = Time(timings.Unique, [&]() {
-		return MakeUniqueAndGetItems(search.search(), searchResult, outputIndices, offset);
+}
+
+// A keyword of a query with its range, and its items once they were needed
+template<typename RangeT>
+struct KeywordMatch {
+	std::u16string_view Keyword;
+	RangeT Range;
+	// Ascending, nullptr until needed
+	std::shared_ptr<const std::vector<Index>> Items;
+};
+
+template<typename SearchT>
+using RangeOfSearch = decltype(std::declval<const SearchT &>().find(std::u16string_view()));
+
+// Looks keyword up in cache first, cache may be nullptr
+template<typename SearchT>
+KeywordMatch<RangeOfSearch<SearchT>> FindKeyword(const SearchT &search, KeywordCache *cache, const std::u16string_view keyword) {
+	if(!cache)
+		return {keyword, search.find(keyword), nullptr};
+
+	if(auto cached = cache->find(keyword))
+		return {keyword, RangeOf(search, cached->First, cached->Last), std::move(cached->Items)};
+
+	const auto range = search.find(keyword);
+	const auto [first, last] = EntriesOf(search, range);
+	cache->insert(keyword, CachedKeyword{first, last, nullptr});
+	return {keyword, range, nullptr};
+}
+
+// Items of the keyword in ascending order, cached with its range if they fit
+template<typename SearchT, typename RangeT>
+const std::vector<Index> &KeywordItems(const SearchT &search, KeywordCache *cache, KeywordMatch<RangeT> &match) {
+	if(!match.Items) {
+		match.Items = std::make_shared<const std::vector<Index>>(search.itemsLookup().uniqueItems(match.Range));
+		if(cache && match.Items->size() <= cache->maxItems()) {
+			const auto [first, last] = EntriesOf(search, match.Range);
+			cache->insert(match.Keyword, CachedKeyword{first, last, match.Items});
+		}
+	}
+	return *match.Items;
+}
+
+// Items of all keywords in ascending order. The smallest range bounds them, bigger ranges whose items aren't worth
+// caching only filter them.
+template<typename SearchT, typename RangeT>
+std::vector<Index> ItemsInAllKeywords(const SearchT &search, KeywordCache *cache, std::vector<KeywordMatch<RangeT>> &matches) {
+	// A pattern of only spaces has no keywords
+	if(matches.empty())
+		return {};
+
+	const auto smallest = std::min_element(matches.begin(), matches.end(), [](const KeywordMatch<RangeT> &a, const KeywordMatch<RangeT> &b) {
+		return a.Range.size() < b.Range.size();
 	});
-	result = FindUniqueItemsResult{searchResult.size(), uniqueResult.Count, uniqueResult.Consumed};
+	auto items = KeywordItems(search, cache, *smallest);
+	for(auto it = matches.begin(); it != matches.end() && !items.empty(); ++it) {
+		if(it == smallest)
+			continue;
 
-	return Result::Ok;
+		if(it->Items || (cache && it->Range.size() <= cache->maxItems())) {
+			const auto &other = KeywordItems(search, cache, *it);
+			std::vector<Index> both;
+			std::set_intersection(items.begin(), items.end(), other.begin(), other.end(), std::back_inserter(both));
+			items = std::move(both);
+		} else {
+			items = search.itemsLookup().itemsContainedIn(items, it->Range);
+		}
+	}
+	return items;
+}
+
+// Items of any keyword with the number of keywords containing them and the first one, in ascending order
+template<typename SearchT, typename RangeT>
+std::vector<std::pair<Index, ContainedInfo>> ItemsInAnyKeyword(const SearchT &search, KeywordCache *cache, std::vector<KeywordMatch<RangeT>> &matches) {
+	std::vector<std::pair<Index, unsigned>> itemKeywords;
+	for(size_t i = 0; i < matches.size(); ++i) {
+		const auto &items = KeywordItems(search, cache, matches[i]);
+		const auto middle = itemKeywords.size();
+		std::transform(items.begin(), items.end(), std::back_inserter(itemKeywords), [&](const Index item) {
+			return std::make_pair(item, unsigned(i));
+		});
+		std::inplace_merge(itemKeywords.begin(), itemKeywords.begin() + std::ptrdiff_t(middle), itemKeywords.end());
+	}
+
+	std::vector<std::pair<Index, ContainedInfo>> res;
+	for(const auto &[item, keyword] : itemKeywords) {
+		if(!res.empty() && res.back().first == item)
+			++res.back().second.Count;
+		else
+			res.emplace_back(item, ContainedInfo{1, keyword});
+	}
+	return res;
+}
+
+Result FindUniqueItemsInternal(const SearchInstance &search, const std::u16string_view pattern, Span<Index> outputIndices, FindUniqueItemsResult &result, const unsigned int offset, QueryTimer &timer,
+										KeywordCache *cache = nullptr) {
+	return search.visit([&](const auto &s) {
+		const auto searchResult = timer.time(QueryPhase::Find, [&]() {
+			return FindKeyword(s, cache, pattern).Range;
+		});
+		search.statistics().recordRangeSize(searchResult.size());
+
+		if(searchResult.size() < size_t(offset))
+			return Result::OffsetOutOfBounds;
+
+		const auto uniqueResult = MakeUniqueAndGetItems(s, searchResult, outputIndices, offset, timer);
+		result = FindUniqueItemsResult{searchResult.size(), uniqueResult.Count, uniqueResult.Consumed};
+
+		return Result::Ok;
+	});
 }
 
 Result FindUniqueItemsImpl(const SearchInstance &search, const std::u16string_view pattern, Span<Index> outputIndices, FindUniqueItemsResult *resultOut, const unsigned int offset, FindUniqueItemsTimings *timingsOut) {
-	FindUniqueItemsTimings timings{};
+	QueryTimer timer(timingsOut || search.statistics().enabled());
 	FindUniqueItemsResult result{};
-	const auto res = FindUniqueItemsInternal(search, pattern, outputIndices, result, offset, timings);
+	const auto res = FindUniqueItemsInternal(search, pattern, outputIndices, result, offset, timer);
+	timer.record(search.statistics(), res, result.Count);
 	
 	if(resultOut)
 		*resultOut = result;
 	if(timingsOut)
-		*timingsOut = timings;
+		*timingsOut = timer.timings();
 	return res;
 }
 
@@ -203,54 +865,70 @@ std::vector<std::u16string_view> ParseKeywords(const std::u16string_view pattern
 
 
 Result FindUniqueItemsKeywordsStrategy(const SearchInstance &search, const std::u16string_view pattern, const Span<Index> outputIndices, KeywordsMatch matchingStrategy, unsigned int offset, FindUniqueItemsResult *resultOut, FindUniqueItemsKeywordsTimings *timingsOut) {
-	FindUniqueItemsKeywordsTimings timings{};
+	QueryTimer timer(timingsOut || search.statistics().enabled());
 	FindUniqueItemsResult result{};
 	
-	const auto keywords = Time(timings.Parse, [&]() {
+	const auto keywords = timer.time(QueryPhase::Parse, [&]() {
 		return ParseKeywords(pattern);
 	});
 
+	const SearchInstance::KeywordCacheUse cacheUse(search);
+	const auto cache = keywords.empty() ? nullptr : cacheUse.get();
 	Result r;
 	if(keywords.size() == 1) {
-		r = FindUniqueItemsInternal(search, keywords[0], outputIndices, result, offset, timings);
+		r = FindUniqueItemsInternal(search, keywords[0], outputIndices, result, offset, timer, cache);
 	} else {
-		const auto findResults = Time(timings.Find, [&]() {
-			std::vector<FindResult> results;
-			for(const auto &k : keywords)
-				results.emplace_back(search.search().find(k));
-			return results;
-		});
+		r = search.visit([&](const auto &s) {
+			auto matches = timer.time(QueryPhase::Find, [&]() {
+				std::vector<decltype(FindKeyword(s, cache, pattern))> matches;
+				for(const auto &k : keywords)
+					matches.emplace_back(FindKeyword(s, cache, k));
+				return matches;
+			});
+			for(const auto &match : matches)
+				search.statistics().recordRangeSize(match.Range.size());
 
-		r = Time(timings.Unique, [&]() {
 			if(matchingStrategy == KeywordsMatch::All) {
-				auto searchResult = search.search().itemsLookup().findUniqueInAllPatterns(findResults);
+				const auto searchResult = timer.time(QueryPhase::Unique, [&]() {
+					return ItemsInAllKeywords(s, cache, matches);
+				});
 				if(searchResult.size() < offset)
 					return Result::OffsetOutOfBounds;
-				const auto skippedResults = Span<Index>(searchResult).subspan(offset);
-				const auto count = std::min(outputIndices.size(), skippedResults.size());
-				std::copy_n(searchResult.begin(), count, outputIndices.begin());
+				const auto skippedResults = Span<const Index>(searchResult).subspan(offset);
+				const auto count = timer.time(QueryPhase::Copy, [&]() {
+					const auto count = std::min(outputIndices.size(), skippedResults.size());
+					std::copy_n(skippedResults.begin(), count, outputIndices.begin());
+					return count;
+				});
 				result = FindUniqueItemsResult{searchResult.size(), count, count};
 			} else if(matchingStrategy == KeywordsMatch::AtLeastOne) {
-				auto searchResult = search.search().itemsLookup().findUniquePatterns(findResults);
+				const auto searchResult = timer.time(QueryPhase::Unique, [&]() {
+					auto searchResult = ItemsInAnyKeyword(s, cache, matches);
+					SortCountDescendingFirstContainedAscending(searchResult);
+					return searchResult;
+				});
 				if(searchResult.size() < offset)
 					return Result::OffsetOutOfBounds;
-				SortCountDescendingFirstContainedAscending(searchResult);
-				const auto skippedResults = Span<std::pair<Index, ContainedInfo>>(searchResult).subspan(offset);
-				const auto count = std::min(outputIndices.size(), skippedResults.size());
-				std::copy_n(skippedResults.begin(), count, Map(outputIndices.begin(), [](const std::pair<Index, ContainedInfo> p) {
-					return p.first;
-				}));
+				const auto skippedResults = Span<const std::pair<Index, ContainedInfo>>(searchResult).subspan(offset);
+				const auto count = timer.time(QueryPhase::Copy, [&]() {
+					const auto count = std::min(outputIndices.size(), skippedResults.size());
+					std::copy_n(skippedResults.begin(), count, Map(outputIndices.begin(), [](const std::pair<Index, ContainedInfo> p) {
+						return p.first;
+					}));
+					return count;
+				});
 				result = FindUniqueItemsResult{searchResult.size(), count, count};
 			}
 
 			return Result::Ok;
 		});
 	}
+	timer.record(search.statistics(), r, result.Count);
 		
 	if(resultOut)
 		*resultOut = result;
 	if(timingsOut)
-		*timingsOut = timings;
+		*timingsOut = timer.timings();
 	return r;
 }
 
@@ -261,3 +939,342 @@ Result FindUniqueItemsKeywords(const InstanceHandle instance, const char16_t *pa
 		std::forward_as_tuple(instance, patternBegin, count, output, outputCount, matching, offset, result, timings)
 	);
 }
+
+template<typename F>
+Result RunBatch(const SearchInstance &search, const Span<const BatchQuery> queries, BatchQueryResult *results, F &&query) {
+	if(!results)
+		return Result::NullPointer;
+
+	search.parallelFor(queries.size(), [&](const size_t i) {
+		auto &result = results[i];
+		result = BatchQueryResult{};
+		result.Status = queries[i].Pattern != nullptr
+			? query(queries[i], std::u16string_view(queries[i].Pattern, queries[i].PatternCount), result)
+			: Result::NullPointer;
+	});
+	return Result::Ok;
+}
+
+Result CountOccurencesBatchImpl(const SearchInstance &search, const Span<const BatchQuery> queries, BatchQueryResult *results) {
+	return RunBatch(search, queries, results, [&](const BatchQuery &, const std::u16string_view pattern, BatchQueryResult &result) {
+		QueryTimer timer(true);
+		result.Items.TotalResults = timer.time(QueryPhase::Find, [&]() {
+			return search.visit([&](const auto &s) { return s.find(pattern).size(); });
+		});
+		search.statistics().recordRangeSize(result.Items.TotalResults);
+		result.Timings = timer.timings();
+		timer.record(search.statistics(), Result::Ok, 0);
+		return Result::Ok;
+	});
+}
+
+Result CountOccurencesBatch(const InstanceHandle instance, const BatchQuery *queries, const size_t queryCount, BatchQueryResult *results) {
+	return CallApiFunctionImplementation<decltype(CountOccurencesBatchImpl)>(
+		FORWARD_EVERYTHING_LAMBDA(CountOccurencesBatchImpl),
+		std::forward_as_tuple(instance, queries, queryCount, results)
+	);
+}
+
+Result FindUniqueItemsBatchImpl(const SearchInstance &search, const Span<const BatchQuery> queries, BatchQueryResult *results) {
+	return RunBatch(search, queries, results, [&](const BatchQuery &query, const std::u16string_view pattern, BatchQueryResult &result) {
+		if(!query.Output)
+			return Result::NullPointer;
+		return FindUniqueItemsImpl(search, pattern, Span<Index>(query.Output, query.OutputCount), &result.Items, query.Offset, &result.Timings);
+	});
+}
+
+Result FindUniqueItemsBatch(const InstanceHandle instance, const BatchQuery *queries, const size_t queryCount, BatchQueryResult *results) {
+	return CallApiFunctionImplementation<decltype(FindUniqueItemsBatchImpl)>(
+		FORWARD_EVERYTHING_LAMBDA(FindUniqueItemsBatchImpl),
+		std::forward_as_tuple(instance, queries, queryCount, results)
+	);
+}
+
+Result FindUniqueItemsKeywordsBatchImpl(const SearchInstance &search, const Span<const BatchQuery> queries, const KeywordsMatch matching, BatchQueryResult *results) {
+	return RunBatch(search, queries, results, [&](const BatchQuery &query, const std::u16string_view pattern, BatchQueryResult &result) {
+		if(!query.Output)
+			return Result::NullPointer;
+		return FindUniqueItemsKeywordsStrategy(search, pattern, Span<Index>(query.Output, query.OutputCount), matching, query.Offset, &result.Items, &result.Timings);
+	});
+}
+
+Result FindUniqueItemsKeywordsBatch(const InstanceHandle instance, const BatchQuery *queries, const size_t queryCount, const KeywordsMatch matching, BatchQueryResult *results) {
+	return CallApiFunctionImplementation<decltype(FindUniqueItemsKeywordsBatchImpl)>(
+		FORWARD_EVERYTHING_LAMBDA(FindUniqueItemsKeywordsBatchImpl),
+		std::forward_as_tuple(instance, queries, queryCount, matching, results)
+	);
+}
+
+SessionHandle BeginQuerySession(const InstanceHandle instance) {
+	if(!instance)
+		return nullptr;
+
+	try {
+		return new QuerySession(SearchInstance::fromHandle(instance));
+	} catch(const std::bad_alloc &) {
+		return nullptr;
+	}
+}
+
+void EndQuerySessionImpl(const QuerySession &session) {
+	delete &session;
+}
+
+void EndQuerySession(const SessionHandle session) {
+	CallApiFunctionImplementation<decltype(EndQuerySessionImpl)>(FORWARD_EVERYTHING_LAMBDA(EndQuerySessionImpl), std::forward_as_tuple(session));
+}
+
+// Times the search of a change of the pattern of session
+template<typename F>
+Result ChangeQuery(QuerySession &session, size_t *occurrences, F &&change) {
+	const auto &search = session.search();
+	QueryTimer timer(search.statistics().enabled());
+	const auto size = timer.time(QueryPhase::Find, change);
+	search.statistics().recordRangeSize(size);
+	if(occurrences)
+		*occurrences = size;
+	timer.record(search.statistics(), Result::Ok, 0);
+	return Result::Ok;
+}
+
+Result ExtendQueryImpl(QuerySession &session, const std::u16string_view characters, size_t *occurrences) {
+	return ChangeQuery(session, occurrences, [&]() { return session.extend(characters); });
+}
+
+Result ExtendQuery(const SessionHandle session, const char16_t *characters, const size_t count, size_t *occurrences) {
+	return CallApiFunctionImplementation<decltype(ExtendQueryImpl)>(
+		FORWARD_EVERYTHING_LAMBDA(ExtendQueryImpl),
+		std::forward_as_tuple(session, characters, count, occurrences)
+	);
+}
+
+Result SetQueryImpl(QuerySession &session, const std::u16string_view pattern, size_t *occurrences) {
+	return ChangeQuery(session, occurrences, [&]() { return session.set(pattern); });
+}
+
+Result SetQuery(const SessionHandle session, const char16_t *patternBegin, const size_t count, size_t *occurrences) {
+	return CallApiFunctionImplementation<decltype(SetQueryImpl)>(
+		FORWARD_EVERYTHING_LAMBDA(SetQueryImpl),
+		std::forward_as_tuple(session, patternBegin, count, occurrences)
+	);
+}
+
+Result FindSessionItemsImpl(const QuerySession &session, const Span<Index> outputIndices, const unsigned int offset, FindUniqueItemsResult *resultOut) {
+	const auto &search = session.search();
+	QueryTimer timer(search.statistics().enabled());
+	FindUniqueItemsResult result{};
+	const auto res = session.visit([&](const auto &s, const auto range) {
+		if(range.size() < size_t(offset))
+			return Result::OffsetOutOfBounds;
+
+		const auto uniqueResult = MakeUniqueAndGetItems(s, range, outputIndices, offset, timer);
+		result = FindUniqueItemsResult{range.size(), uniqueResult.Count, uniqueResult.Consumed};
+		return Result::Ok;
+	});
+	timer.record(search.statistics(), res, result.Count);
+
+	if(resultOut)
+		*resultOut = result;
+	return res;
+}
+
+Result FindSessionItems(const SessionHandle session, Index *output, const size_t outputCount, const unsigned int offset, FindUniqueItemsResult *result) {
+	return CallApiFunctionImplementation<decltype(FindSessionItemsImpl)>(
+		FORWARD_EVERYTHING_LAMBDA(FindSessionItemsImpl),
+		std::forward_as_tuple(session, output, outputCount, offset, result)
+	);
+}
+
+// Cursor over the range of s found by find, records it like a query
+template<typename F>
+CursorHandle OpenCursorOf(const SearchInstance &search, size_t *occurrences, F &&find) noexcept {
+	try {
+		QueryTimer timer(search.statistics().enabled());
+		const auto cursor = search.visit([&](const auto &s) {
+			const auto range = timer.time(QueryPhase::Find, [&]() { return find(s); });
+			const auto [first, last] = EntriesOf(s, range);
+			return new ResultCursor(search, first, last);
+		});
+		cursor->visit([&](const auto &, const auto range, size_t) {
+			search.statistics().recordRangeSize(range.size());
+			if(occurrences)
+				*occurrences = range.size();
+		});
+		timer.record(search.statistics(), Result::Ok, 0);
+		return cursor;
+	} catch(const std::bad_alloc &) {
+		return nullptr;
+	}
+}
+
+CursorHandle OpenCursor(const InstanceHandle instance, const char16_t *patternBegin, const size_t count, size_t *occurrences) {
+	if(!instance || !patternBegin)
+		return nullptr;
+
+	const auto pattern = std::u16string_view(patternBegin, count);
+	return OpenCursorOf(SearchInstance::fromHandle(instance), occurrences, [&](const auto &s) { return s.find(pattern); });
+}
+
+CursorHandle OpenSessionCursor(const SessionHandle session, size_t *occurrences) {
+	if(!session)
+		return nullptr;
+
+	const auto &querySession = QuerySession::fromHandle(session);
+	return OpenCursorOf(querySession.search(), occurrences, [&](const auto &s) {
+		const auto [first, last] = querySession.range();
+		return RangeOf(s, first, last);
+	});
+}
+
+Result CursorNextImpl(ResultCursor &cursor, const Span<Index> outputIndices, size_t *written) {
+	const auto &search = cursor.search();
+	QueryTimer timer(search.statistics().enabled());
+	size_t count = 0;
+	if(!cursor.done() && !outputIndices.empty()) {
+		const auto consumed = cursor.visit([&](const auto &s, const auto range, const size_t position) {
+			const auto res = [&]() {
+				if constexpr(std::is_same_v<std::decay_t<decltype(s)>, FmSearch>) {
+					return timer.time(QueryPhase::Unique, [&]() {
+						return s.itemsLookup().findUnique(range, outputIndices, position, cursor.seen());
+					});
+				} else {
+					return MakeUniqueAndGetItems(s, range, outputIndices, position, timer);
+				}
+			}();
+			count = res.Count;
+			return res.Consumed;
+		});
+		cursor.advance(consumed);
+	}
+	timer.record(search.statistics(), Result::Ok, count);
+
+	if(written)
+		*written = count;
+	return Result::Ok;
+}
+
+Result CursorNext(const CursorHandle cursor, Index *output, const size_t outputCount, size_t *written) {
+	return CallApiFunctionImplementation<decltype(CursorNextImpl)>(
+		FORWARD_EVERYTHING_LAMBDA(CursorNextImpl),
+		std::forward_as_tuple(cursor, output, outputCount, written)
+	);
+}
+
+void CursorCloseImpl(const ResultCursor &cursor) {
+	delete &cursor;
+}
+
+void CursorClose(const CursorHandle cursor) {
+	CallApiFunctionImplementation<decltype(CursorCloseImpl)>(FORWARD_EVERYTHING_LAMBDA(CursorCloseImpl), std::forward_as_tuple(cursor));
+}
+
+void ToApiMemoryUsage(const stringsearch::MemoryUsage &usage, const bool mapped, api::MemoryUsage &out) noexcept {
+	out.Text = usage.Text;
+	out.SuffixArray = usage.SuffixArray;
+	out.LcpTable = usage.LcpTable;
+	out.PrefixTable = usage.PrefixTable;
+	out.ItemEnds = usage.ItemEnds;
+	out.PreviousEntryOfSameItem = usage.PreviousEntryOfSameItem;
+	out.RangeMinimum = usage.RangeMinimum;
+	out.DistinctItems = usage.DistinctItems;
+	out.Bwt = usage.Bwt;
+	out.Total = usage.total();
+	out.BuildPeak = usage.BuildPeak;
+	out.Mapped = mapped;
+}
+
+Result GetInstanceMemoryUsageImpl(const SearchInstance &search, api::MemoryUsage *usage) {
+	if(!usage)
+		return Result::NullPointer;
+
+	ToApiMemoryUsage(search.visit([](const auto &s) { return s.memoryUsage(); }), search.mapped(), *usage);
+	return Result::Ok;
+}
+
+Result GetInstanceMemoryUsage(const InstanceHandle instance, api::MemoryUsage *usage) {
+	return CallApiFunctionImplementation<decltype(GetInstanceMemoryUsageImpl)>(
+		FORWARD_EVERYTHING_LAMBDA(GetInstanceMemoryUsageImpl),
+		std::forward_as_tuple(instance, usage)
+	);
+}
+
+Result EstimateInstanceMemoryUsage(const size_t count, const size_t items, const InstanceOptions *options, api::MemoryUsage *usage) {
+	if(!usage)
+		return Result::NullPointer;
+
+	const auto instanceOptions = OptionsOrDefaults(options);
+	const auto buildOptions = ToBuildOptions(instanceOptions);
+	if(instanceOptions.Engine == SearchEngine::FmIndex) {
+		// Every code unit of the text may be a different character
+		ToApiMemoryUsage(EstimateFmMemoryUsage(count, items, std::min<size_t>(count, 0x10000), buildOptions), false, *usage);
+		return Result::Ok;
+	}
+
+	const auto width = instanceOptions.Width;
+	ToApiMemoryUsage(width == IndexWidth::Bits64 ? EstimateMemoryUsage<std::int64_t>(count, items, buildOptions)
+							: width == IndexWidth::Bits40 ? EstimateMemoryUsage<Index40>(count, items, buildOptions)
+							: EstimateMemoryUsage<Index>(count, items, buildOptions), false, *usage);
+	return Result::Ok;
+}
+
+Result SetKeywordCacheCapacityImpl(const SearchInstance &search, const size_t entries, const size_t items) {
+	search.setKeywordCache(entries == 0 ? nullptr : std::make_unique<KeywordCache>(entries, items));
+	return Result::Ok;
+}
+
+Result SetKeywordCacheCapacity(const InstanceHandle instance, const size_t entries, const size_t items) {
+	return CallApiFunctionImplementation<decltype(SetKeywordCacheCapacityImpl)>(
+		FORWARD_EVERYTHING_LAMBDA(SetKeywordCacheCapacityImpl),
+		std::forward_as_tuple(instance, entries, items)
+	);
+}
+
+Result GetKeywordCacheStatisticsImpl(const SearchInstance &search, KeywordCacheStatistics *statistics, const bool reset) {
+	if(!statistics)
+		return Result::NullPointer;
+
+	const SearchInstance::KeywordCacheUse cacheUse(search);
+	if(const auto cache = cacheUse.get())
+		cache->snapshot(*statistics, reset);
+	else
+		*statistics = KeywordCacheStatistics{};
+	return Result::Ok;
+}
+
+Result GetKeywordCacheStatistics(const InstanceHandle instance, KeywordCacheStatistics *statistics, const bool reset) {
+	return CallApiFunctionImplementation<decltype(GetKeywordCacheStatisticsImpl)>(
+		FORWARD_EVERYTHING_LAMBDA(GetKeywordCacheStatisticsImpl),
+		std::forward_as_tuple(instance, statistics, reset)
+	);
+}
+
+Result EnableInstanceStatisticsImpl(const SearchInstance &search, const bool enabled) {
+	search.statistics().enable(enabled);
+	return Result::Ok;
+}
+
+Result EnableInstanceStatistics(const InstanceHandle instance, const bool enabled) {
+	return CallApiFunctionImplementation<decltype(EnableInstanceStatisticsImpl)>(
+		FORWARD_EVERYTHING_LAMBDA(EnableInstanceStatisticsImpl),
+		std::forward_as_tuple(instance, enabled)
+	);
+}
+
+Result GetInstanceStatisticsImpl(const SearchInstance &search, InstanceStatistics *statistics, const bool reset) {
+	if(!statistics)
+		return Result::NullPointer;
+
+	search.statistics().snapshot(*statistics, reset);
+	return Result::Ok;
+}
+
+Result GetInstanceStatistics(const InstanceHandle instance, InstanceStatistics *statistics, const bool reset) {
+	return CallApiFunctionImplementation<decltype(GetInstanceStatisticsImpl)>(
+		FORWARD_EVERYTHING_LAMBDA(GetInstanceStatisticsImpl),
+		std::forward_as_tuple(instance, statistics, reset)
+	);
+}
+
+std::uint64_t GetHistogramPercentile(const Histogram *histogram, const double percentile) {
+	return histogram ? HistogramPercentile(*histogram, percentile) : 0;
+}
\ No newline at end of file
@@ -4,6 +4,19 @@
 
 #include "dllexport.h"
 
+// The query functions (CountOccurences, CountDistinctItems, FindUniqueItems, FindUniqueItemsKeywords, their batches and
+// OpenCursor) may be called by any number of threads on one instance at once, also while the statistics and the keyword
+// cache are read or reconfigured. They only read the index and keep their state on the stack or in the session or cursor
+// of the caller. Statistics are recorded with relaxed atomics into shards the threads take in turn, the keyword cache is
+// read through an atomic pointer. Queries take these locks, besides the ones of the memory allocator:
+// - FindUniqueItemsKeywords locks the shard of the keyword cache of every keyword it looks up or inserts, unless
+//   SetKeywordCacheCapacity(instance, 0, 0) disabled the cache
+// - the batches lock the thread pool of the instance, so concurrent batches take turns on it
+// - the last FindUniqueItemsKeywords or GetKeywordCacheStatistics to finish after SetKeywordCacheCapacity tries to lock
+//   the keyword caches of the instance without waiting, to free the replaced ones
+// A keyword cache replaced by SetKeywordCacheCapacity is emptied right away and freed once no query uses it, queries
+// running meanwhile may still use it. The LogCallback is only called while creating, loading, saving and destroying
+// instances, on the calling thread. An instance must not be destroyed while it is queried.
 extern "C" {
 	strsearchdll_EXPORT void strsearchdll_CALLING_CONVENCTION SuffixSortSharedBuffer(
 		const char16_t *characters, stringsearch::Index *saBegin, stringsearch::Index *saEnd);
@@ -11,15 +24,38 @@ extern "C" {
 	strsearchdll_EXPORT void strsearchdll_CALLING_CONVENCTION SuffixSortInPlace(
 		const char16_t *characters, stringsearch::Index *saBegin, stringsearch::Index *saEnd);
 
+	// options may be nullptr to build with the defaults of InstanceOptions{}: all hardware threads for building and
+	// batches, 32 bit indices. Returns nullptr if the text is too long for the index width or the samples of an
+	// FmIndex. FmIndex instances don't read the text after this returns.
 	strsearchdll_EXPORT stringsearch::api::InstanceHandle strsearchdll_CALLING_CONVENCTION CreateSearchInstanceFromText(
-		const char16_t *charactersBegin, size_t count, stringsearch::api::LogCallback callback);
+		const char16_t *charactersBegin, size_t count, const stringsearch::api::InstanceOptions *options,
+		stringsearch::api::LogCallback callback);
+
+	// Maps an index file written by SaveSearchInstance with any index width, returns nullptr if it can't be loaded.
+	// Batches use all hardware threads like the default of QueryThreads. Only the header and the sizes of the arrays
+	// are checked so loading doesn't read the whole file, call VerifySearchInstanceFile first for untrusted files.
+	strsearchdll_EXPORT stringsearch::api::InstanceHandle strsearchdll_CALLING_CONVENCTION CreateSearchInstanceFromFile(
+		const char *path, stringsearch::api::LogCallback callback);
+
+	// Reads the whole index file and returns IoError if it can't be read or queries on it could read out of bounds
+	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION VerifySearchInstanceFile(
+		const char *path, stringsearch::api::LogCallback callback);
+
+	// Returns NotSupported for FmIndex instances
+	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION SaveSearchInstance(
+		stringsearch::api::InstanceHandle instance, const char *path);
 
 	strsearchdll_EXPORT void strsearchdll_CALLING_CONVENCTION DestroySearchInstance(
 		stringsearch::api::InstanceHandle instance);
 
+	// Saturates at the maximum of int, use CountOccurencesBatch for the exact count of instances with wider indices
 	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION CountOccurences(
 		stringsearch::api::InstanceHandle instance, const char16_t *patternBegin, size_t count, int *occurrences);
 
+	// Number of items containing the pattern, in O(log n) if the instance was created with DistinctCounting
+	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION CountDistinctItems(
+		stringsearch::api::InstanceHandle instance, const char16_t *patternBegin, size_t count, size_t *distinctItems);
+
 	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION FindUniqueItems(
 		stringsearch::api::InstanceHandle instance, const char16_t *patternBegin, size_t count,
 		stringsearch::Index *output, size_t outputCount, stringsearch::api::FindUniqueItemsResult *result,
@@ -28,4 +64,96 @@ extern "C" {
 	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION FindUniqueItemsKeywords(
 		stringsearch::api::InstanceHandle instance, const char16_t *patternBegin, size_t count,
 		stringsearch::Index *output, size_t outputCount, stringsearch::api::KeywordsMatch matching, unsigned int offset, stringsearch::api::FindUniqueItemsResult *result, stringsearch::api::FindUniqueItemsKeywordsTimings *timings);
-}
+
+	// Batches answer every query like the single query function and store its status in results[i].Status. The queries
+	// are spread over the threads of the instance, the call returns when all are answered. Returns NullPointer if
+	// queries or results is nullptr, Ok otherwise even if some queries failed.
+	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION CountOccurencesBatch(
+		stringsearch::api::InstanceHandle instance, const stringsearch::api::BatchQuery *queries, size_t queryCount,
+		stringsearch::api::BatchQueryResult *results);
+
+	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION FindUniqueItemsBatch(
+		stringsearch::api::InstanceHandle instance, const stringsearch::api::BatchQuery *queries, size_t queryCount,
+		stringsearch::api::BatchQueryResult *results);
+
+	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION FindUniqueItemsKeywordsBatch(
+		stringsearch::api::InstanceHandle instance, const stringsearch::api::BatchQuery *queries, size_t queryCount,
+		stringsearch::api::KeywordsMatch matching, stringsearch::api::BatchQueryResult *results);
+
+	// Typeahead session of one user: the pattern typed so far and the ranges of its prefixes. Every change of the
+	// pattern only searches the range of the longest prefix it shares with the previous pattern, comparing from the
+	// end of that prefix on. Returns nullptr if instance is nullptr or out of memory. A session must be ended before
+	// its instance is destroyed and is used by one thread at a time, different sessions of an instance are independent.
+	strsearchdll_EXPORT stringsearch::api::SessionHandle strsearchdll_CALLING_CONVENCTION BeginQuerySession(
+		stringsearch::api::InstanceHandle instance);
+
+	strsearchdll_EXPORT void strsearchdll_CALLING_CONVENCTION EndQuerySession(stringsearch::api::SessionHandle session);
+
+	// Appends count characters to the pattern of the session. occurrences of the new pattern may be nullptr.
+	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION ExtendQuery(
+		stringsearch::api::SessionHandle session, const char16_t *characters, size_t count, size_t *occurrences);
+
+	// Replaces the pattern of the session, for deleted or edited characters. occurrences may be nullptr.
+	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION SetQuery(
+		stringsearch::api::SessionHandle session, const char16_t *patternBegin, size_t count, size_t *occurrences);
+
+	// FindUniqueItems of the pattern of the session without searching it again
+	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION FindSessionItems(
+		stringsearch::api::SessionHandle session, stringsearch::Index *output, size_t outputCount, unsigned int offset,
+		stringsearch::api::FindUniqueItemsResult *result);
+
+	// Pages through the unique items of a pattern in the order of FindUniqueItems without searching it again or
+	// skipping the items of earlier pages, so every page costs about as much as its items however deep it is. Returns
+	// nullptr if instance or patternBegin is nullptr. A cursor must be closed before its instance is destroyed and is
+	// used by one thread at a time. occurrences may be nullptr.
+	strsearchdll_EXPORT stringsearch::api::CursorHandle strsearchdll_CALLING_CONVENCTION OpenCursor(
+		stringsearch::api::InstanceHandle instance, const char16_t *patternBegin, size_t count, size_t *occurrences);
+
+	// Cursor over the pattern the session has now, later changes of the session don't affect it
+	strsearchdll_EXPORT stringsearch::api::CursorHandle strsearchdll_CALLING_CONVENCTION OpenSessionCursor(
+		stringsearch::api::SessionHandle session, size_t *occurrences);
+
+	// Writes up to outputCount items following the ones returned before to output, written is 0 after the last one.
+	// Cursors of FmIndex instances keep the items returned so far in a hash set to skip them.
+	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION CursorNext(
+		stringsearch::api::CursorHandle cursor, stringsearch::Index *output, size_t outputCount, size_t *written);
+
+	strsearchdll_EXPORT void strsearchdll_CALLING_CONVENCTION CursorClose(stringsearch::api::CursorHandle cursor);
+
+	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION GetInstanceMemoryUsage(
+		stringsearch::api::InstanceHandle instance, stringsearch::api::MemoryUsage *usage);
+
+	// Memory of an instance built from count characters with items items, options may be nullptr like for
+	// CreateSearchInstanceFromText. The PrefixTable is counted without the pairs of frequent first characters, the Bwt
+	// of an FmIndex with up to count different characters.
+	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION EstimateInstanceMemoryUsage(
+		size_t count, size_t items, const stringsearch::api::InstanceOptions *options, stringsearch::api::MemoryUsage *usage);
+
+	// Replaces the keyword cache of the instance with an empty one of at most entries keywords, whose lists of items have at
+	// most items items together, 0 entries disables it. FindUniqueItemsKeywords looks the range of every keyword up there
+	// before searching it, and keeps the items of keywords with up to items / 32 of them for the next queries.
+	// Instances start with DefaultKeywordCacheEntries and DefaultKeywordCacheItems. Queries running meanwhile finish
+	// with the old cache.
+	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION SetKeywordCacheCapacity(
+		stringsearch::api::InstanceHandle instance, size_t entries, size_t items);
+
+	// Copies the counters of the keyword cache since it was created or last reset and sets them to 0 if reset. All 0 if
+	// it is disabled.
+	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION GetKeywordCacheStatistics(
+		stringsearch::api::InstanceHandle instance, stringsearch::api::KeywordCacheStatistics *statistics, bool reset);
+
+	// Starts or stops collecting the InstanceStatistics of all queries, instances start with it stopped. Queries are
+	// only timed while it runs or if the caller passes timings.
+	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION EnableInstanceStatistics(
+		stringsearch::api::InstanceHandle instance, bool enabled);
+
+	// Copies the statistics collected since the instance was created or last reset and sets them to 0 if reset. Queries
+	// running meanwhile may be counted in some of the histograms only.
+	strsearchdll_EXPORT stringsearch::api::Result strsearchdll_CALLING_CONVENCTION GetInstanceStatistics(
+		stringsearch::api::InstanceHandle instance, stringsearch::api::InstanceStatistics *statistics, bool reset);
+
+	// Upper bound of the bucket of the value at percentile (0 to 100), at most the maximum. 0 if histogram is nullptr or
+	// empty.
+	strsearchdll_EXPORT std::uint64_t strsearchdll_CALLING_CONVENCTION GetHistogramPercentile(
+		const stringsearch::api::Histogram *histogram, double percentile);
+}
\ No newline at end of file
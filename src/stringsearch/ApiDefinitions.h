@@ -1,18 +1,33 @@
 #pragma once
+#include "stringsearch/Definitions.hpp"
+
 #include <chrono>
+#include <cstdint>
 
 namespace stringsearch::api {
 	enum class Result {
 		Ok = 0,
 		InvalidInstance = 1,
 		NullPointer = 2,
-		OffsetOutOfBounds
+		OffsetOutOfBounds,
+		IoError,
+		InvalidSession,
+		InvalidCursor,
+		// The search engine of the instance doesn't support the function
+		NotSupported
 	};
 
-	#define strsearchdll_CALLING_CONVENCTION __cdecl
+	#ifdef _WIN32
+		#define strsearchdll_CALLING_CONVENCTION __cdecl
+	#else
+		// Other platforms have a single calling convention
+		#define strsearchdll_CALLING_CONVENCTION
+	#endif
 
 	using LogCallback = void(strsearchdll_CALLING_CONVENCTION *) (const char *message);
 	using InstanceHandle = void *;
+	using SessionHandle = void *;
+	using CursorHandle = void *;
 
 	using TimeDuration = std::chrono::high_resolution_clock::rep;
 	
@@ -31,8 +46,145 @@ namespace stringsearch::api {
 		TimeDuration Parse;
 	};
 
+	// Values below 4 have a bucket each, every power of two above is split into 4 buckets, so a bucket is at most 25%
+	// wider than its lower bound. Values of 2^40 and more are counted in the last bucket.
+	constexpr size_t HistogramBuckets = 156;
+
+	struct Histogram {
+		std::uint64_t Count;
+		std::uint64_t Sum;
+		std::uint64_t Max;
+		std::uint64_t Buckets[HistogramBuckets];
+	};
+
+	// Queries answered while statistics were enabled, every query of a batch counts as one
+	struct InstanceStatistics {
+		std::uint64_t Queries;
+		// Queries that didn't return Result::Ok
+		std::uint64_t Failures;
+		// Items written to the outputs
+		std::uint64_t ItemsEmitted;
+		// Occurrences of every pattern and keyword searched
+		Histogram RangeSizes;
+		// Nanoseconds of every phase, a query only counts in the phases it has
+		Histogram Parse;
+		Histogram Find;
+		Histogram Unique;
+		Histogram Copy;
+		Histogram Total;
+	};
+
+	// Cache of the keywords of FindUniqueItemsKeywords queries, see SetKeywordCacheCapacity
+	struct KeywordCacheStatistics {
+		std::uint64_t Hits;
+		// Hits that found the items of the keyword, not only its range
+		std::uint64_t ItemHits;
+		std::uint64_t Misses;
+		size_t Entries;
+		size_t Capacity;
+		// Items of the cached lists
+		size_t Items;
+		size_t ItemCapacity;
+	};
+
+	// Capacity of the keyword cache of new instances, 4 MiB of items
+	constexpr size_t DefaultKeywordCacheEntries = 1024;
+	constexpr size_t DefaultKeywordCacheItems = 1 << 20;
+
+	enum class SuffixSortAlgorithm {
+		Radix,
+		InducedSorting,
+		AlphabetRadix,
+		CachedKeyRadix
+	};
+
+	// Width of the suffix array entries. Item ids in the outputs are Index for all of them.
+	enum class IndexWidth {
+		// Up to 2^31 - 1 characters, 4 bytes per entry
+		Bits32,
+		// 8 bytes per entry
+		Bits64,
+		// Up to 2^39 characters, 5 bytes per entry, a little slower to read than Bits64
+		Bits40
+	};
+
+	enum class SearchEngine {
+		// Suffix array over the text of the caller, the fastest to page through big results
+		SuffixArray,
+		// Compressed self index without the text, a few bits per character, see SampleRate
+		FmIndex
+	};
+
+	// New fields are appended. The library reads the fields StructSize covers, the ones behind it are 0 for callers
+	// built against an older version. InstanceOptions{} sets StructSize and the default 0 of every field.
+	struct InstanceOptions {
+		size_t StructSize = sizeof(InstanceOptions);
+		// Threads used to build the instance, 0 uses all hardware threads
+		unsigned int Threads;
+		// Use InducedSorting for very repetitive text, AlphabetRadix for text with few different
+		// characters, CachedKeyRadix for text much bigger than the CPU caches
+		SuffixSortAlgorithm Algorithm;
+		// Build an lcp table for faster searches of long patterns, costs 4 bytes per character
+		bool LcpSearch;
+		// Build a table of the ranges of the first two characters, costs 256 KiB and skips the first probes of every search
+		bool PrefixSearch;
+		// Threads answering batches, 0 uses all hardware threads
+		unsigned int QueryThreads;
+		// Build a range minimum table that finds the unique items of big ranges without visiting every entry, costs
+		// about n / 8 * log2(n / 32) bytes
+		bool UniqueReporting;
+		// Build a wavelet matrix that counts the items of a range in O(log n) for CountDistinctItems, costs about
+		// n * log2(n) / 7 bytes
+		bool DistinctCounting;
+		// Bits32 for texts that fit, the size of every other array of positions scales with it
+		IndexWidth Width;
+		// FmIndex ignores LcpSearch, PrefixSearch, UniqueReporting, DistinctCounting and Width
+		SearchEngine Engine;
+		// Every SampleRate-th position of the text is stored by FmIndex instances, which take up to SampleRate steps
+		// to find the item of an entry. 0 uses 32, 4 bytes per SampleRate characters.
+		unsigned int SampleRate;
+	};
+
+	// Bytes of the arrays of an instance, see stringsearch::MemoryUsage
+	struct MemoryUsage {
+		// Owned by the caller of CreateSearchInstanceFromText, part of the file for mapped instances
+		size_t Text;
+		size_t SuffixArray;
+		size_t LcpTable;
+		size_t PrefixTable;
+		size_t ItemEnds;
+		size_t PreviousEntryOfSameItem;
+		size_t RangeMinimum;
+		size_t DistinctItems;
+		// Burrows-Wheeler transform of FmIndex instances
+		size_t Bwt;
+		// Sum of the arrays without Text
+		size_t Total;
+		// Most bytes allocated at once while building, 0 for mapped instances
+		size_t BuildPeak;
+		// The arrays are pages of a mapped index file shared by all processes mapping it
+		bool Mapped;
+	};
+
 	enum class KeywordsMatch {
 		All,
 		AtLeastOne
 	};
+
+	struct BatchQuery {
+		const char16_t *Pattern;
+		size_t PatternCount;
+		// Not used by CountOccurencesBatch
+		Index *Output;
+		size_t OutputCount;
+		unsigned int Offset;
+	};
+
+	struct BatchQueryResult {
+		Result Status;
+		// TotalResults is the number of occurrences for CountOccurencesBatch
+		FindUniqueItemsResult Items;
+		// Parse is only set by FindUniqueItemsKeywordsBatch
+		FindUniqueItemsKeywordsTimings Timings;
+	};
 }
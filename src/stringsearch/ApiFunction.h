@@ -28,6 +28,18 @@ namespace stringsearch::api {
 		}
 	};
 
+	template<>
+	struct APIArg<const char *> {
+		static constexpr size_t argc = 1;
+		static Result validate(const char *ptr) noexcept {
+			return ptr != nullptr ? Result::Ok : Result::NullPointer;
+		}
+
+		static const char *convert(const char *ptr) noexcept {
+			return ptr;
+		}
+	};
+
 	template<typename T>
 	struct APIArg<Span<T>> {
 		static constexpr size_t argc = 2;
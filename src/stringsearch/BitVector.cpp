@@ -0,0 +1,52 @@
+#include "stringsearch/BitVector.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace stringsearch {
+	namespace {
+		[[nodiscard]] size_t PopCount(const std::uint64_t word) noexcept {
+#ifdef _MSC_VER
+			return size_t(__popcnt64(word));
+#else
+			return size_t(__builtin_popcountll(word));
+#endif
+		}
+	}
+
+	BitVector::BitVector(std::vector<std::uint64_t> words, const size_t size)
+		: size_(size) {
+		std::vector<std::uint64_t> ranks(RankCount(size));
+		std::uint64_t ones = 0;
+		for(size_t word = 0; word < words.size(); ++word) {
+			if(word % BlockWords == 0)
+				ranks[word / BlockWords] = ones;
+			ones += PopCount(words[word]);
+		}
+		// rank(size()) reads the entry after the last full block even if no word starts it
+		if(words.size() % BlockWords == 0)
+			ranks.back() = ones;
+
+		words_ = Storage<std::uint64_t>(std::move(words));
+		ranks_ = Storage<std::uint64_t>(std::move(ranks));
+	}
+
+	BitVector::BitVector(Storage<std::uint64_t> words, Storage<std::uint64_t> ranks, const size_t size) noexcept
+		: words_(std::move(words)),
+			ranks_(std::move(ranks)),
+			size_(size) {}
+
+	size_t BitVector::rank(const size_t index) const noexcept {
+		const auto word = index / WordBits;
+		const auto block = word / BlockWords;
+		auto ones = size_t(ranks_[block]);
+		for(auto i = block * BlockWords; i < word; ++i)
+			ones += PopCount(words_[i]);
+
+		const auto bits = index % WordBits;
+		if(bits != 0)
+			ones += PopCount(words_[word] << (WordBits - bits));
+		return ones;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "stringsearch/Compare.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define STRSEARCH_X64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#ifdef _MSC_VER
+#define STRSEARCH_TARGET_AVX2
+#else
+#define STRSEARCH_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace stringsearch {
+	namespace {
+		[[nodiscard]] size_t MismatchScalar(const char16_t *a, const char16_t *b, const size_t count, size_t i) noexcept {
+			while(i < count && a[i] == b[i])
+				++i;
+			return i;
+		}
+
+		[[nodiscard]] size_t CountTrailingZeros(const unsigned int mask) noexcept {
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward(&index, mask);
+			return index;
+#else
+			return size_t(__builtin_ctz(mask));
+#endif
+		}
+
+#ifdef STRSEARCH_X64
+		// SSE2 is part of x64, movemask sets two bits per code unit
+		[[nodiscard]] size_t MismatchSse2(const char16_t *a, const char16_t *b, const size_t count) noexcept {
+			size_t i = 0;
+			for(; i + 8 <= count; i += 8) {
+				const auto va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+				const auto vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+				const auto different = ~unsigned(_mm_movemask_epi8(_mm_cmpeq_epi16(va, vb))) & 0xFFFFu;
+				if(different != 0)
+					return i + CountTrailingZeros(different) / 2;
+			}
+			return MismatchScalar(a, b, count, i);
+		}
+
+		[[nodiscard]] STRSEARCH_TARGET_AVX2 size_t MismatchAvx2(const char16_t *a, const char16_t *b, const size_t count) noexcept {
+			size_t i = 0;
+			for(; i + 16 <= count; i += 16) {
+				const auto va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+				const auto vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+				const auto different = ~unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi16(va, vb)));
+				if(different != 0)
+					return i + CountTrailingZeros(different) / 2;
+			}
+			if(i + 8 <= count) {
+				const auto va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+				const auto vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+				const auto different = ~unsigned(_mm_movemask_epi8(_mm_cmpeq_epi16(va, vb))) & 0xFFFFu;
+				if(different != 0)
+					return i + CountTrailingZeros(different) / 2;
+				i += 8;
+			}
+			return MismatchScalar(a, b, count, i);
+		}
+
+		[[nodiscard]] bool HasAvx2() noexcept {
+#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 0);
+			if(info[0] < 7)
+				return false;
+			__cpuid(info, 1);
+			// The OS has to save the ymm registers
+			const auto osxsave = (info[2] & (1 << 27)) != 0;
+			if(!osxsave || (_xgetbv(0) & 6) != 6)
+				return false;
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+#else
+			return __builtin_cpu_supports("avx2");
+#endif
+		}
+#endif
+
+		using MismatchFunction = size_t (*)(const char16_t *, const char16_t *, size_t) noexcept;
+
+		struct MismatchKernel {
+			MismatchFunction Function;
+			const char *Name;
+		};
+
+		[[nodiscard]] MismatchKernel SelectMismatch() noexcept {
+#ifdef STRSEARCH_X64
+			if(HasAvx2())
+				return {MismatchAvx2, "AVX2"};
+			return {MismatchSse2, "SSE2"};
+#else
+			return {[](const char16_t *a, const char16_t *b, const size_t count) noexcept {
+				return MismatchScalar(a, b, count, 0);
+			}, "Scalar"};
+#endif
+		}
+
+		[[nodiscard]] const MismatchKernel &Kernel() noexcept {
+			static const auto kernel = SelectMismatch();
+			return kernel;
+		}
+	}
+
+	size_t MismatchLengthVectorized(const char16_t *a, const char16_t *b, const size_t count) noexcept {
+		return Kernel().Function(a, b, count);
+	}
+
+	const char *MismatchInstructionSet() noexcept {
+		return Kernel().Name;
+	}
+}
\ No newline at end of file
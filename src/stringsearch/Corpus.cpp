@@ -0,0 +1,380 @@
+#include "Corpus.h"
+#include "stringsearch/Definitions.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+
+namespace stringsearch {
+	namespace {
+		// Only the raw output of mt19937_64 is specified by the standard, the distributions are built on top of it
+		class Random {
+			std::mt19937_64 gen_;
+
+		public:
+			explicit Random(const std::uint64_t seed) : gen_(seed) {}
+
+			// Uniform in [0, count), the bias of the modulo is negligible for the small counts used here
+			size_t below(const size_t count) { return size_t(gen_() % count); }
+
+			size_t between(const size_t first, const size_t last) { return first + below(last - first + 1); }
+
+			// Uniform in [0, 1)
+			double unit() { return double(gen_() >> 11) * 0x1p-53; }
+
+			bool chance(const double probability) { return unit() < probability; }
+		};
+
+		// Rank r of count is drawn with a probability proportional to 1 / (r + 1)^exponent
+		class Zipf {
+			std::vector<double> cumulative_;
+
+		public:
+			Zipf(const size_t count, const double exponent) : cumulative_(count) {
+				double sum = 0;
+				for(size_t i = 0; i < count; ++i)
+					cumulative_[i] = sum += std::pow(double(i + 1), -exponent);
+			}
+
+			size_t operator()(Random &random) const {
+				const auto it = std::upper_bound(cumulative_.begin(), cumulative_.end(), random.unit() * cumulative_.back());
+				return std::min(size_t(it - cumulative_.begin()), cumulative_.size() - 1);
+			}
+		};
+
+		enum class Script { Latin, Cyrillic, Greek, Japanese };
+
+		// Words of testfiles/strings more frequent than most artist names, at the top of the Latin vocabulary
+		constexpr std::array<std::u16string_view, 24> FrequentWords {{
+			u"the", u"of", u"in", u"a", u"you", u"to", u"me", u"i", u"my", u"on", u"theme", u"video", u"die", u"and",
+			u"by", u"love", u"it", u"soundtrack", u"song", u"for", u"from", u"is", u"version", u"live"}};
+
+		struct Syllables {
+			Span<const std::u16string_view> Onsets;
+			Span<const std::u16string_view> Vowels;
+			Span<const std::u16string_view> Codas;
+		};
+
+		constexpr std::array<std::u16string_view, 30> LatinOnsets {{
+			u"b", u"c", u"d", u"f", u"g", u"h", u"j", u"k", u"l", u"m", u"n", u"p", u"r", u"s", u"t", u"v", u"w", u"z",
+			u"br", u"ch", u"cr", u"dr", u"fl", u"gr", u"kr", u"pl", u"sh", u"st", u"th", u"tr"}};
+		constexpr std::array<std::u16string_view, 10> LatinVowels {{u"a", u"e", u"i", u"o", u"u", u"y", u"ai", u"ea", u"ou", u"ee"}};
+		constexpr std::array<std::u16string_view, 12> LatinCodas {{u"", u"", u"", u"n", u"r", u"s", u"l", u"t", u"ck", u"nd", u"ng", u"x"}};
+		constexpr std::array<std::u16string_view, 17> CyrillicOnsets {{
+			u"б", u"в", u"г", u"д", u"ж", u"з", u"к", u"л", u"м", u"н", u"п", u"р", u"с", u"т", u"х", u"ч", u"ш"}};
+		constexpr std::array<std::u16string_view, 8> CyrillicVowels {{u"а", u"е", u"и", u"о", u"у", u"ы", u"я", u"ю"}};
+		constexpr std::array<std::u16string_view, 5> CyrillicCodas {{u"", u"", u"н", u"й", u"т"}};
+		constexpr std::array<std::u16string_view, 13> GreekOnsets {{
+			u"β", u"γ", u"δ", u"κ", u"λ", u"μ", u"ν", u"π", u"ρ", u"σ", u"τ", u"φ", u"χ"}};
+		constexpr std::array<std::u16string_view, 7> GreekVowels {{u"α", u"ε", u"η", u"ι", u"ο", u"υ", u"ω"}};
+		constexpr std::array<std::u16string_view, 3> GreekCodas {{u"", u"ς", u"ν"}};
+
+		// Umlauts and accents of the German, French and Spanish titles of the sample
+		constexpr std::array<std::pair<char16_t, char16_t>, 5> Accents {{
+			{u'a', u'ä'}, {u'o', u'ö'}, {u'u', u'ü'}, {u'e', u'é'}, {u'i', u'í'}}};
+
+		// Tags at the end of an item and their number of occurrences in testfiles/strings
+		constexpr std::array<std::pair<std::u16string_view, int>, 24> Tags {{
+			{u" (official video)", 347}, {u" (official music video)", 200}, {u" [official video]", 71},
+			{u" (official lyric video)", 44}, {u" (official audio)", 40}, {u" [official music video]", 33}, {u" (audio)", 24},
+			{u" (lyrics english & deutsch)", 18}, {u" (official)", 17}, {u" [monstercat release]", 13},
+			{u" (original mix)", 13}, {u" [offizielles musikvideo]", 13}, {u" (lyric video)", 12}, {u" [official audio]", 12},
+			{u" (lyrics)", 12}, {u" (video)", 12}, {u" (hq)", 12}, {u" [hd]", 12}, {u" (radio edit)", 12},
+			{u" (remastered 2007)", 11}, {u" (music video)", 11}, {u" [hq]", 9}, {u" (remix)", 8}, {u" [ncs release]", 8}}};
+
+		constexpr std::array<std::pair<std::u16string_view, int>, 4> Separators {{
+			{u" - ", 80}, {u" – ", 12}, {u" | ", 5}, {u" — ", 3}}};
+
+		constexpr std::array<std::u16string_view, 5> Collaborations {{u" feat. ", u" ft. ", u" & ", u" x ", u", "}};
+
+		// Appended to a word of syllables by CatalogQuery::Miss, no item contains a q followed by a z
+		constexpr std::u16string_view MissMarker = u"qz";
+
+		template<typename T, size_t N>
+		const T &PickWeighted(Random &random, const std::array<std::pair<T, int>, N> &values) {
+			int sum = 0;
+			for(const auto &value : values)
+				sum += value.second;
+			auto pick = int(random.below(size_t(sum)));
+			for(const auto &value : values) {
+				if(pick < value.second)
+					return value.first;
+				pick -= value.second;
+			}
+			return values.back().first;
+		}
+
+		template<typename Array>
+		std::u16string_view Pick(Random &random, const Array &values) {
+			return values[random.below(values.size())];
+		}
+
+		std::u16string SyllableWord(Random &random, const Syllables &syllables, const size_t count) {
+			std::u16string word;
+			for(size_t i = 0; i < count; ++i) {
+				word += syllables.Onsets[random.below(syllables.Onsets.size())];
+				word += syllables.Vowels[random.below(syllables.Vowels.size())];
+			}
+			word += syllables.Codas[random.below(syllables.Codas.size())];
+			return word;
+		}
+
+		Syllables ScriptSyllables(const Script script) {
+			switch(script) {
+			case Script::Cyrillic:
+				return {CyrillicOnsets, CyrillicVowels, CyrillicCodas};
+			case Script::Greek:
+				return {GreekOnsets, GreekVowels, GreekCodas};
+			default:
+				return {LatinOnsets, LatinVowels, LatinCodas};
+			}
+		}
+
+		// Kanji, hiragana and katakana, the kanji from a fixed set of 2000 so that they repeat like real ones
+		std::u16string JapaneseWord(Random &random) {
+			std::u16string word;
+			const auto length = random.between(1, 4);
+			for(size_t i = 0; i < length; ++i) {
+				const auto kind = random.below(10);
+				if(kind < 5)
+					word += char16_t(0x4E00 + random.below(2000) * 10);
+				else if(kind < 8)
+					word += char16_t(0x3042 + random.below(0x50));
+				else
+					word += char16_t(0x30A2 + random.below(0x50));
+			}
+			return word;
+		}
+
+		std::u16string Word(Random &random, const Script script) {
+			if(script == Script::Japanese)
+				return JapaneseWord(random);
+
+			auto word = SyllableWord(random, ScriptSyllables(script), random.between(1, 3));
+			if(script == Script::Latin && random.chance(0.03)) {
+				for(auto &character : word) {
+					const auto accent = std::find_if(Accents.begin(), Accents.end(), [&](const auto &a) { return a.first == character; });
+					if(accent != Accents.end()) {
+						character = accent->second;
+						break;
+					}
+				}
+			}
+			return word;
+		}
+
+		// Words of a script ordered by their frequency rank
+		struct Vocabulary {
+			Script Kind;
+			std::vector<std::u16string> Words;
+			Zipf Ranks;
+
+			Vocabulary(Random &random, const Script script, const size_t count) : Kind(script), Ranks(count, 0.9) {
+				Words.reserve(count);
+				if(script == Script::Latin) {
+					for(size_t i = 0; i < FrequentWords.size() && Words.size() < count; ++i)
+						Words.emplace_back(FrequentWords[i]);
+				}
+				while(Words.size() < count)
+					Words.emplace_back(Word(random, script));
+			}
+
+			const std::u16string &operator()(Random &random) const { return Words[Ranks(random)]; }
+
+			// Japanese is written without spaces between the words
+			[[nodiscard]] std::u16string_view space() const { return Kind == Script::Japanese ? u"" : u" "; }
+		};
+
+		struct Artist {
+			std::u16string Name;
+			size_t Vocabulary;
+		};
+
+		constexpr std::array<Script, 4> Scripts {{Script::Latin, Script::Cyrillic, Script::Greek, Script::Japanese}};
+
+		// Share of the non-Latin items per script, Japanese is the most frequent in the sample
+		constexpr std::array<double, 4> NonLatinScriptShares {{0, 0.3, 0.1, 0.6}};
+
+		class CatalogGenerator {
+			const CatalogOptions &options_;
+			Random random_;
+			std::vector<Vocabulary> vocabularies_;
+			std::vector<Artist> artists_;
+			Zipf artistRanks_;
+
+			size_t script(const double unit) const {
+				if(unit >= options_.NonLatinShare)
+					return 0;
+				auto share = unit / options_.NonLatinShare;
+				for(size_t i = 1; i < NonLatinScriptShares.size(); ++i) {
+					if(share < NonLatinScriptShares[i])
+						return i;
+					share -= NonLatinScriptShares[i];
+				}
+				return NonLatinScriptShares.size() - 1;
+			}
+
+			const Artist &artist() { return artists_[artistRanks_(random_)]; }
+
+		public:
+			// Heaps' law fitted to the sample, about 7100 distinct words in 142000 characters
+			static size_t VocabularySize(const size_t characters) {
+				return std::max<size_t>(64, size_t(36 * std::sqrt(double(characters))));
+			}
+
+			// A few artists have dozens of items, most only one or two
+			static size_t ArtistCount(const size_t characters) {
+				return std::max<size_t>(16, characters / 160);
+			}
+
+			explicit CatalogGenerator(const CatalogOptions &options) : options_(options), random_(options.Seed),
+				artistRanks_(ArtistCount(options.Characters), 0.6) {
+				const auto words = VocabularySize(options.Characters);
+				for(size_t i = 0; i < Scripts.size(); ++i) {
+					const auto share = i == 0 ? 1 - options.NonLatinShare : options.NonLatinShare * NonLatinScriptShares[i];
+					vocabularies_.emplace_back(random_, Scripts[i], std::max<size_t>(16, size_t(double(words) * share)));
+				}
+
+				// Names aren't drawn from the vocabulary, most of them are as rare as the rare words
+				artists_.resize(ArtistCount(options.Characters));
+				for(auto &artist : artists_) {
+					artist.Vocabulary = script(random_.unit());
+					const auto &vocabulary = vocabularies_[artist.Vocabulary];
+					if(vocabulary.Kind == Script::Latin && random_.chance(0.05))
+						artist.Name = u"the ";
+					const auto length = random_.between(1, 3);
+					for(size_t i = 0; i < length; ++i) {
+						if(i != 0)
+							artist.Name += vocabulary.space();
+						artist.Name += Word(random_, vocabulary.Kind);
+					}
+				}
+			}
+
+			void appendItem(std::u16string &text) {
+				const auto &first = artist();
+				const auto &vocabulary = vocabularies_[first.Vocabulary];
+				text += first.Name;
+				if(random_.chance(0.12)) {
+					text += Pick(random_, Collaborations);
+					text += artist().Name;
+				}
+				text += PickWeighted(random_, Separators);
+
+				const auto words = random_.between(1, 5);
+				for(size_t i = 0; i < words; ++i) {
+					if(i != 0)
+						text += vocabulary.space();
+					text += vocabulary(random_);
+				}
+
+				if(random_.chance(0.05)) {
+					text += u" (feat. ";
+					text += artist().Name;
+					text += u')';
+				}
+				if(random_.chance(options_.TagShare)) {
+					if(vocabulary.Kind == Script::Japanese && random_.chance(0.5))
+						text += u"（full ver.）";
+					else
+						text += PickWeighted(random_, Tags);
+				}
+				text += char16_t(0);
+			}
+
+			std::u16string generate() {
+				std::u16string text;
+				text.reserve(options_.Characters + 256);
+				std::vector<size_t> starts;
+				while(text.size() < options_.Characters) {
+					if(!starts.empty() && random_.chance(options_.DuplicateShare)) {
+						const auto start = starts[random_.below(starts.size())];
+						const auto item = text.substr(start, text.find(char16_t(0), start) + 1 - start);
+						starts.emplace_back(text.size());
+						text += item;
+						continue;
+					}
+					starts.emplace_back(text.size());
+					appendItem(text);
+				}
+				return text;
+			}
+		};
+
+		// Positions of the first character of every item
+		std::vector<size_t> ItemStarts(const std::u16string_view catalog) {
+			std::vector<size_t> starts;
+			for(size_t start = 0; start < catalog.size();) {
+				const auto end = catalog.find(char16_t(0), start);
+				if(end == std::u16string_view::npos)
+					break;
+				if(end != start)
+					starts.emplace_back(start);
+				start = end + 1;
+			}
+			return starts;
+		}
+
+		std::vector<std::u16string_view> ItemWords(const std::u16string_view item) {
+			std::vector<std::u16string_view> words;
+			for(size_t begin = 0; begin < item.size();) {
+				const auto end = std::min(item.find(u' ', begin), item.size());
+				if(end != begin)
+					words.emplace_back(item.substr(begin, end - begin));
+				begin = end + 1;
+			}
+			return words;
+		}
+	}
+
+	std::u16string GenerateCatalog(const CatalogOptions &options) {
+		return CatalogGenerator(options).generate();
+	}
+
+	std::vector<std::u16string> GenerateCatalogQueries(const std::u16string_view catalog, const CatalogQuery kind,
+																		const size_t count, const std::uint64_t seed) {
+		const auto starts = ItemStarts(catalog);
+		if(starts.empty())
+			return {};
+
+		Random random(seed);
+		std::vector<std::u16string> queries;
+		queries.reserve(count);
+		while(queries.size() < count) {
+			const auto start = starts[random.below(starts.size())];
+			const auto item = catalog.substr(start, catalog.find(char16_t(0), start) - start);
+			switch(kind) {
+			case CatalogQuery::Substring: {
+				const auto offset = random.below(item.size());
+				queries.emplace_back(item.substr(offset, random.between(1, 6)));
+				break;
+			}
+			case CatalogQuery::WordPrefix: {
+				const auto words = ItemWords(item);
+				const auto word = words[random.below(words.size())];
+				const auto offset = size_t(word.data() - item.data());
+				queries.emplace_back(item.substr(offset, random.between(1, 16)));
+				break;
+			}
+			case CatalogQuery::Keywords: {
+				const auto words = ItemWords(item);
+				const auto first = random.below(words.size());
+				auto query = std::u16string(words[first]);
+				if(words.size() > 1) {
+					const auto second = (first + random.between(1, words.size() - 1)) % words.size();
+					query = std::u16string(words[second]) + u' ' + query;
+				}
+				queries.emplace_back(std::move(query));
+				break;
+			}
+			case CatalogQuery::Miss: {
+				const Syllables latin{LatinOnsets, LatinVowels, LatinCodas};
+				queries.emplace_back(SyllableWord(random, latin, 1) + std::u16string(MissMarker) + SyllableWord(random, latin, 1));
+				break;
+			}
+			}
+		}
+		return queries;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace stringsearch {
+	// Synthetic catalogs shaped like testfiles/strings: song titles of the form "artist - title (tag)". Artists and words
+	// are drawn from Zipf distributions whose vocabularies grow with the square root of the size, about 3% of the items
+	// are Cyrillic, Greek or Japanese, a third end in one of a few repeated tags and a few are exact duplicates.
+	// The output only depends on the arguments, the random numbers don't use the implementation defined distributions
+	// of <random>.
+	struct CatalogOptions {
+		// Characters of the catalog including the 0 after every item, the last item may end up to one item later
+		size_t Characters = 1 << 20;
+		std::uint64_t Seed = 42;
+		double NonLatinShare = 0.03;
+		double TagShare = 0.35;
+		double DuplicateShare = 0.002;
+	};
+
+	// Items terminated by a 0 each, like the characters read from testfiles/strings
+	[[nodiscard]] std::u16string GenerateCatalog(const CatalogOptions &options);
+
+	enum class CatalogQuery {
+		// Up to 6 characters at a random position, like BenchmarkSAFind
+		Substring,
+		// The first 1 to 16 characters from the start of a word, like a user typing
+		WordPrefix,
+		// Two words of the same item in random order, separated by a space
+		Keywords,
+		// A word made of the syllables of the catalog that is not in it, for the cost of an empty result
+		Miss
+	};
+
+	// count queries of kind against a catalog returned by GenerateCatalog. Queries hit items uniformly, so frequent
+	// artists and words are queried as often as they occur.
+	[[nodiscard]] std::vector<std::u16string> GenerateCatalogQueries(std::u16string_view catalog, CatalogQuery kind,
+																						size_t count, std::uint64_t seed = 42);
+}
\ No newline at end of file
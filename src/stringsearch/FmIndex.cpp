@@ -0,0 +1,222 @@
+#include "stringsearch/FmIndex.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace stringsearch {
+	namespace {
+		template<typename T>
+		[[nodiscard]] size_t Bytes(const Span<const T> array) noexcept {
+			return array.size() * sizeof(T);
+		}
+
+		[[nodiscard]] size_t BitVectorBytes(const size_t size) noexcept {
+			return (BitVector::WordCount(size) + BitVector::RankCount(size)) * sizeof(std::uint64_t);
+		}
+
+		[[nodiscard]] size_t BitVectorBytes(const BitVector &bits) noexcept {
+			return Bytes(bits.wordsArray()) + Bytes(bits.ranksArray());
+		}
+
+		[[nodiscard]] bool FitsIndex(const size_t characters) noexcept {
+			return characters <= size_t(std::numeric_limits<Index>::max());
+		}
+	}
+
+	FmIndex::FmIndex(const std::u16string_view text, const BuildOptions &options)
+		: sampleRate_(std::max<size_t>(1, options.SampleRate)) {
+		if(text.size() / sampleRate_ > size_t(std::numeric_limits<std::uint32_t>::max()))
+			throw std::length_error("Text too long for the samples of an FmIndex");
+
+		if(FitsIndex(text.size()))
+			build<Index>(text, options);
+		else
+			build<std::int64_t>(text, options);
+	}
+
+	template<typename T>
+	void FmIndex::build(const std::u16string_view text, const BuildOptions &options) {
+		const auto rows = text.size() + 1;
+		std::vector<T> values(rows);
+		values[0] = T(text.size());
+		CreateArray(text, Span<T>(values).subspan(1), options);
+
+		// Symbol of every code unit, 0 if it isn't in the text
+		std::vector<std::uint32_t> symbols(0x10000);
+		for(const auto c : text)
+			symbols[c] = 1;
+		std::vector<char16_t> alphabet;
+		for(size_t c = 0; c < symbols.size(); ++c) {
+			if(symbols[c] != 0) {
+				alphabet.emplace_back(char16_t(c));
+				symbols[c] = std::uint32_t(alphabet.size());
+			}
+		}
+
+		// The end of the text once, then the characters
+		std::vector<std::uint64_t> starts(alphabet.size() + 2);
+		starts[1] = 1;
+		for(const auto c : text)
+			++starts[symbols[c] + 1];
+		for(size_t s = 1; s < starts.size(); ++s)
+			starts[s] += starts[s - 1];
+
+		// Every entry is replaced by the symbol before it once its position is sampled
+		std::vector<std::uint64_t> sampledWords(BitVector::WordCount(rows));
+		std::vector<std::uint32_t> samples;
+		samples.reserve(text.size() / sampleRate_ + 1);
+		for(size_t row = 0; row < rows; ++row) {
+			const auto position = size_t(values[row]);
+			if(position % sampleRate_ == 0) {
+				sampledWords[row / BitVector::WordBits] |= std::uint64_t(1) << (row % BitVector::WordBits);
+				samples.emplace_back(std::uint32_t(position / sampleRate_));
+			}
+			values[row] = T(position == 0 ? 0 : symbols[text[position - 1]]);
+		}
+
+		sampled_ = BitVector(std::move(sampledWords), rows);
+		samples_ = Storage<std::uint32_t>(std::move(samples));
+		bwt_ = WaveletMatrix(std::move(values), WaveletMatrix::LevelCount(alphabet.size()));
+		alphabet_ = Storage<char16_t>(std::move(alphabet));
+		starts_ = Storage<std::uint64_t>(std::move(starts));
+	}
+
+	size_t FmIndex::symbol(const char16_t c) const noexcept {
+		const auto it = std::lower_bound(alphabet_.begin(), alphabet_.end(), c);
+		return it != alphabet_.end() && *it == c ? size_t(it - alphabet_.begin()) + 1 : 0;
+	}
+
+	FmRange FmIndex::find(const std::u16string_view pattern) const noexcept {
+		if(pattern.empty())
+			return {1, size()};
+
+		FmRange range{0, size()};
+		for(auto it = pattern.rbegin(); it != pattern.rend() && range.Begin < range.End; ++it) {
+			const auto s = symbol(*it);
+			if(s == 0)
+				return {0, 0};
+
+			const auto [begin, end] = bwt_.rank(s, range.Begin, range.End);
+			range = FmRange{start(s) + begin, start(s) + end};
+		}
+		return range;
+	}
+
+	size_t FmIndex::locate(size_t row) const noexcept {
+		// Position 0 is sampled, so the walk never passes the end of the text
+		size_t steps = 0;
+		for(; !sampled(row); ++steps) {
+			const auto [symbol, rank] = previous(row);
+			row = previousRow(symbol, rank);
+		}
+		return sampledPosition(row) + steps;
+	}
+
+	FmItemsLookup::FmItemsLookup(const std::u16string_view text, const FmIndex &index)
+		: ItemsLookup(text),
+			index_(index),
+			separator_(index.symbol(u'\0')) {
+		if(separator_ == 0)
+			return;
+
+		// The LF mapping keeps the order of the rows with the same symbol, so the i-th row after a \0 is the one before
+		// the i-th row starting with \0
+		std::vector<Index> itemStarts(index.start(separator_ + 1) - index.start(separator_));
+		for(size_t i = 0; i < itemStarts.size(); ++i)
+			itemStarts[i] = getItem(index.locate(index.start(separator_) + i) + 1);
+		itemStarts_ = Storage<Index>(std::move(itemStarts));
+	}
+
+	Index FmItemsLookup::itemOf(size_t row) const noexcept {
+		while(!index_.sampled(row)) {
+			const auto [symbol, rank] = index_.previous(row);
+			if(symbol == separator_ && separator_ != 0)
+				return itemStarts_[rank];
+
+			row = index_.previousRow(symbol, rank);
+		}
+		// No \0 was passed, the sampled position is in the same item
+		return getItem(index_.sampledPosition(row));
+	}
+
+	size_t FmItemsLookup::countDistinct(const FmRange range) const {
+		return uniqueItems(range).size();
+	}
+
+	FindUniqueResult FmItemsLookup::findUnique(const FmRange range, const Span<Index> outputItems, const size_t offset) const {
+		std::unordered_set<Index> seen;
+		for(auto row = range.Begin; row < range.Begin + offset; ++row)
+			seen.insert(itemOf(row));
+		return findUnique(range, outputItems, offset, seen);
+	}
+
+	FindUniqueResult FmItemsLookup::findUnique(const FmRange range, const Span<Index> outputItems, const size_t offset,
+												std::unordered_set<Index> &seen) const {
+		// Like BasicUniqueSearchLookup::findUnique the page ends at the first entry of the next item, which stays out of
+		// seen for the next page
+		size_t count = 0;
+		for(auto row = range.Begin + offset; row < range.End; ++row) {
+			const auto item = itemOf(row);
+			if(seen.count(item) != 0)
+				continue;
+			if(count == outputItems.size())
+				return {count, row - range.Begin};
+			seen.insert(item);
+			outputItems[count++] = item;
+		}
+		return {count, range.size()};
+	}
+
+	std::vector<Index> FmItemsLookup::uniqueItems(const FmRange range) const {
+		std::vector<Index> items(range.size());
+		for(size_t i = 0; i < items.size(); ++i)
+			items[i] = itemOf(range.Begin + i);
+		std::sort(items.begin(), items.end());
+		items.erase(std::unique(items.begin(), items.end()), items.end());
+		return items;
+	}
+
+	std::vector<Index> FmItemsLookup::itemsContainedIn(const Span<const Index> items, const FmRange range) const {
+		const auto contained = uniqueItems(range);
+		std::vector<Index> both;
+		std::set_intersection(items.begin(), items.end(), contained.begin(), contained.end(), std::back_inserter(both));
+		return both;
+	}
+
+	MemoryUsage EstimateFmMemoryUsage(const size_t characters, const size_t items, const size_t alphabet, const BuildOptions &options) {
+		const auto rows = characters + 1;
+		const auto value = FitsIndex(characters) ? sizeof(Index) : sizeof(std::int64_t);
+		MemoryUsage usage;
+		usage.SuffixArray = BitVectorBytes(rows) + (characters / std::max<size_t>(1, options.SampleRate) + 1) * sizeof(std::uint32_t);
+		usage.ItemEnds = BitVectorBytes(characters) + items * sizeof(Index);
+		usage.Bwt = BitVectorBytes(WaveletMatrix::LevelCount(alphabet) * rows) + alphabet * sizeof(char16_t)
+			+ (alphabet + 2) * sizeof(std::uint64_t);
+
+		// The suffix array, then the samples and the BWT in its place, its partitioned copy and the bits next to the
+		// symbol of every code unit
+		const auto peak = std::max(rows * value + SuffixSortScratch(characters, value, options),
+			usage.SuffixArray + 2 * rows * value + usage.Bwt + 0x10000 * sizeof(std::uint32_t));
+		usage.BuildPeak = std::max(peak, usage.total());
+		return usage;
+	}
+
+	FmSearch::FmSearch(const std::u16string_view text, const BuildOptions &options)
+		: index_(text, options),
+			itemsLookup_(text, index_),
+			buildPeak_(EstimateFmMemoryUsage(text.size(), itemsLookup_.itemCount(), index_.alphabetArray().size(), options).BuildPeak) {}
+
+	FmRange FmSearch::refine(FmRange, size_t, const std::u16string_view pattern) const noexcept {
+		return index_.find(pattern);
+	}
+
+	MemoryUsage FmSearch::memoryUsage() const noexcept {
+		MemoryUsage usage;
+		usage.SuffixArray = BitVectorBytes(index_.sampledRows()) + Bytes(index_.samplesArray());
+		usage.ItemEnds = BitVectorBytes(itemsLookup_.itemEnds()) + Bytes(itemsLookup_.itemStartsArray());
+		usage.Bwt = BitVectorBytes(index_.bwt().bits()) + Bytes(index_.alphabetArray()) + Bytes(index_.startsArray());
+		usage.BuildPeak = buildPeak_;
+		return usage;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,363 @@
+#include "stringsearch/IndexFile.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace stringsearch {
+	namespace {
+		struct SectionData {
+			IndexFileSectionId Id;
+			std::uint32_t ElementSize;
+			const void *Data;
+			std::uint64_t Count;
+		};
+
+		template<typename T>
+		SectionData MakeSection(const IndexFileSectionId id, const Span<const T> data) {
+			return SectionData{id, std::uint32_t(sizeof(T)), data.data(), data.size()};
+		}
+
+		std::uint64_t AlignUp(const std::uint64_t offset) {
+			return (offset + IndexFileAlignment - 1) / IndexFileAlignment * IndexFileAlignment;
+		}
+
+		const IndexFileSection *FindSection(const Span<const IndexFileSection> sections, const IndexFileSectionId id) {
+			const auto it = std::find_if(sections.begin(), sections.end(), [&](const IndexFileSection &section) {
+				return section.Id == id;
+			});
+			return it == sections.end() ? nullptr : &*it;
+		}
+
+		template<typename T>
+		Span<const T> GetSection(const Span<const std::byte> bytes, const IndexFileSection &section) {
+			const auto id = section.Id;
+			if(section.ElementSize != sizeof(T))
+				throw std::runtime_error("Index file section " + std::to_string(std::uint32_t(id)) + " has an unexpected element size");
+			if(section.Offset % alignof(T) != 0 || section.Offset > bytes.size() || section.Count > (bytes.size() - section.Offset) / sizeof(T))
+				throw std::runtime_error("Index file section " + std::to_string(std::uint32_t(id)) + " is out of bounds");
+			return Span<const T>(reinterpret_cast<const T *>(bytes.data() + section.Offset), size_t(section.Count));
+		}
+
+		template<typename T>
+		Span<const T> GetSection(const Span<const std::byte> bytes, const Span<const IndexFileSection> sections, const IndexFileSectionId id) {
+			const auto section = FindSection(sections, id);
+			if(!section)
+				throw std::runtime_error("Index file is missing section " + std::to_string(std::uint32_t(id)));
+			return GetSection<T>(bytes, *section);
+		}
+
+		// Empty if the section is missing or empty, otherwise it has to have count elements
+		template<typename T>
+		Span<const T> GetOptionalSection(const Span<const std::byte> bytes, const Span<const IndexFileSection> sections, const IndexFileSectionId id, const size_t count) {
+			const auto section = FindSection(sections, id);
+			if(!section)
+				return {};
+
+			const auto data = GetSection<T>(bytes, *section);
+			if(!data.empty() && data.size() != count)
+				throw std::runtime_error("Index file section " + std::to_string(std::uint32_t(id)) + " doesn't match the text size");
+			return data;
+		}
+
+		// Throws unless ranks are the ones BitVector counts for words of size bits, whose unused bits are 0. Returns the
+		// number of ones.
+		std::uint64_t CheckRanks(const Span<const std::uint64_t> words, const Span<const std::uint64_t> ranks, const size_t size, const char *name) {
+			const auto unused = words.size() * BitVector::WordBits - size;
+			if(unused != 0 && words.back() >> (BitVector::WordBits - unused) != 0)
+				throw std::runtime_error(std::string("Index file ") + name + " has bits behind the end");
+
+			std::uint64_t ones = 0;
+			for(size_t word = 0; word < words.size(); ++word) {
+				if(word % BitVector::BlockWords == 0 && ranks[word / BitVector::BlockWords] != ones)
+					throw std::runtime_error(std::string("Index file ") + name + " ranks don't match the bits");
+				ones += std::bitset<BitVector::WordBits>(words[word]).count();
+			}
+			if(words.size() % BitVector::BlockWords == 0 && ranks.back() != ones)
+				throw std::runtime_error(std::string("Index file ") + name + " ranks don't match the bits");
+			return ones;
+		}
+
+		// Throws unless every value is in [lower, upper], ascending if sorted
+		template<typename IndexT>
+		void CheckValues(const Span<const IndexT> values, const std::int64_t lower, const std::int64_t upper, const bool sorted, const char *name) {
+			auto previous = lower;
+			for(const IndexValue<IndexT> value : values) {
+				if(value < (sorted ? previous : lower) || value > upper)
+					throw std::runtime_error(std::string("Index file ") + name + " is out of bounds");
+				previous = value;
+			}
+		}
+	}
+
+	template<typename IndexT>
+	void WriteIndexFile(const BasicSearch<IndexT> &search, const char *path) {
+		const auto data = search.data();
+		const std::array<SectionData, 13> sectionData{{
+			MakeSection(IndexFileSectionId::Text, Span<const char16_t>(data.Text.data(), data.Text.size())),
+			MakeSection(IndexFileSectionId::SuffixArray, data.Suffixes),
+			MakeSection(IndexFileSectionId::ItemEnds, data.ItemEnds),
+			MakeSection(IndexFileSectionId::ItemEndRanks, data.ItemEndRanks),
+			MakeSection(IndexFileSectionId::PreviousEntryOfSameItem, data.PreviousEntryOfSameItem),
+			MakeSection(IndexFileSectionId::LcpLeft, data.LcpLeft),
+			MakeSection(IndexFileSectionId::LcpRight, data.LcpRight),
+			MakeSection(IndexFileSectionId::PrefixStarts, data.PrefixStarts),
+			MakeSection(IndexFileSectionId::PrefixBigrams, data.PrefixBigrams),
+			MakeSection(IndexFileSectionId::PrefixBigramStarts, data.PrefixBigramStarts),
+			MakeSection(IndexFileSectionId::UniqueRangeMinimum, data.UniqueRangeMinimum),
+			MakeSection(IndexFileSectionId::DistinctWords, data.DistinctWords),
+			MakeSection(IndexFileSectionId::DistinctRanks, data.DistinctRanks)
+		}};
+
+		IndexFileHeader header{};
+		std::memcpy(header.Magic, IndexFileMagic, sizeof(header.Magic));
+		header.Version = IndexFileVersion;
+		header.ByteOrderMark = IndexFileByteOrderMark;
+		header.IndexSize = sizeof(IndexT);
+		header.SectionCount = std::uint32_t(sectionData.size());
+		header.ItemCount = data.ItemCount;
+
+		std::vector<IndexFileSection> sections;
+		auto offset = AlignUp(sizeof(IndexFileHeader) + sectionData.size() * sizeof(IndexFileSection));
+		for(const auto &section : sectionData) {
+			sections.emplace_back(IndexFileSection{section.Id, section.ElementSize, offset, section.Count});
+			offset = AlignUp(offset + section.Count * section.ElementSize);
+		}
+
+		std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+		if(!stream)
+			throw std::runtime_error(std::string("Failed to open ") + path + " for writing");
+
+		stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		stream.write(reinterpret_cast<const char *>(sections.data()), std::streamsize(sections.size() * sizeof(IndexFileSection)));
+
+		const std::array<char, IndexFileAlignment> padding{};
+		auto written = std::uint64_t(sizeof(header) + sections.size() * sizeof(IndexFileSection));
+		for(size_t i = 0; i < sections.size(); ++i) {
+			stream.write(padding.data(), std::streamsize(sections[i].Offset - written));
+			const auto size = sectionData[i].Count * sectionData[i].ElementSize;
+			stream.write(static_cast<const char *>(sectionData[i].Data), std::streamsize(size));
+			written = sections[i].Offset + size;
+		}
+
+		if(!stream.flush())
+			throw std::runtime_error(std::string("Failed to write ") + path);
+	}
+
+	size_t ReadIndexFileIndexSize(const Span<const std::byte> bytes) {
+		IndexFileHeader header{};
+		if(bytes.size() < sizeof(header))
+			throw std::runtime_error("Index file is too small");
+		std::memcpy(&header, bytes.data(), sizeof(header));
+		return header.IndexSize;
+	}
+
+	template<typename IndexT>
+	BasicSearchData<IndexT> ReadIndexFile(const Span<const std::byte> bytes) {
+		IndexFileHeader header{};
+		if(bytes.size() < sizeof(header))
+			throw std::runtime_error("Index file is too small");
+		std::memcpy(&header, bytes.data(), sizeof(header));
+
+		if(std::memcmp(header.Magic, IndexFileMagic, sizeof(header.Magic)) != 0)
+			throw std::runtime_error("Not an index file");
+		if(header.Version != IndexFileVersion)
+			throw std::runtime_error("Unsupported index file version " + std::to_string(header.Version));
+		if(header.ByteOrderMark != IndexFileByteOrderMark)
+			throw std::runtime_error("Index file was written with a different byte order");
+		if(header.IndexSize != sizeof(IndexT))
+			throw std::runtime_error("Index file was written with a different index size");
+		if(header.SectionCount > (bytes.size() - sizeof(header)) / sizeof(IndexFileSection))
+			throw std::runtime_error("Index file section table is out of bounds");
+
+		const auto sections = Span<const IndexFileSection>(reinterpret_cast<const IndexFileSection *>(bytes.data() + sizeof(header)), header.SectionCount);
+		const auto text = GetSection<char16_t>(bytes, sections, IndexFileSectionId::Text);
+		const auto suffixes = GetSection<IndexT>(bytes, sections, IndexFileSectionId::SuffixArray);
+		const auto itemEnds = GetSection<std::uint64_t>(bytes, sections, IndexFileSectionId::ItemEnds);
+		const auto itemEndRanks = GetSection<std::uint64_t>(bytes, sections, IndexFileSectionId::ItemEndRanks);
+		const auto previous = GetSection<IndexT>(bytes, sections, IndexFileSectionId::PreviousEntryOfSameItem);
+
+		if(suffixes.size() != text.size() || previous.size() != text.size()
+			|| itemEnds.size() != BitVector::WordCount(text.size()) || itemEndRanks.size() != BitVector::RankCount(text.size()))
+			throw std::runtime_error("Index file sections don't match the text size");
+
+		const auto lcpLeft = GetOptionalSection<std::uint16_t>(bytes, sections, IndexFileSectionId::LcpLeft, text.size());
+		const auto lcpRight = GetOptionalSection<std::uint16_t>(bytes, sections, IndexFileSectionId::LcpRight, text.size());
+		if(lcpLeft.size() != lcpRight.size())
+			throw std::runtime_error("Index file has an incomplete lcp table");
+
+		const auto prefixStarts = GetOptionalSection<IndexT>(bytes, sections, IndexFileSectionId::PrefixStarts, 0x10001);
+		const auto prefixBigrams = prefixStarts.empty() ? Span<const std::uint32_t>() : GetSection<std::uint32_t>(bytes, sections, IndexFileSectionId::PrefixBigrams);
+		const auto prefixBigramStarts = prefixStarts.empty() ? Span<const IndexT>() : GetSection<IndexT>(bytes, sections, IndexFileSectionId::PrefixBigramStarts);
+		if(prefixBigrams.size() != prefixBigramStarts.size())
+			throw std::runtime_error("Index file has an incomplete prefix table");
+		if(!prefixStarts.empty() && size_t(prefixStarts[0x10000]) != text.size())
+			throw std::runtime_error("Index file prefix table doesn't match the text size");
+
+		// The prefix table is small, the arrays of n entries are only read by VerifyIndexFile so loading touches no pages
+		// of them
+		CheckValues(prefixStarts, 0, std::int64_t(text.size()), true, "prefix table");
+		for(size_t i = 0; i < prefixBigrams.size(); ++i) {
+			// Ascending bigrams whose ranges start in the range of their first character
+			const auto first = size_t(prefixBigrams[i] >> 16);
+			const IndexValue<IndexT> start = prefixBigramStarts[i];
+			if((i > 0 && prefixBigrams[i] <= prefixBigrams[i - 1]) || start < IndexValue<IndexT>(prefixStarts[first])
+				|| start > IndexValue<IndexT>(prefixStarts[first + 1]))
+				throw std::runtime_error("Index file prefix bigram table is out of bounds");
+		}
+
+		const auto rangeMinimum = GetOptionalSection<IndexT>(bytes, sections, IndexFileSectionId::UniqueRangeMinimum, RangeMinimum::SparseSize(text.size()));
+
+		const auto distinctBits = text.size() * WaveletMatrix::LevelCount(text.size());
+		const auto distinctWords = GetOptionalSection<std::uint64_t>(bytes, sections, IndexFileSectionId::DistinctWords, BitVector::WordCount(distinctBits));
+		const auto distinctRanks = distinctWords.empty() ? Span<const std::uint64_t>() : GetOptionalSection<std::uint64_t>(bytes, sections, IndexFileSectionId::DistinctRanks, BitVector::RankCount(distinctBits));
+		if(distinctWords.empty() != distinctRanks.empty())
+			throw std::runtime_error("Index file has an incomplete distinct item table");
+
+		return BasicSearchData<IndexT>{
+			std::u16string_view(text.data(), text.size()),
+			suffixes,
+			itemEnds,
+			itemEndRanks,
+			size_t(header.ItemCount),
+			previous,
+			lcpLeft,
+			lcpRight,
+			prefixStarts,
+			prefixBigrams,
+			prefixBigramStarts,
+			rangeMinimum,
+			distinctWords,
+			distinctRanks
+		};
+	}
+
+	template<typename IndexT>
+	void VerifyIndexFile(const BasicSearchData<IndexT> &data) {
+		const auto n = std::int64_t(data.Text.size());
+		CheckValues(data.Suffixes, 0, n - 1, false, "suffix array");
+		for(size_t i = 0; i < data.PreviousEntryOfSameItem.size(); ++i) {
+			// The previous entry of the same item is before the entry, -1 for the first one
+			if(const IndexValue<IndexT> entry = data.PreviousEntryOfSameItem[i]; entry < -1 || entry >= std::int64_t(i))
+				throw std::runtime_error("Index file previous entries are out of bounds");
+		}
+		for(size_t i = 0; i < data.LcpLeft.size(); ++i) {
+			// A search compares from the lcp on, which can't be longer than the suffix
+			const auto length = size_t(n - IndexValue<IndexT>(data.Suffixes[i]));
+			if(data.LcpLeft[i] > length || data.LcpRight[i] > length)
+				throw std::runtime_error("Index file lcp table is out of bounds");
+		}
+
+		if(CheckRanks(data.ItemEnds, data.ItemEndRanks, data.Text.size(), "item ends") != data.ItemCount)
+			throw std::runtime_error("Index file item count doesn't match the item ends");
+		if(!data.DistinctWords.empty())
+			CheckRanks(data.DistinctWords, data.DistinctRanks, data.Text.size() * WaveletMatrix::LevelCount(data.Text.size()), "distinct item table");
+
+		// Positions outside the blocks they stand for would let findUnique report entries outside the range
+		if(!data.UniqueRangeMinimum.empty()) {
+			const BasicRangeMinimum<IndexT> rangeMinimum(data.PreviousEntryOfSameItem);
+			const auto expected = rangeMinimum.sparseArray();
+			if(!std::equal(expected.begin(), expected.end(), data.UniqueRangeMinimum.begin(), data.UniqueRangeMinimum.end(),
+					[](const IndexT a, const IndexT b) { return IndexValue<IndexT>(a) == IndexValue<IndexT>(b); }))
+				throw std::runtime_error("Index file range minimum table doesn't match the previous entries");
+		}
+	}
+
+	template void WriteIndexFile(const BasicSearch<Index> &search, const char *path);
+	template void WriteIndexFile(const BasicSearch<std::int64_t> &search, const char *path);
+	template void WriteIndexFile(const BasicSearch<Index40> &search, const char *path);
+
+	template BasicSearchData<Index> ReadIndexFile(Span<const std::byte> bytes);
+	template BasicSearchData<std::int64_t> ReadIndexFile(Span<const std::byte> bytes);
+	template BasicSearchData<Index40> ReadIndexFile(Span<const std::byte> bytes);
+
+	template void VerifyIndexFile(const BasicSearchData<Index> &data);
+	template void VerifyIndexFile(const BasicSearchData<std::int64_t> &data);
+	template void VerifyIndexFile(const BasicSearchData<Index40> &data);
+
+#ifdef _WIN32
+	MappedFile::MappedFile(const char *path) {
+		const auto file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if(file == INVALID_HANDLE_VALUE)
+			throw std::runtime_error(std::string("Failed to open ") + path);
+
+		LARGE_INTEGER size;
+		if(!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			CloseHandle(file);
+			throw std::runtime_error(std::string("Failed to get the size of ") + path);
+		}
+
+		const auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);
+		if(mapping == nullptr)
+			throw std::runtime_error(std::string("Failed to map ") + path);
+
+		// The view keeps the mapping alive
+		const auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if(view == nullptr)
+			throw std::runtime_error(std::string("Failed to map ") + path);
+
+		data_ = static_cast<const std::byte *>(view);
+		size_ = size_t(size.QuadPart);
+	}
+
+	MappedFile::~MappedFile() noexcept {
+		if(data_)
+			UnmapViewOfFile(data_);
+	}
+#else
+	MappedFile::MappedFile(const char *path) {
+		const auto file = open(path, O_RDONLY);
+		if(file == -1)
+			throw std::runtime_error(std::string("Failed to open ") + path);
+
+		struct stat info{};
+		if(fstat(file, &info) != 0 || info.st_size == 0) {
+			close(file);
+			throw std::runtime_error(std::string("Failed to get the size of ") + path);
+		}
+
+		// The mapping stays valid after closing the descriptor
+		const auto view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, file, 0);
+		close(file);
+		if(view == MAP_FAILED)
+			throw std::runtime_error(std::string("Failed to map ") + path);
+
+		data_ = static_cast<const std::byte *>(view);
+		size_ = size_t(info.st_size);
+	}
+
+	MappedFile::~MappedFile() noexcept {
+		if(data_)
+			munmap(const_cast<std::byte *>(data_), size_);
+	}
+#endif
+
+	MappedFile::MappedFile(MappedFile &&o) noexcept
+		: data_(std::exchange(o.data_, nullptr)),
+			size_(std::exchange(o.size_, 0)) {}
+
+	MappedFile &MappedFile::operator=(MappedFile &&o) noexcept {
+		std::swap(data_, o.data_);
+		std::swap(size_, o.size_);
+		return *this;
+	}
+}
\ No newline at end of file
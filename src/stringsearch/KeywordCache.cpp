@@ -0,0 +1,92 @@
+#include "KeywordCache.h"
+
+#include <functional>
+
+namespace stringsearch {
+	KeywordCache::KeywordCache(const size_t entries, const size_t items) noexcept
+		: entriesPerShard_((entries + ShardCount - 1) / ShardCount),
+			itemsPerShard_((items + ShardCount - 1) / ShardCount) {}
+
+	KeywordCache::Shard &KeywordCache::shard(const std::u16string_view keyword) noexcept {
+		// Fibonacci hashing takes the high bits, the map of the shard picks its bucket with the low ones
+		const auto hash = std::uint64_t(std::hash<std::u16string_view>()(keyword));
+		return shards_[size_t((hash * 0x9E3779B97F4A7C15ull) >> 61)];
+	}
+
+	void KeywordCache::shrink(Shard &shard) noexcept {
+		while(!shard.entries.empty() && (shard.entries.size() > entriesPerShard_ || shard.items > itemsPerShard_)) {
+			auto &last = shard.entries.back();
+			if(last.second.Items)
+				shard.items -= last.second.Items->size();
+			shard.lookup.erase(last.first);
+			shard.entries.pop_back();
+		}
+	}
+
+	std::optional<CachedKeyword> KeywordCache::find(const std::u16string_view keyword) {
+		auto &s = shard(keyword);
+		std::lock_guard lock(s.mutex);
+		const auto it = s.lookup.find(keyword);
+		if(it == s.lookup.end()) {
+			++s.misses;
+			return std::nullopt;
+		}
+
+		++s.hits;
+		if(it->second->second.Items)
+			++s.itemHits;
+		s.entries.splice(s.entries.begin(), s.entries, it->second);
+		return it->second->second;
+	}
+
+	void KeywordCache::insert(const std::u16string_view keyword, CachedKeyword entry) {
+		if(entriesPerShard_ == 0)
+			return;
+		if(entry.Items && entry.Items->size() > maxItems())
+			entry.Items.reset();
+
+		auto &s = shard(keyword);
+		std::lock_guard lock(s.mutex);
+		if(const auto it = s.lookup.find(keyword); it != s.lookup.end()) {
+			const auto node = it->second;
+			if(node->second.Items)
+				s.items -= node->second.Items->size();
+			// The key views the keyword of the node, erase may still hash it
+			s.lookup.erase(it);
+			s.entries.erase(node);
+		}
+
+		s.entries.emplace_front(std::u16string(keyword), std::move(entry));
+		const auto &front = s.entries.front();
+		s.lookup.emplace(front.first, s.entries.begin());
+		if(front.second.Items)
+			s.items += front.second.Items->size();
+		shrink(s);
+	}
+
+	void KeywordCache::clear() {
+		for(auto &s : shards_) {
+			std::lock_guard lock(s.mutex);
+			// clear keeps the buckets
+			decltype(s.lookup)().swap(s.lookup);
+			s.entries.clear();
+			s.items = 0;
+		}
+	}
+
+	void KeywordCache::snapshot(api::KeywordCacheStatistics &statistics, const bool reset) {
+		statistics = api::KeywordCacheStatistics{};
+		statistics.Capacity = entriesPerShard_ * ShardCount;
+		statistics.ItemCapacity = itemsPerShard_ * ShardCount;
+		for(auto &s : shards_) {
+			std::lock_guard lock(s.mutex);
+			statistics.Hits += s.hits;
+			statistics.ItemHits += s.itemHits;
+			statistics.Misses += s.misses;
+			statistics.Entries += s.entries.size();
+			statistics.Items += s.items;
+			if(reset)
+				s.hits = s.itemHits = s.misses = 0;
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+#include "ApiDefinitions.h"
+#include "stringsearch/Definitions.hpp"
+
+#include <array>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace stringsearch {
+	// Suffix array range of a keyword and, if it was small enough, the items of the range in ascending order
+	struct CachedKeyword {
+		size_t First = 0;
+		size_t Last = 0;
+		// nullptr if the items weren't cached
+		std::shared_ptr<const std::vector<Index>> Items;
+	};
+
+	// Keywords of recent queries, the least recently used ones are evicted first. The keywords are split into shards by
+	// their hash with a mutex each, so concurrent queries rarely wait for each other. The items are shared with the
+	// queries using them, an evicted list lives until the last of them is done.
+	class KeywordCache {
+		struct alignas(64) Shard {
+			std::mutex mutex;
+			// Most recently used first
+			std::list<std::pair<std::u16string, CachedKeyword>> entries;
+			// Keys view the keywords of entries
+			std::unordered_map<std::u16string_view, decltype(entries)::iterator> lookup;
+			size_t items = 0;
+			std::uint64_t hits = 0;
+			std::uint64_t itemHits = 0;
+			std::uint64_t misses = 0;
+		};
+
+		// Selected by the top 3 bits of the hash
+		static constexpr size_t ShardCount = 8;
+
+		std::array<Shard, ShardCount> shards_;
+		size_t entriesPerShard_;
+		size_t itemsPerShard_;
+
+		[[nodiscard]] Shard &shard(std::u16string_view keyword) noexcept;
+
+		// Evicts until the shard fits, shard.mutex must be locked
+		void shrink(Shard &shard) noexcept;
+
+	public:
+		// At most entries keywords, whose lists have at most items items together
+		KeywordCache(size_t entries, size_t items) noexcept;
+
+		// Lists of bigger ranges aren't worth keeping, one would take a big part of the budget
+		[[nodiscard]] size_t maxItems() const noexcept { return itemsPerShard_ / 4; }
+
+		// Counts a hit or a miss
+		[[nodiscard]] std::optional<CachedKeyword> find(std::u16string_view keyword);
+
+		// Replaces the entry of keyword. Items are dropped if there are more than maxItems.
+		void insert(std::u16string_view keyword, CachedKeyword entry);
+
+		// Drops the entries, their items and the buckets of the lookup, concurrent finds and inserts stay safe
+		void clear();
+
+		void snapshot(api::KeywordCacheStatistics &statistics, bool reset);
+	};
+}
\ No newline at end of file
@@ -1,11 +1,29 @@
 #include <benchmark/benchmark.h>
+#include "stringsearch/Compare.hpp"
 #include "stringsearch/SuffixSort.hpp"
 #include "stringsearch/Search.hpp"
+#include <algorithm>
+#include <chrono>
 #include <numeric>
 #include <fstream>
 #include <random>
 #include <locale>
 #include <codecvt>
+#include <thread>
+
+#ifdef BM_KEYWORDS
+#include "Api.h"
+#endif
+
+#ifdef BM_SCALING
+#include "Corpus.h"
+
+// The scaling benchmarks build and search deterministic synthetic catalogs shaped like testfiles/strings from 10^4
+// characters up to BM_CATALOG_LIMIT, at most 10^8
+#ifndef BM_CATALOG_LIMIT
+#define BM_CATALOG_LIMIT 10000000
+#endif
+#endif
 
 static std::u16string CharactersFromFile(const char *name, size_t count = std::numeric_limits<size_t>::max()) {
 	std::ifstream stream(name);
@@ -19,6 +37,34 @@ static std::u16string CharactersFromFile(const char *name, size_t count = std::n
    return utf16conv.from_bytes(res);
 }
 
+// Latency of every query for the percentiles, the benchmark library only reports the mean of all iterations. The query
+// benchmarks report the median and the 99th percentile in the p50_ns and p99_ns counters.
+class Latencies {
+	std::vector<double> nanoseconds_;
+
+public:
+	template<typename F>
+	decltype(auto) measure(F &&f) {
+		const auto before = std::chrono::steady_clock::now();
+		decltype(auto) res = f();
+		nanoseconds_.emplace_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - before).count());
+		return res;
+	}
+
+	// Sets the p50_ns and p99_ns counters of state
+	void report(benchmark::State &state) {
+		if(nanoseconds_.empty())
+			return;
+
+		std::sort(nanoseconds_.begin(), nanoseconds_.end());
+		const auto percentile = [&](const double p) {
+			return nanoseconds_[std::min(nanoseconds_.size() - 1, size_t(p * double(nanoseconds_.size())))];
+		};
+		state.counters["p50_ns"] = percentile(0.5);
+		state.counters["p99_ns"] = percentile(0.99);
+	}
+};
+
 static std::u16string CharactersFromStrings(const stringsearch::Span<const std::u16string_view> strs) {
 	std::u16string res;
 	for (auto& str : strs) {
@@ -62,6 +108,7 @@ BM_SMALL_TINY(SuffixSortStd);
 BM_SMALL_TINY(SuffixSortInPlace);
 BM_SMALL_TINY(SuffixSortOwnBuffer);
 BM_SMALL_TINY(SuffixSortSharedBuffer);
+BM_SMALL_TINY(SuffixSortPooledBuffer);
 
 #undef BM_SMALL_TINY
 
@@ -76,6 +123,9 @@ BM_SMALL_SAMPLE(SuffixSortStd);
 BM_SMALL_SAMPLE(SuffixSortInPlace);
 BM_SMALL_SAMPLE(SuffixSortOwnBuffer);
 BM_SMALL_SAMPLE(SuffixSortSharedBuffer);
+BM_SMALL_SAMPLE(SuffixSortPooledBuffer);
+BM_SMALL_SAMPLE(SuffixSortAlphabet);
+BM_SMALL_SAMPLE(SuffixSortCachedKeys);
 
 #undef BM_SMALL_SAMPLE
 
@@ -90,6 +140,9 @@ BM_BIG_SAMPLE(SuffixSortStd);
 BM_BIG_SAMPLE(SuffixSortInPlace);
 BM_BIG_SAMPLE(SuffixSortOwnBuffer);
 BM_BIG_SAMPLE(SuffixSortSharedBuffer);
+BM_BIG_SAMPLE(SuffixSortPooledBuffer);
+BM_BIG_SAMPLE(SuffixSortAlphabet);
+BM_BIG_SAMPLE(SuffixSortCachedKeys);
 
 #undef BM_BIG_SAMPLE
 
@@ -104,31 +157,163 @@ static void TestWithBigSampleMaxSizes(benchmark::State &state, Function &&functi
 BM_SAMPLE(TestWithBigSampleMaxSizes, SuffixSortOwnBufferMax)->DenseRange(10, 150, 10);
 BM_SAMPLE(TestWithBigSampleMaxSizes, SuffixSortSharedBufferMax)->DenseRange(10, 150, 10);
 BM_SAMPLE(TestWithBigSampleMaxSizes, SuffixSortInPlaceMax)->DenseRange(10, 150, 10);
+BM_SAMPLE(TestWithBigSampleMaxSizes, SuffixSortPooledBufferMax)->DenseRange(10, 150, 10);
+BM_SAMPLE(TestWithBigSampleMaxSizes, SuffixSortAlphabet)->DenseRange(10, 150, 10);
+
+// The same sweeps with std::sort instead of the multikey quicksort for the small buckets
+template<typename Function>
+static void TestWithBigSampleMaxSizesComparison(benchmark::State &state, Function &&function) {
+	TestWithBigSampleMaxSizes(state, [&](auto &&... vals) {
+		function(std::forward<decltype(vals)>(vals)..., stringsearch::SmallBucketSort::Comparison);
+	});
+}
+
+BM_SAMPLE(TestWithBigSampleMaxSizesComparison, SuffixSortOwnBufferMax)->DenseRange(10, 150, 10);
+BM_SAMPLE(TestWithBigSampleMaxSizesComparison, SuffixSortSharedBufferMax)->DenseRange(10, 150, 10);
+BM_SAMPLE(TestWithBigSampleMaxSizesComparison, SuffixSortInPlaceMax)->DenseRange(10, 150, 10);
+BM_SAMPLE(TestWithBigSampleMaxSizes, SuffixSortCachedKeys)->DenseRange(10, 150, 10);
+
+template<typename Function>
+static void TestWithBigSampleThreads(benchmark::State &state, Function &&function) {
+	const auto threads = unsigned(state.range(0));
+	TestWithBigSample(state, [&](auto &&... vals) {
+		function(std::forward<decltype(vals)>(vals)..., threads);
+	});
+}
+
+BM_SAMPLE(TestWithBigSampleThreads, SuffixSortParallel)->RangeMultiplier(2)->Range(1, 32)->UseRealTime();
+
+// Inputs that keep big buckets together for many levels, the depth guard of the radix sorts falls back to SA-IS for them
+constexpr std::array<const char *, 4> AdversarialNames {{"repeated character", "period 3", "duplicated catalog", "identical items"}};
+
+static std::u16string AdversarialCharacters(const size_t kind) {
+	constexpr size_t size = 1 << 20;
+	std::u16string res;
+	switch(kind) {
+	case 0:
+		res.assign(size, u'a');
+		break;
+	case 1:
+		while(res.size() < size)
+			res += u"abc";
+		break;
+	case 2:
+		res = CharactersFromFile("strings", 20000);
+		res += std::u16string(res);
+		break;
+	default:
+		const auto item = CharactersFromFile("strings", 1);
+		while(res.size() < size)
+			res += item;
+		break;
+	}
+	return res;
+}
+
+template<typename Function>
+static void TestWithAdversarialSample(benchmark::State &state, Function &&function) {
+	const auto kind = size_t(state.range(0));
+	state.SetLabel(AdversarialNames[kind]);
+	TestWithCharacters(state, AdversarialCharacters(kind), std::forward<Function>(function));
+}
+
+#define BM_ADVERSARIAL_SAMPLE(name) BM_SAMPLE(TestWithAdversarialSample, name)->DenseRange(0, AdversarialNames.size() - 1)
+
+BM_ADVERSARIAL_SAMPLE(SuffixSortInducedSorting);
+BM_ADVERSARIAL_SAMPLE(SuffixSortSharedBuffer);
+BM_ADVERSARIAL_SAMPLE(SuffixSortSharedBufferMax);
+BM_ADVERSARIAL_SAMPLE(SuffixSortInPlaceMax);
+BM_ADVERSARIAL_SAMPLE(SuffixSortAlphabet);
+BM_ADVERSARIAL_SAMPLE(SuffixSortCachedKeys);
+
+#undef BM_ADVERSARIAL_SAMPLE
 #endif
 
 #ifdef BM_SUFFIX_ARRAY_FIND
-static void BenchmarkSAFindWithCharacters(benchmark::State &state, const std::u16string_view &characters) {
-	const stringsearch::SuffixArray sa(characters);
+template<typename IndexT = stringsearch::Index>
+static void BenchmarkSAFindWithCharacters(benchmark::State &state, const std::u16string_view &characters, const stringsearch::BuildOptions &options = {},
+														const stringsearch::Index maxSize = 6) {
+	const stringsearch::BasicSuffixArray<IndexT> sa(characters, options);
 	
 	std::mt19937 gen(42);  // NOLINT(cert-msc32-c)
-	std::uniform_int_distribution<stringsearch::Index> sizeDistribution(1, 6);
-	std::uniform_int_distribution<stringsearch::Index> offsetDistribution(0, characters.size() - 6);
-	
+	std::uniform_int_distribution<stringsearch::Index> sizeDistribution(1, maxSize);
+	std::uniform_int_distribution<stringsearch::Index> offsetDistribution(0, characters.size() - maxSize);
+
+	// Pausing the timer costs more than a search, so the patterns are drawn up front
+	std::vector<std::u16string_view> patterns(4096);
+	for(auto &pattern : patterns)
+		pattern = characters.substr(offsetDistribution(gen), sizeDistribution(gen));
+
+	Latencies latencies;
+	size_t i = 0;
 	for(auto _ : state) {
-		state.PauseTiming();
-		const auto offset = offsetDistribution(gen);
-		const auto size = sizeDistribution(gen);
-		const auto pattern = characters.substr(offset, size);
-		state.ResumeTiming();
-		benchmark::DoNotOptimize(sa.find(characters, pattern));
+		const auto &pattern = patterns[i++ % patterns.size()];
+		benchmark::DoNotOptimize(latencies.measure([&]() { return sa.find(characters, pattern); }));
 	}
+	latencies.report(state);
 }
 
 static void BenchmarkSAFind(benchmark::State &state) {
 	BenchmarkSAFindWithCharacters(state, CharactersFromFile("strings"));
 }
 
+static void BenchmarkSAFindPrefix(benchmark::State &state) {
+	stringsearch::BuildOptions options;
+	options.PrefixSearch = true;
+	BenchmarkSAFindWithCharacters(state, CharactersFromFile("strings"), options);
+}
+
+// Patterns of up to 64 characters, where comparing the characters matters more than loading the entries
+static void BenchmarkSAFindLong(benchmark::State &state) {
+	BenchmarkSAFindWithCharacters(state, CharactersFromFile("strings"), {}, 64);
+}
+
+// Same searches with wider entries, for the cost of the extra cache misses
+template<typename IndexT>
+static void BenchmarkSAFindWidth(benchmark::State &state) {
+	BenchmarkSAFindWithCharacters<IndexT>(state, CharactersFromFile("strings"));
+}
+
+// The first state.range(0) items of the sample, for the growth with the size of the corpus
+static void BenchmarkSAFindItems(benchmark::State &state) {
+	BenchmarkSAFindWithCharacters(state, CharactersFromFile("strings", size_t(state.range(0))));
+}
+
 BENCHMARK(BenchmarkSAFind);
+BENCHMARK(BenchmarkSAFindPrefix);
+BENCHMARK(BenchmarkSAFindLong);
+BENCHMARK_TEMPLATE(BenchmarkSAFindWidth, std::int64_t);
+BENCHMARK_TEMPLATE(BenchmarkSAFindWidth, stringsearch::Index40);
+BENCHMARK(BenchmarkSAFindItems)->RangeMultiplier(4)->Range(64, 4096);
+#endif
+
+#ifdef BM_SUFFIX_ARRAY_FIND
+// Comparison of two strings equal in their first state.range(0) code units
+template<typename Function>
+static void BenchmarkMismatch(benchmark::State &state, Function &&function) {
+	const auto length = size_t(state.range(0));
+	const std::u16string a(length + 1, u'a');
+	auto b = a;
+	b.back() = u'b';
+	for(auto _ : state) {
+		benchmark::DoNotOptimize(function(a.data(), b.data(), a.size()));
+		benchmark::ClobberMemory();
+	}
+}
+
+static void BenchmarkMismatchScalar(benchmark::State &state) {
+	BenchmarkMismatch(state, [](const char16_t *a, const char16_t *b, const size_t count) {
+		return size_t(std::mismatch(a, a + count, b).first - a);
+	});
+}
+
+static void BenchmarkMismatchVectorized(benchmark::State &state) {
+	state.SetLabel(stringsearch::MismatchInstructionSet());
+	BenchmarkMismatch(state, stringsearch::MismatchLength);
+}
+
+BENCHMARK(BenchmarkMismatchScalar)->RangeMultiplier(4)->Range(4, 1024);
+BENCHMARK(BenchmarkMismatchVectorized)->RangeMultiplier(4)->Range(4, 1024);
 #endif
 
 #ifdef BM_UNIQUE
@@ -141,6 +326,7 @@ static void BenchmarkUniqueWithCharacters(benchmark::State &state, const strings
 	stringsearch::UniqueSearchLookup lookup(characters, sa);
 	stringsearch::OldUniqueSearchLookup oldUniqueSearchLookup(characters);
 	std::vector<stringsearch::Index> output(characters.size());
+	Latencies latencies;
 	for(auto _ : state) {
 		state.PauseTiming();
 		const auto offset = offsetDistribution(gen);
@@ -148,8 +334,9 @@ static void BenchmarkUniqueWithCharacters(benchmark::State &state, const strings
 		const auto pattern = characters.substr(offset, size);
 		const auto range = sa.find(characters, pattern);
 		state.ResumeTiming();
-		benchmark::DoNotOptimize(function(range, output));
+		benchmark::DoNotOptimize(latencies.measure([&]() { return function(range, output); }));
 	}
+	latencies.report(state);
 }
 
 static void BenchmarkUnique(benchmark::State &state) {
@@ -171,8 +358,417 @@ static void BenchmarkUniqueOld(benchmark::State &state) {
 	});
 }
 
+// First page of 20 items, where reporting doesn't depend on the size of the range
+template<stringsearch::FindUniqueMode Mode>
+static void BenchmarkUniquePage(benchmark::State &state) {
+	const auto characters = CharactersFromFile("strings");
+	const stringsearch::SuffixArray sa(characters);
+	stringsearch::BuildOptions options;
+	options.UniqueReporting = true;
+	stringsearch::UniqueSearchLookup lookup(characters, sa, options);
+	BenchmarkUniqueWithCharacters(state, sa, characters, [&](auto && result, auto && output) {
+		return lookup.findUnique(result, stringsearch::Span<stringsearch::Index>(output).subspan(0, 20), 0, Mode);
+	});
+}
+
+static void BenchmarkCountDistinct(benchmark::State &state, const bool distinctCounting) {
+	const auto characters = CharactersFromFile("strings");
+	const stringsearch::SuffixArray sa(characters);
+	stringsearch::BuildOptions options;
+	options.DistinctCounting = distinctCounting;
+	stringsearch::UniqueSearchLookup lookup(characters, sa, options);
+	BenchmarkUniqueWithCharacters(state, sa, characters, [&](auto && result, auto &&) {
+		return lookup.countDistinct(result);
+	});
+}
+
+BENCHMARK_CAPTURE(BenchmarkCountDistinct, Scan, false)->DenseRange(1, 3);
+BENCHMARK_CAPTURE(BenchmarkCountDistinct, WaveletMatrix, true)->DenseRange(1, 3);
 BENCHMARK(BenchmarkUnique)->DenseRange(1, 6);
 BENCHMARK(BenchmarkUniqueOld)->DenseRange(1, 6);
+BENCHMARK_TEMPLATE(BenchmarkUniquePage, stringsearch::FindUniqueMode::Scan)->DenseRange(1, 3);
+BENCHMARK_TEMPLATE(BenchmarkUniquePage, stringsearch::FindUniqueMode::Report)->DenseRange(1, 3);
+BENCHMARK_TEMPLATE(BenchmarkUniquePage, stringsearch::FindUniqueMode::Auto)->DenseRange(1, 3);
+#endif
+
+#ifdef BM_BUILD
+// Everything a search instance builds, on the first state.range(0) items of the sample
+static void BenchmarkBuild(benchmark::State &state, const stringsearch::SuffixSortAlgorithm algorithm) {
+	const auto characters = CharactersFromFile("strings", size_t(state.range(0)));
+	stringsearch::BuildOptions options;
+	options.Algorithm = algorithm;
+	for(auto _ : state) {
+		const stringsearch::Search search(characters, options);
+		benchmark::DoNotOptimize(&search);
+	}
+	state.SetItemsProcessed(std::int64_t(state.iterations()) * std::int64_t(characters.size()));
+}
+
+BENCHMARK_CAPTURE(BenchmarkBuild, Radix, stringsearch::SuffixSortAlgorithm::Radix)->RangeMultiplier(4)->Range(64, 4096);
+BENCHMARK_CAPTURE(BenchmarkBuild, InducedSorting, stringsearch::SuffixSortAlgorithm::InducedSorting)->RangeMultiplier(4)->Range(64, 4096);
+BENCHMARK_CAPTURE(BenchmarkBuild, AlphabetRadix, stringsearch::SuffixSortAlgorithm::AlphabetRadix)->RangeMultiplier(4)->Range(64, 4096);
+BENCHMARK_CAPTURE(BenchmarkBuild, CachedKeyRadix, stringsearch::SuffixSortAlgorithm::CachedKeyRadix)->RangeMultiplier(4)->Range(64, 4096);
+
+// Bytes per character of the arrays of an instance of the whole sample and of the peak while building it
+// (bytes_per_char, peak_bytes_per_char). The time is the one of memoryUsage, the counters are the report. The IndexT
+// argument only selects the index width.
+template<typename IndexT>
+static void BenchmarkMemoryUsage(benchmark::State &state, IndexT, const bool lcp, const bool prefix, const bool unique, const bool distinct) {
+	static const auto characters = CharactersFromFile("strings");
+	stringsearch::BuildOptions options;
+	options.LcpSearch = lcp;
+	options.PrefixSearch = prefix;
+	options.UniqueReporting = unique;
+	options.DistinctCounting = distinct;
+	const stringsearch::BasicSearch<IndexT> search(characters, options);
+
+	stringsearch::MemoryUsage usage;
+	for(auto _ : state)
+		benchmark::DoNotOptimize(usage = search.memoryUsage());
+
+	const auto perCharacter = [&](const size_t bytes) { return double(bytes) / double(characters.size()); };
+	state.counters["bytes_per_char"] = perCharacter(usage.total());
+	state.counters["peak_bytes_per_char"] = perCharacter(usage.BuildPeak);
+	state.counters["sa_bytes_per_char"] = perCharacter(usage.SuffixArray);
+	state.counters["item_bytes_per_char"] = perCharacter(usage.ItemEnds + usage.PreviousEntryOfSameItem);
+}
+
+#define BM_MEMORY_USAGE(width, IndexT) \
+BENCHMARK_CAPTURE(BenchmarkMemoryUsage, width##_Default, IndexT(), false, false, false, false); \
+BENCHMARK_CAPTURE(BenchmarkMemoryUsage, width##_Lcp, IndexT(), true, false, false, false); \
+BENCHMARK_CAPTURE(BenchmarkMemoryUsage, width##_Prefix, IndexT(), false, true, false, false); \
+BENCHMARK_CAPTURE(BenchmarkMemoryUsage, width##_UniqueReporting, IndexT(), false, false, true, false); \
+BENCHMARK_CAPTURE(BenchmarkMemoryUsage, width##_DistinctCounting, IndexT(), false, false, false, true); \
+BENCHMARK_CAPTURE(BenchmarkMemoryUsage, width##_All, IndexT(), true, true, true, true)
+
+BM_MEMORY_USAGE(Index32, stringsearch::Index);
+BM_MEMORY_USAGE(Index64, std::int64_t);
+BM_MEMORY_USAGE(Index40, stringsearch::Index40);
+
+#undef BM_MEMORY_USAGE
+#endif
+
+#ifdef BM_KEYWORDS
+// Two words of a random item of the first state.range(0) items of the sample per query, a page of 20 items each
+static void BenchmarkKeywords(benchmark::State &state, const stringsearch::api::KeywordsMatch matching) {
+	const auto characters = CharactersFromFile("strings", size_t(state.range(0)));
+	const auto instance = CreateSearchInstanceFromText(characters.data(), characters.size(), nullptr, [](const char *) {});
+
+	// Items end with a 0, so every word ends before the end of the text
+	constexpr char16_t separators[] = {u' ', 0};
+	std::vector<std::u16string_view> words;
+	for(size_t begin = 0; begin < characters.size();) {
+		const auto end = characters.find_first_of(separators, begin, 2);
+		if(end != begin)
+			words.emplace_back(std::u16string_view(characters).substr(begin, end - begin));
+		begin = end + 1;
+	}
+
+	std::mt19937 gen(42);  // NOLINT(cert-msc32-c)
+	std::uniform_int_distribution<size_t> wordDistribution(0, words.size() - 2);
+	std::vector<std::u16string> patterns(4096);
+	for(auto &pattern : patterns) {
+		const auto word = wordDistribution(gen);
+		pattern = std::u16string(words[word]) + u' ' + std::u16string(words[word + 1]);
+	}
+
+	std::vector<stringsearch::Index> output(20);
+	Latencies latencies;
+	size_t i = 0;
+	for(auto _ : state) {
+		const auto &pattern = patterns[i++ % patterns.size()];
+		stringsearch::api::FindUniqueItemsResult result;
+		benchmark::DoNotOptimize(latencies.measure([&]() {
+			return FindUniqueItemsKeywords(instance, pattern.data(), pattern.size(), output.data(), output.size(), matching, 0, &result, nullptr);
+		}));
+	}
+	latencies.report(state);
+	DestroySearchInstance(instance);
+}
+
+BENCHMARK_CAPTURE(BenchmarkKeywords, All, stringsearch::api::KeywordsMatch::All)->RangeMultiplier(4)->Range(64, 4096);
+BENCHMARK_CAPTURE(BenchmarkKeywords, AtLeastOne, stringsearch::api::KeywordsMatch::AtLeastOne)->RangeMultiplier(4)->Range(64, 4096);
+#endif
+
+#ifdef BM_SCALING
+// Synthetic catalog of state.range(0) characters. Only the last one is kept, generating 10^8 characters takes seconds
+// and the benchmarks of one size run after each other.
+static const std::u16string &Catalog(const benchmark::State &state) {
+	static std::u16string catalog;
+	static size_t characters = 0;
+	if(characters != size_t(state.range(0))) {
+		characters = size_t(state.range(0));
+		stringsearch::CatalogOptions options;
+		options.Characters = characters;
+		catalog = stringsearch::GenerateCatalog(options);
+	}
+	return catalog;
+}
+
+static void BenchmarkCatalogBuild(benchmark::State &state, const stringsearch::SuffixSortAlgorithm algorithm) {
+	const auto &characters = Catalog(state);
+	stringsearch::BuildOptions options;
+	options.Algorithm = algorithm;
+	for(auto _ : state) {
+		const stringsearch::Search search(characters, options);
+		benchmark::DoNotOptimize(&search);
+	}
+	state.SetItemsProcessed(std::int64_t(state.iterations()) * std::int64_t(characters.size()));
+}
+
+static void BenchmarkCatalogFind(benchmark::State &state, const stringsearch::CatalogQuery kind) {
+	const auto &characters = Catalog(state);
+	const stringsearch::SuffixArray sa(characters);
+	const auto patterns = stringsearch::GenerateCatalogQueries(characters, kind, 4096);
+
+	Latencies latencies;
+	size_t i = 0;
+	for(auto _ : state) {
+		const auto &pattern = patterns[i++ % patterns.size()];
+		benchmark::DoNotOptimize(latencies.measure([&]() { return sa.find(characters, pattern); }));
+	}
+	latencies.report(state);
+}
+
+#define BM_CATALOG_SIZES RangeMultiplier(10)->Range(10000, BM_CATALOG_LIMIT)
+
+BENCHMARK_CAPTURE(BenchmarkCatalogBuild, Radix, stringsearch::SuffixSortAlgorithm::Radix)->BM_CATALOG_SIZES->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BenchmarkCatalogBuild, InducedSorting, stringsearch::SuffixSortAlgorithm::InducedSorting)->BM_CATALOG_SIZES->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BenchmarkCatalogBuild, AlphabetRadix, stringsearch::SuffixSortAlgorithm::AlphabetRadix)->BM_CATALOG_SIZES->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BenchmarkCatalogBuild, CachedKeyRadix, stringsearch::SuffixSortAlgorithm::CachedKeyRadix)->BM_CATALOG_SIZES->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BenchmarkCatalogFind, Substring, stringsearch::CatalogQuery::Substring)->BM_CATALOG_SIZES;
+BENCHMARK_CAPTURE(BenchmarkCatalogFind, WordPrefix, stringsearch::CatalogQuery::WordPrefix)->BM_CATALOG_SIZES;
+BENCHMARK_CAPTURE(BenchmarkCatalogFind, Miss, stringsearch::CatalogQuery::Miss)->BM_CATALOG_SIZES;
+
+#ifdef BM_KEYWORDS
+// Keyword queries through the C API, a page of 20 items each
+static void BenchmarkCatalogKeywords(benchmark::State &state, const stringsearch::api::KeywordsMatch matching) {
+	const auto &characters = Catalog(state);
+	const auto instance = CreateSearchInstanceFromText(characters.data(), characters.size(), nullptr, [](const char *) {});
+	const auto patterns = stringsearch::GenerateCatalogQueries(characters, stringsearch::CatalogQuery::Keywords, 4096);
+
+	std::vector<stringsearch::Index> output(20);
+	Latencies latencies;
+	size_t i = 0;
+	for(auto _ : state) {
+		const auto &pattern = patterns[i++ % patterns.size()];
+		stringsearch::api::FindUniqueItemsResult result;
+		benchmark::DoNotOptimize(latencies.measure([&]() {
+			return FindUniqueItemsKeywords(instance, pattern.data(), pattern.size(), output.data(), output.size(), matching, 0, &result, nullptr);
+		}));
+	}
+	latencies.report(state);
+	DestroySearchInstance(instance);
+}
+
+BENCHMARK_CAPTURE(BenchmarkCatalogKeywords, All, stringsearch::api::KeywordsMatch::All)->BM_CATALOG_SIZES;
+BENCHMARK_CAPTURE(BenchmarkCatalogKeywords, AtLeastOne, stringsearch::api::KeywordsMatch::AtLeastOne)->BM_CATALOG_SIZES;
+
+// Every prefix of the keyword queries in the order a user types them, with and without the keyword cache, whose
+// hit_rate is reported
+static void BenchmarkCatalogTypeahead(benchmark::State &state, const bool cached) {
+	const auto &characters = Catalog(state);
+	const auto instance = CreateSearchInstanceFromText(characters.data(), characters.size(), nullptr, [](const char *) {});
+	if(!cached)
+		SetKeywordCacheCapacity(instance, 0, 0);
+
+	std::vector<std::u16string> patterns;
+	for(const auto &query : stringsearch::GenerateCatalogQueries(characters, stringsearch::CatalogQuery::Keywords, 1024)) {
+		for(size_t length = 1; length <= query.size(); ++length) {
+			if(query[length - 1] != u' ')
+				patterns.emplace_back(query.substr(0, length));
+		}
+	}
+
+	std::vector<stringsearch::Index> output(20);
+	Latencies latencies;
+	size_t i = 0;
+	for(auto _ : state) {
+		const auto &pattern = patterns[i++ % patterns.size()];
+		stringsearch::api::FindUniqueItemsResult result;
+		benchmark::DoNotOptimize(latencies.measure([&]() {
+			return FindUniqueItemsKeywords(instance, pattern.data(), pattern.size(), output.data(), output.size(),
+				stringsearch::api::KeywordsMatch::All, 0, &result, nullptr);
+		}));
+	}
+	latencies.report(state);
+
+	stringsearch::api::KeywordCacheStatistics statistics;
+	GetKeywordCacheStatistics(instance, &statistics, false);
+	if(statistics.Hits + statistics.Misses != 0)
+		state.counters["hit_rate"] = double(statistics.Hits) / double(statistics.Hits + statistics.Misses);
+	DestroySearchInstance(instance);
+}
+
+BENCHMARK_CAPTURE(BenchmarkCatalogTypeahead, Uncached, false)->BM_CATALOG_SIZES;
+BENCHMARK_CAPTURE(BenchmarkCatalogTypeahead, Cached, true)->BM_CATALOG_SIZES;
+
+// A page of 20 items per keystroke of the keyword queries typed as one pattern, searched from scratch or narrowed
+// by a query session
+static void BenchmarkCatalogKeystrokes(benchmark::State &state, const bool session) {
+	const auto &characters = Catalog(state);
+	const auto instance = CreateSearchInstanceFromText(characters.data(), characters.size(), nullptr, [](const char *) {});
+	const auto handle = BeginQuerySession(instance);
+
+	std::vector<std::u16string> patterns;
+	for(const auto &query : stringsearch::GenerateCatalogQueries(characters, stringsearch::CatalogQuery::Keywords, 1024)) {
+		for(size_t length = 1; length <= query.size(); ++length)
+			patterns.emplace_back(query.substr(0, length));
+	}
+
+	std::vector<stringsearch::Index> output(20);
+	Latencies latencies;
+	size_t i = 0;
+	for(auto _ : state) {
+		const auto &pattern = patterns[i++ % patterns.size()];
+		stringsearch::api::FindUniqueItemsResult result;
+		benchmark::DoNotOptimize(latencies.measure([&]() {
+			if(!session)
+				return FindUniqueItems(instance, pattern.data(), pattern.size(), output.data(), output.size(), &result, 0, nullptr);
+
+			SetQuery(handle, pattern.data(), pattern.size(), nullptr);
+			return FindSessionItems(handle, output.data(), output.size(), 0, &result);
+		}));
+	}
+	latencies.report(state);
+	EndQuerySession(handle);
+	DestroySearchInstance(instance);
+}
+
+BENCHMARK_CAPTURE(BenchmarkCatalogKeystrokes, Find, false)->BM_CATALOG_SIZES;
+BENCHMARK_CAPTURE(BenchmarkCatalogKeystrokes, Session, true)->BM_CATALOG_SIZES;
+
+// Up to 50 pages of 20 items of the first 2 characters of word prefixes, every page searched again at the consumed
+// offset or read from a cursor
+static void BenchmarkCatalogPaging(benchmark::State &state, const bool cursor) {
+	const auto &characters = Catalog(state);
+	const auto instance = CreateSearchInstanceFromText(characters.data(), characters.size(), nullptr, [](const char *) {});
+
+	std::vector<std::u16string> patterns;
+	for(const auto &query : stringsearch::GenerateCatalogQueries(characters, stringsearch::CatalogQuery::WordPrefix, 256))
+		patterns.emplace_back(query.substr(0, 2));
+
+	constexpr size_t MaxPages = 50;
+	std::vector<stringsearch::Index> output(20);
+	Latencies latencies;
+	size_t i = 0, page = MaxPages, offset = 0;
+	stringsearch::api::CursorHandle handle = nullptr;
+	for(auto _ : state) {
+		if(page == MaxPages) {
+			CursorClose(handle);
+			handle = nullptr;
+			page = 0;
+			offset = 0;
+			++i;
+		}
+
+		const auto &pattern = patterns[i % patterns.size()];
+		size_t written = 0;
+		benchmark::DoNotOptimize(latencies.measure([&]() {
+			if(!cursor) {
+				stringsearch::api::FindUniqueItemsResult result;
+				const auto status = FindUniqueItems(instance, pattern.data(), pattern.size(), output.data(), output.size(), &result, unsigned(offset), nullptr);
+				written = result.Count;
+				offset = result.Consumed;
+				return status;
+			}
+
+			if(!handle)
+				handle = OpenCursor(instance, pattern.data(), pattern.size(), nullptr);
+			return CursorNext(handle, output.data(), output.size(), &written);
+		}));
+		page = written == 0 ? MaxPages : page + 1;
+	}
+	latencies.report(state);
+	CursorClose(handle);
+	DestroySearchInstance(instance);
+}
+
+BENCHMARK_CAPTURE(BenchmarkCatalogPaging, Offset, false)->BM_CATALOG_SIZES;
+BENCHMARK_CAPTURE(BenchmarkCatalogPaging, Cursor, true)->BM_CATALOG_SIZES;
+
+// The first page of 20 items of word prefixes from a suffix array or an FM-index instance, with the bytes per
+// character of the instance
+static void BenchmarkCatalogEngine(benchmark::State &state, const stringsearch::api::SearchEngine engine) {
+	const auto &characters = Catalog(state);
+	stringsearch::api::InstanceOptions options{};
+	options.Engine = engine;
+	const auto instance = CreateSearchInstanceFromText(characters.data(), characters.size(), &options, [](const char *) {});
+	const auto patterns = stringsearch::GenerateCatalogQueries(characters, stringsearch::CatalogQuery::WordPrefix, 4096);
+
+	std::vector<stringsearch::Index> output(20);
+	Latencies latencies;
+	size_t i = 0;
+	for(auto _ : state) {
+		const auto &pattern = patterns[i++ % patterns.size()];
+		stringsearch::api::FindUniqueItemsResult result;
+		benchmark::DoNotOptimize(latencies.measure([&]() {
+			return FindUniqueItems(instance, pattern.data(), pattern.size(), output.data(), output.size(), &result, 0, nullptr);
+		}));
+	}
+	latencies.report(state);
+
+	stringsearch::api::MemoryUsage usage;
+	GetInstanceMemoryUsage(instance, &usage);
+	state.counters["bytes_per_char"] = double(usage.Total) / double(characters.size());
+	DestroySearchInstance(instance);
+}
+
+BENCHMARK_CAPTURE(BenchmarkCatalogEngine, SuffixArray, stringsearch::api::SearchEngine::SuffixArray)->BM_CATALOG_SIZES;
+BENCHMARK_CAPTURE(BenchmarkCatalogEngine, FmIndex, stringsearch::api::SearchEngine::FmIndex)->BM_CATALOG_SIZES;
+
+enum class ThreadsQuery {
+	FindUniqueItems,
+	// FindUniqueItems with the instance statistics enabled
+	Statistics,
+	// FindUniqueItemsKeywords through the keyword cache
+	Keywords
+};
+
+// Queries per second (items_per_second) of 1 to all hardware threads sharing one instance of 10^6 characters, every
+// thread starting at another query. Throughput that doesn't grow with the threads points at contention or false
+// sharing in the query path.
+static void BenchmarkCatalogThreads(benchmark::State &state, const ThreadsQuery query) {
+	static stringsearch::api::InstanceHandle instance = nullptr;
+	static std::vector<std::u16string> patterns;
+	if(state.thread_index() == 0) {
+		const auto &characters = Catalog(state);
+		instance = CreateSearchInstanceFromText(characters.data(), characters.size(), nullptr, [](const char *) {});
+		EnableInstanceStatistics(instance, query == ThreadsQuery::Statistics);
+		patterns = stringsearch::GenerateCatalogQueries(characters, query == ThreadsQuery::Keywords
+			? stringsearch::CatalogQuery::Keywords : stringsearch::CatalogQuery::WordPrefix, 4096);
+	}
+
+	// The threads wait for the setup at the start of the loop
+	std::vector<stringsearch::Index> output(20);
+	size_t i = size_t(state.thread_index()) * 509;
+	for(auto _ : state) {
+		const auto &pattern = patterns[i++ % patterns.size()];
+		stringsearch::api::FindUniqueItemsResult result;
+		benchmark::DoNotOptimize(query == ThreadsQuery::Keywords
+			? FindUniqueItemsKeywords(instance, pattern.data(), pattern.size(), output.data(), output.size(),
+				stringsearch::api::KeywordsMatch::All, 0, &result, nullptr)
+			: FindUniqueItems(instance, pattern.data(), pattern.size(), output.data(), output.size(), &result, 0, nullptr));
+	}
+	state.SetItemsProcessed(std::int64_t(state.iterations()));
+
+	// and for each other at its end
+	if(state.thread_index() == 0) {
+		DestroySearchInstance(instance);
+		instance = nullptr;
+	}
+}
+
+#define BM_THREADS Arg(std::min(1000000, BM_CATALOG_LIMIT))->ThreadRange(1, int(std::max(1u, std::thread::hardware_concurrency())))->UseRealTime()
+
+BENCHMARK_CAPTURE(BenchmarkCatalogThreads, FindUniqueItems, ThreadsQuery::FindUniqueItems)->BM_THREADS;
+BENCHMARK_CAPTURE(BenchmarkCatalogThreads, Statistics, ThreadsQuery::Statistics)->BM_THREADS;
+BENCHMARK_CAPTURE(BenchmarkCatalogThreads, Keywords, ThreadsQuery::Keywords)->BM_THREADS;
+
+#undef BM_THREADS
+#endif
+
+#undef BM_CATALOG_SIZES
 #endif
 
 // Run the benchmark
@@ -0,0 +1,94 @@
+#include "stringsearch/RangeMinimum.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace stringsearch {
+	namespace {
+		[[nodiscard]] size_t FloorLog2(const size_t value) noexcept {
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanReverse64(&index, value);
+			return index;
+#else
+			return size_t(63 - __builtin_clzll(value));
+#endif
+		}
+
+		[[nodiscard]] size_t BlockCount(const size_t count) noexcept {
+			return (count + RangeMinimum::BlockSize - 1) / RangeMinimum::BlockSize;
+		}
+	}
+
+	template<typename IndexT>
+	size_t BasicRangeMinimum<IndexT>::SparseSize(const size_t count) noexcept {
+		const auto blocks = BlockCount(count);
+		return blocks == 0 ? 0 : (FloorLog2(blocks) + 1) * blocks;
+	}
+
+	template<typename IndexT>
+	BasicRangeMinimum<IndexT>::BasicRangeMinimum(const Span<const IndexT> values)
+		: values_(values),
+			blockCount_(BlockCount(values.size())) {
+		std::vector<IndexT> sparse(SparseSize(values.size()));
+		if(sparse.empty())
+			return;
+
+		for(size_t block = 0; block < blockCount_; ++block) {
+			const auto begin = block * BlockSize;
+			sparse[block] = scan(Value(begin), Value(std::min(begin + BlockSize, values.size())));
+		}
+
+		// Level k covers 2^k blocks, the last ones are cut off at the end of the array
+		const auto levels = sparse.size() / blockCount_;
+		for(size_t level = 1; level < levels; ++level) {
+			const auto previous = sparse.begin() + (level - 1) * blockCount_;
+			const auto current = sparse.begin() + level * blockCount_;
+			const auto half = size_t(1) << (level - 1);
+			for(size_t block = 0; block < blockCount_; ++block)
+				current[block] = block + half < blockCount_ ? smaller(previous[block], previous[block + half]) : Value(previous[block]);
+		}
+		sparse_ = Storage<IndexT>(std::move(sparse));
+	}
+
+	template<typename IndexT>
+	BasicRangeMinimum<IndexT>::BasicRangeMinimum(const Span<const IndexT> values, Storage<IndexT> sparse) noexcept
+		: values_(values),
+			sparse_(std::move(sparse)),
+			blockCount_(BlockCount(values.size())) {}
+
+	template<typename IndexT>
+	auto BasicRangeMinimum<IndexT>::scan(const Value begin, const Value end) const noexcept -> Value {
+		auto minimum = begin;
+		for(auto i = begin + 1; i < end; ++i) {
+			if(Value(values_[size_t(i)]) < Value(values_[size_t(minimum)]))
+				minimum = i;
+		}
+		return minimum;
+	}
+
+	template<typename IndexT>
+	auto BasicRangeMinimum<IndexT>::minimum(const Value begin, const Value end) const noexcept -> Value {
+		const auto firstBlock = size_t(begin) / BlockSize;
+		const auto lastBlock = size_t(end - 1) / BlockSize;
+		if(firstBlock == lastBlock)
+			return scan(begin, end);
+
+		auto minimum = scan(begin, Value((firstBlock + 1) * BlockSize));
+		if(firstBlock + 1 < lastBlock) {
+			const auto blocks = lastBlock - firstBlock - 1;
+			const auto level = FloorLog2(blocks);
+			const auto table = sparse_.data() + level * blockCount_;
+			minimum = smaller(minimum, smaller(table[firstBlock + 1], table[lastBlock - (size_t(1) << level)]));
+		}
+		return smaller(minimum, scan(Value(lastBlock * BlockSize), end));
+	}
+
+	template class BasicRangeMinimum<Index>;
+	template class BasicRangeMinimum<std::int64_t>;
+	template class BasicRangeMinimum<Index40>;
+}
\ No newline at end of file
@@ -4,7 +4,11 @@
 #include "stringsearch/Utf16Le.hpp"
 
 #include <algorithm>
+#include <limits>
 #include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
 #include <vector>
 #include <unordered_map>
 #include "MappingIterator.h"
@@ -23,20 +27,27 @@ namespace stringsearch {
 	}
 
 	ItemsLookup::ItemsLookup(const std::u16string_view text) {
-		items_.reserve(text.size());
-
-		auto index = Index(0);
-		for(auto it : text) {
-			items_.emplace_back(index);
-			if(it != 0)
+		std::vector<std::uint64_t> itemEnds(BitVector::WordCount(text.size()));
+		size_t index = 0;
+		for(size_t i = 0; i < text.size(); ++i) {
+			if(text[i] != 0)
 				continue;
-			
+
+			itemEnds[i / BitVector::WordBits] |= std::uint64_t(1) << (i % BitVector::WordBits);
 			++index;
 		}
 
+		if(index > size_t(std::numeric_limits<Index>::max()))
+			throw std::length_error("Too many items, item ids are Index");
+
+		itemEnds_ = BitVector(std::move(itemEnds), text.size());
 		itemCount_ = index;
 	}
 
+	ItemsLookup::ItemsLookup(BitVector itemEnds, const size_t itemCount) noexcept
+		: itemEnds_(std::move(itemEnds)),
+			itemCount_(itemCount) {}
+
 	OldUniqueSearchLookup::OldUniqueSearchLookup(const std::u16string_view text) : ItemsLookup(text) {
 		itemEnds_.reserve(itemCount());
 		auto index = Index(0);
@@ -148,104 +159,571 @@ namespace stringsearch {
 		return write;
 	}
 
-	void CreateArray(const std::u16string_view text, const Span<Index> sa) {
-		std::iota(sa.begin(), sa.end(), Index(0));
-		SuffixSortInPlace(text, sa);
+	namespace {
+		template<typename IndexT>
+		void CreateArrayOf(const std::u16string_view text, const Span<IndexT> sa, const BuildOptions &options) {
+			if(options.Algorithm == SuffixSortAlgorithm::InducedSorting) {
+				SuffixSortInducedSorting(text, sa);
+				return;
+			}
+
+			std::iota(sa.begin(), sa.end(), IndexT(0));
+			if(options.Algorithm == SuffixSortAlgorithm::AlphabetRadix)
+				SuffixSortAlphabet(text, sa);
+			else if(options.Algorithm == SuffixSortAlgorithm::CachedKeyRadix)
+				SuffixSortCachedKeys(text, sa);
+			else if(options.Threads == 1)
+				SuffixSortInPlace(text, sa);
+			else
+				SuffixSortParallel(text, sa, options.Threads);
+		}
+
+		template<typename IndexT, typename LcpT>
+		void CreateLcpArrayOf(const std::u16string_view text, const Span<const IndexT> sa, const Span<LcpT> lcp) {
+			const auto n = sa.size();
+			std::vector<LcpT> rank(n);
+			for(size_t i = 0; i < n; ++i)
+				rank[size_t(sa[i])] = LcpT(i);
+
+			// The lcp of the next text position is at most one less than the current one
+			size_t h = 0;
+			for(size_t i = 0; i < n; ++i) {
+				if(rank[i] == 0) {
+					lcp[0] = 0;
+					h = 0;
+					continue;
+				}
+
+				const auto j = size_t(sa[size_t(rank[i] - 1)]);
+				while(i + h < n && j + h < n && text[i + h] == text[j + h])
+					++h;
+				lcp[size_t(rank[i])] = LcpT(h);
+				if(h > 0)
+					--h;
+			}
+		}
+	}
+
+	void CreateArray(const std::u16string_view text, const Span<Index> sa, const BuildOptions &options) {
+		CreateArrayOf(text, sa, options);
+	}
+
+	void CreateArray(const std::u16string_view text, const Span<std::int64_t> sa, const BuildOptions &options) {
+		CreateArrayOf(text, sa, options);
+	}
+
+	void CreateLcpArray(const std::u16string_view text, const Span<const Index> sa, const Span<Index> lcp) {
+		CreateLcpArrayOf(text, sa, lcp);
+	}
+
+	void CreateLcpArray(const std::u16string_view text, const Span<const std::int64_t> sa, const Span<std::int64_t> lcp) {
+		CreateLcpArrayOf(text, sa, lcp);
+	}
+
+	namespace {
+		template<typename T>
+		[[nodiscard]] T Middle(const T lower, const T upper) noexcept {
+			return lower + (upper - lower) / 2;
+		}
+
+		// Returns the lcp of the entries lower and upper (0 for the bounds -1 and n) and fills the table for all middles
+		// in between
+		template<typename T>
+		size_t FillLcpTable(const Span<const T> lcp, const T lower, const T upper, std::vector<std::uint16_t> &left,
+								std::vector<std::uint16_t> &right) {
+			if(upper - lower == 1)
+				return lower < 0 || upper == T(lcp.size()) ? 0 : size_t(lcp[size_t(upper)]);
+
+			const auto middle = Middle(lower, upper);
+			const auto l = FillLcpTable(lcp, lower, middle, left, right);
+			const auto r = FillLcpTable(lcp, middle, upper, left, right);
+			left[size_t(middle)] = std::uint16_t(std::min(l, LcpTable::Max));
+			right[size_t(middle)] = std::uint16_t(std::min(r, LcpTable::Max));
+			return std::min(l, r);
+		}
+
+		// Every entry in (Lower, Upper) shares at least min(LowerLcp, UpperLcp) characters with the pattern
+		template<typename T>
+		struct SearchInterval {
+			T Lower;
+			T Upper;
+			size_t LowerLcp;
+			size_t UpperLcp;
+		};
+
+		[[nodiscard]] size_t MatchLength(const std::u16string_view text, const size_t suffix, const std::u16string_view pattern, size_t from) noexcept {
+			const auto end = std::min(text.size() - suffix, pattern.size());
+			while(from < end && text[suffix + from] == pattern[from])
+				++from;
+			return from;
+		}
+
+		// Narrows the interval until the bounds are neighbours and returns the upper one. Entries starting with the
+		// pattern go to the upper side when searching the lower bound and to the lower side when searching the upper
+		// bound. The middles are the same as for the LcpTable, so its values are valid for every interval.
+		template<bool UpperBound, typename IndexT>
+		IndexValue<IndexT> NarrowInterval(const Span<const IndexT> sa, const LcpTable *lcp, const std::u16string_view text,
+													const std::u16string_view pattern, SearchInterval<IndexValue<IndexT>> interval,
+													std::optional<SearchInterval<IndexValue<IndexT>>> *firstMatch) {
+			using T = IndexValue<IndexT>;
+			auto [lower, upper, lowerLcp, upperLcp] = interval;
+			while(upper - lower > 1) {
+				const auto middle = Middle(lower, upper);
+
+				size_t known;
+				if(!lcp) {
+					known = std::min(lowerLcp, upperLcp);
+				} else if(lowerLcp >= upperLcp) {
+					// The middle is on the side of the lower bound if it shares more with it than the pattern does
+					const auto l = lcp->left(size_t(middle));
+					if(l > lowerLcp) {
+						lower = middle;
+						continue;
+					}
+					if(l < lowerLcp && l != LcpTable::Max) {
+						upper = middle;
+						upperLcp = l;
+						continue;
+					}
+					known = std::min(l, lowerLcp);
+				} else {
+					const auto r = lcp->right(size_t(middle));
+					if(r > upperLcp) {
+						upper = middle;
+						continue;
+					}
+					if(r < upperLcp && r != LcpTable::Max) {
+						lower = middle;
+						lowerLcp = r;
+						continue;
+					}
+					known = std::min(r, upperLcp);
+				}
+
+				const auto suffix = size_t(sa[size_t(middle)]);
+				const auto length = MatchLength(text, suffix, pattern, known);
+				const auto matches = length == pattern.size();
+				const auto less = !matches && (suffix + length == text.size() || text[suffix + length] < pattern[length]);
+
+				if constexpr(!UpperBound) {
+					// The upper bound search takes the same path until here
+					if(matches && !*firstMatch)
+						*firstMatch = SearchInterval<T>{middle, upper, length, upperLcp};
+				}
+
+				if(less || (UpperBound && matches)) {
+					lower = middle;
+					lowerLcp = length;
+				} else {
+					upper = middle;
+					upperLcp = length;
+				}
+			}
+
+			return upper;
+		}
+	}
+
+	template<typename IndexT>
+	LcpTable::LcpTable(const std::u16string_view text, const Span<const IndexT> sa) {
+		using Value = IndexValue<IndexT>;
+		std::vector<Value> lcp(sa.size());
+		CreateLcpArrayOf(text, sa, Span<Value>(lcp));
+
+		std::vector<std::uint16_t> left(sa.size()), right(sa.size());
+		FillLcpTable(Span<const Value>(lcp), Value(-1), Value(sa.size()), left, right);
+		left_ = Storage<std::uint16_t>(std::move(left));
+		right_ = Storage<std::uint16_t>(std::move(right));
+	}
+
+	LcpTable::LcpTable(Storage<std::uint16_t> left, Storage<std::uint16_t> right) noexcept
+		: left_(std::move(left)),
+			right_(std::move(right)) {}
+
+	namespace {
+		[[nodiscard]] std::uint32_t Bigram(const char16_t first, const char16_t second) noexcept {
+			return std::uint32_t(first) << 16 | second;
+		}
+	}
+
+	template<typename IndexT>
+	BasicPrefixTable<IndexT>::BasicPrefixTable(const std::u16string_view text, const Span<const IndexT> sa, const size_t bigramThreshold) {
+		using Value = IndexValue<IndexT>;
+		// Every suffix starts with its character, so the counts of the text are the sizes of the ranges
+		std::vector<Value> counts(0x10001);
+		for(const auto c : text)
+			++counts[size_t(c) + 1];
+		std::partial_sum(counts.begin(), counts.end(), counts.begin());
+		std::vector<IndexT> starts(counts.begin(), counts.end());
+
+		std::vector<std::uint32_t> bigrams;
+		std::vector<IndexT> bigramStarts;
+		for(size_t c = 0; c < 0x10000; ++c) {
+			if(size_t(counts[c + 1] - counts[c]) <= bigramThreshold)
+				continue;
+
+			// The range is sorted by the second character, only the suffix without one comes first
+			for(auto i = counts[c]; i < counts[c + 1]; ++i) {
+				const auto next = size_t(sa[size_t(i)]) + 1;
+				if(next == text.size())
+					continue;
+
+				const auto bigram = Bigram(char16_t(c), text[next]);
+				if(bigrams.empty() || bigrams.back() != bigram) {
+					bigrams.emplace_back(bigram);
+					bigramStarts.emplace_back(i);
+				}
+			}
+		}
+
+		starts_ = Storage<IndexT>(std::move(starts));
+		bigrams_ = Storage<std::uint32_t>(std::move(bigrams));
+		bigramStarts_ = Storage<IndexT>(std::move(bigramStarts));
+	}
+
+	template<typename IndexT>
+	BasicPrefixTable<IndexT>::BasicPrefixTable(Storage<IndexT> starts, Storage<std::uint32_t> bigrams, Storage<IndexT> bigramStarts) noexcept
+		: starts_(std::move(starts)),
+			bigrams_(std::move(bigrams)),
+			bigramStarts_(std::move(bigramStarts)) {}
+
+	template<typename IndexT>
+	BasicPrefixRange<IndexT> BasicPrefixTable<IndexT>::find(const std::u16string_view pattern) const noexcept {
+		using PrefixRange = BasicPrefixRange<IndexT>;
+		const auto first = pattern[0];
+		const auto range = PrefixRange{starts_[first], starts_[size_t(first) + 1], 1};
+		if(pattern.size() == 1 || range.Begin == range.End)
+			return range;
+
+		// The first character has bigrams if the entry found or the one before it belongs to it
+		const auto it = std::lower_bound(bigrams_.begin(), bigrams_.end(), Bigram(first, pattern[1]));
+		const auto isFirst = [&](const std::uint32_t *bigram) {
+			return bigram != bigrams_.end() && *bigram >> 16 == first;
+		};
+		if(isFirst(it)) {
+			const auto offset = it - bigrams_.begin();
+			const auto begin = IndexValue<IndexT>(bigramStarts_[offset]);
+			if(*it != Bigram(first, pattern[1]))
+				return PrefixRange{begin, begin, 2};
+
+			const auto end = isFirst(it + 1) ? IndexValue<IndexT>(bigramStarts_[offset + 1]) : range.End;
+			return PrefixRange{begin, end, 2};
+		}
+
+		// it - 1 must not be formed before the first bigram or from an empty table
+		if(it != bigrams_.begin() && isFirst(it - 1))
+			return PrefixRange{range.End, range.End, 2};
+
+		return range;
+	}
+
+	template<typename IndexT>
+	BasicSuffixArray<IndexT>::BasicSuffixArray(const Span<const IndexT> array) : sa_(std::vector<IndexT>(array.begin(), array.end())) {}
+
+	template<typename IndexT>
+	BasicSuffixArray<IndexT>::BasicSuffixArray(const std::u16string_view text, const BuildOptions &options) {
+		if(text.size() > size_t(std::numeric_limits<Value>::max()) || (std::is_same_v<IndexT, Index40> && text.size() >> 39 != 0))
+			throw std::length_error("Text is too long for the index type");
+
+		if constexpr(std::is_same_v<IndexT, Value>) {
+			std::vector<IndexT> sa(text.size());
+			CreateArray(text, sa, options);
+			sa_ = Storage<IndexT>(std::move(sa));
+		} else {
+			std::vector<Value> sorted(text.size());
+			CreateArray(text, sorted, options);
+			sa_ = Storage<IndexT>(std::vector<IndexT>(sorted.begin(), sorted.end()));
+		}
+		if(options.LcpSearch)
+			lcp_ = LcpTable(text, sa_.get());
+		if(options.PrefixSearch)
+			prefix_ = BasicPrefixTable<IndexT>(text, sa_.get());
 	}
 
-	SuffixArray::SuffixArray(const Span<const Index> array) : sa_(array.begin(), array.end()) {}
+	template<typename IndexT>
+	BasicSuffixArray<IndexT>::BasicSuffixArray(Storage<IndexT> sa, LcpTable lcp, BasicPrefixTable<IndexT> prefix) noexcept
+		: sa_(std::move(sa)),
+			lcp_(std::move(lcp)),
+			prefix_(std::move(prefix)) {}
+
+	template<typename IndexT>
+	BasicFindResult<IndexT> BasicSuffixArray<IndexT>::find(const std::u16string_view text, const std::u16string_view pattern) const {
+		auto interval = SearchInterval<Value>{Value(-1), Value(sa_.size()), 0, 0};
+		auto lcp = lcp_.empty() ? nullptr : &lcp_;
+		if(!prefix_.empty() && !pattern.empty()) {
+			const auto range = prefix_.find(pattern);
+			if(range.Length == pattern.size() || range.Begin == range.End)
+				return FindResult(begin() + range.Begin, begin() + range.End);
+
+			// The lcp table only knows the intervals of a search over the whole array
+			interval = SearchInterval<Value>{range.Begin - 1, range.End, range.Length, range.Length};
+			lcp = nullptr;
+		}
+
+		std::optional<SearchInterval<Value>> firstMatch;
+		const auto lower = NarrowInterval<false>(get(), lcp, text, pattern, interval, &firstMatch);
+		const auto upper = firstMatch ? NarrowInterval<true>(get(), lcp, text, pattern, *firstMatch, nullptr) : lower;
 
-	SuffixArray::SuffixArray(const std::u16string_view text) : sa_(text.size()) {
-		CreateArray(text, sa_);
+		return FindResult(begin() + lower, begin() + upper);
 	}
 
-	FindResult SuffixArray::find(const std::u16string_view text, const std::u16string_view pattern) const {
-		const auto lower = lowerBound(sa_.begin(), sa_.end(), text, pattern);
-		const auto upper = upperBound(lower, sa_.end(), text, pattern);
+	template<typename IndexT>
+	BasicFindResult<IndexT> BasicSuffixArray<IndexT>::refine(const std::u16string_view text, const FindResult range, const size_t matched,
+																				const std::u16string_view pattern) const {
+		if(range.size() == 0 || matched >= pattern.size())
+			return range;
+
+		// Every entry of the range shares the matched characters with the pattern, like the range of the PrefixTable
+		const auto interval = SearchInterval<Value>{indexOf(range.begin()) - 1, indexOf(range.end()), matched, matched};
+		std::optional<SearchInterval<Value>> firstMatch;
+		const auto lower = NarrowInterval<false>(get(), nullptr, text, pattern, interval, &firstMatch);
+		const auto upper = firstMatch ? NarrowInterval<true>(get(), nullptr, text, pattern, *firstMatch, nullptr) : lower;
 
-		return FindResult(lower, upper);
+		return FindResult(begin() + lower, begin() + upper);
 	}
 
-	IndexPtr SuffixArray::lowerBound(const IndexPtr begin, const IndexPtr end,
-												const std::u16string_view text, const std::u16string_view pattern) {
-		return std::lower_bound(begin, end, Index(0), [&](const Index &index, auto) {
+	template<typename IndexT>
+	BasicIndexPtr<IndexT> BasicSuffixArray<IndexT>::lowerBound(const IndexPtr begin, const IndexPtr end,
+																		const std::u16string_view text, const std::u16string_view pattern) {
+		return std::lower_bound(begin, end, 0, [&](const IndexT &index, auto) {
 			const auto suffix = GetSuffix(text, index, pattern.size());
 			return LessThan(suffix, pattern);
 		});
 	}
 
-	IndexPtr SuffixArray::upperBound(const IndexPtr begin, const IndexPtr end,
-												const std::u16string_view text, const std::u16string_view pattern) {
-		return std::upper_bound(begin, end, Index(0), [&](auto, const Index &index) {
+	template<typename IndexT>
+	BasicIndexPtr<IndexT> BasicSuffixArray<IndexT>::upperBound(const IndexPtr begin, const IndexPtr end,
+																		const std::u16string_view text, const std::u16string_view pattern) {
+		return std::upper_bound(begin, end, 0, [&](auto, const IndexT &index) {
 			const auto suffix = GetSuffix(text, index, pattern.size());
 			return LessThan(pattern, suffix);
 		});
 	}
 
-	Index SuffixArray::indexOf(const IndexPtr it) const noexcept {
-		return Index(std::distance(sa_.begin(), it));
+	template<typename IndexT>
+	auto BasicSuffixArray<IndexT>::indexOf(const IndexPtr it) const noexcept -> Value {
+		return Value(std::distance(sa_.begin(), it));
 	}
 
-	UniqueSearchLookup::UniqueSearchLookup(const std::u16string_view text, const SuffixArray &sa) : ItemsLookup(text), suffixArray_(sa) {
-		previousEntryOfSameItem_.reserve(sa.get().size());
-		std::vector<Index> lastIndexOfWord(itemCount(), Index(-1));
+	template<typename IndexT>
+	BasicUniqueSearchLookup<IndexT>::BasicUniqueSearchLookup(const std::u16string_view text, const BasicSuffixArray<IndexT> &sa,
+																				const BuildOptions &options)
+		: ItemsLookup(text),
+			suffixArray_(sa) {
+		std::vector<IndexT> previousEntryOfSameItem;
+		previousEntryOfSameItem.reserve(sa.get().size());
+		std::vector<Value> lastIndexOfWord(itemCount(), Value(-1));
 		for(auto it = sa.begin(); it != sa.end(); ++it) {
-			const auto word = getItem(*it);
+			const auto word = getItem(size_t(*it));
 			auto &value = lastIndexOfWord[word];
-			previousEntryOfSameItem_.emplace_back(value);
-			value = Index(std::distance(sa.begin(), it));
+			previousEntryOfSameItem.emplace_back(value);
+			value = Value(std::distance(sa.begin(), it));
 		}
+		if(options.DistinctCounting) {
+			std::vector<Value> values(previousEntryOfSameItem.size());
+			std::transform(previousEntryOfSameItem.begin(), previousEntryOfSameItem.end(), values.begin(), [](const Value previous) {
+				return previous + 1;
+			});
+			distinctItems_ = WaveletMatrix(std::move(values), WaveletMatrix::LevelCount(sa.get().size()));
+		}
+
+		previousEntryOfSameItem_ = Storage<IndexT>(std::move(previousEntryOfSameItem));
+		if(options.UniqueReporting)
+			rangeMinimum_ = BasicRangeMinimum<IndexT>(previousEntryOfSameItem_.get());
 	}
 
-	FindUniqueResult UniqueSearchLookup::findUnique(const FindResult result, const Span<Index> outputIndices, unsigned int offset) const {
-		auto write = outputIndices.begin();
-		auto it = uniqueItemsInRange(result, offset);
-		for(; it != UniqueItemsIteratorEnd() && write != outputIndices.end(); ++it, ++write)
-			*write = *it;
+	template<typename IndexT>
+	BasicUniqueSearchLookup<IndexT>::BasicUniqueSearchLookup(ItemsLookup items, const BasicSuffixArray<IndexT> &sa,
+																				Storage<IndexT> previousEntryOfSameItem, Storage<IndexT> rangeMinimum,
+																				WaveletMatrix distinctItems) noexcept
+		: ItemsLookup(std::move(items)),
+			suffixArray_(sa),
+			previousEntryOfSameItem_(std::move(previousEntryOfSameItem)),
+			rangeMinimum_(previousEntryOfSameItem_.get(), std::move(rangeMinimum)),
+			distinctItems_(std::move(distinctItems)) {}
+
+	template<typename IndexT>
+	template<typename F>
+	void BasicUniqueSearchLookup<IndexT>::reportUnique(const FindResult result, const size_t offset, F &&f) const {
+		// An entry is the first of its item if the previous one is before the range. If the minimum of a part of the
+		// range isn't, no entry of the part is. end < 0 marks an entry to report, it is pushed between the parts left
+		// and right of it to report in order.
+		const auto first = suffixArray_.indexOf(result.begin());
+		std::vector<std::pair<Value, Value>> stack{{first + Value(offset), suffixArray_.indexOf(result.end())}};
+		while(!stack.empty()) {
+			const auto [begin, end] = stack.back();
+			stack.pop_back();
+			if(end < 0) {
+				if(!f(begin))
+					return;
+				continue;
+			}
+			if(begin >= end)
+				continue;
 
-		return FindUniqueResult(
-			size_t(std::distance(outputIndices.begin(), write)),
-			it.offsetFromResultBegin()
-		);
+			const auto minimum = rangeMinimum_.minimum(begin, end);
+			if(previousEntryOf(minimum) >= first)
+				continue;
+
+			stack.emplace_back(minimum + 1, end);
+			stack.emplace_back(minimum, Value(-1));
+			stack.emplace_back(begin, minimum);
+		}
 	}
 
-	UniqueItemsIterator UniqueSearchLookup::uniqueItemsInRange(const FindResult result, const unsigned int offset) const noexcept {
-		return UniqueItemsIterator(result, result.begin() + offset, *this);
+	template<typename IndexT>
+	template<typename F>
+	void BasicUniqueSearchLookup<IndexT>::forEachUnique(const FindResult result, F &&f) const {
+		if(rangeMinimum_.empty()) {
+			for(auto it = uniqueItemsInRange(result, 0); it != UniqueItemsIteratorEnd(); ++it)
+				f(*it);
+		} else {
+			reportUnique(result, 0, [&](const Value saIndex) {
+				f(Value(suffixArray_.get()[size_t(saIndex)]));
+				return true;
+			});
+		}
 	}
 
-	Index UniqueSearchLookup::previousEntryOf(const Index saIndex) const noexcept {
-		return previousEntryOfSameItem_[saIndex];
+	template<typename IndexT>
+	FindUniqueResult BasicUniqueSearchLookup<IndexT>::findUnique(const FindResult result, const Span<Value> outputIndices, const size_t offset,
+																					const FindUniqueMode mode) const {
+		const auto first = suffixArray_.indexOf(result.begin());
+		const auto end = suffixArray_.indexOf(result.end());
+		auto i = first + Value(offset);
+
+		// Auto scans as long as that is about as fast as reporting the whole page (about two scanned blocks per item)
+		auto scanEnd = end;
+		if(!rangeMinimum_.empty() && mode == FindUniqueMode::Report)
+			scanEnd = i;
+		else if(!rangeMinimum_.empty() && mode == FindUniqueMode::Auto)
+			scanEnd = Value(std::min(size_t(end), size_t(i) + 4 * RangeMinimum::BlockSize * (outputIndices.size() + 1)));
+
+		size_t count = 0;
+		for(; i < scanEnd; ++i) {
+			if(isDuplicateInRange(result.begin(), previousEntryOf(i)))
+				continue;
+			if(count == outputIndices.size())
+				return FindUniqueResult(count, size_t(i - first));
+			outputIndices[count++] = suffixArray_.get()[size_t(i)];
+		}
+
+		auto consumed = result.size();
+		if(i < end) {
+			reportUnique(result, size_t(i - first), [&](const Value saIndex) {
+				if(count == outputIndices.size()) {
+					consumed = size_t(saIndex - first);
+					return false;
+				}
+				outputIndices[count++] = suffixArray_.get()[size_t(saIndex)];
+				return true;
+			});
+		}
+		return FindUniqueResult(count, consumed);
 	}
 
-	bool UniqueSearchLookup::isDuplicateInRange(const IndexPtr begin, const Index prev) const noexcept {
+	template<typename IndexT>
+	size_t BasicUniqueSearchLookup<IndexT>::countDistinct(const FindResult result) const {
+		if(!distinctItems_.empty()) {
+			const auto first = size_t(suffixArray_.indexOf(result.begin()));
+			return distinctItems_.countLess(first, first + result.size(), first + 1);
+		}
+
+		size_t count = 0;
+		forEachUnique(result, [&](Value) { ++count; });
+		return count;
+	}
+
+	template<typename IndexT>
+	BasicUniqueItemsIterator<IndexT> BasicUniqueSearchLookup<IndexT>::uniqueItemsInRange(const FindResult result,
+																											const size_t offset) const noexcept {
+		return BasicUniqueItemsIterator<IndexT>(result, result.begin() + offset, *this);
+	}
+
+	template<typename IndexT>
+	auto BasicUniqueSearchLookup<IndexT>::previousEntryOf(const Value saIndex) const noexcept -> Value {
+		return previousEntryOfSameItem_[size_t(saIndex)];
+	}
+
+	template<typename IndexT>
+	bool BasicUniqueSearchLookup<IndexT>::isDuplicateInRange(const IndexPtr begin, const Value prev) const noexcept {
 		return 0 <= prev && begin <= suffixArray_.begin() + prev;
 	}
 
-	bool UniqueSearchLookup::isDuplicateInRange(const IndexPtr begin, const IndexPtr ptr) const noexcept {
+	template<typename IndexT>
+	bool BasicUniqueSearchLookup<IndexT>::isDuplicateInRange(const IndexPtr begin, const IndexPtr ptr) const noexcept {
 		return isDuplicateInRange(begin, previousEntryOf(suffixArray_.indexOf(ptr)));
 	}
 
-	std::vector<std::pair<Index, ContainedInfo>> UniqueSearchLookup::findUniquePatterns(const Span<const FindResult> results) const {
+	template<typename IndexT>
+	std::vector<Index> BasicUniqueSearchLookup<IndexT>::uniqueItems(const FindResult result) const {
+		std::vector<Index> items;
+		forEachUnique(result, [&](const Value suffix) {
+			items.emplace_back(getItem(size_t(suffix)));
+		});
+		std::sort(items.begin(), items.end());
+		return items;
+	}
+
+	template<typename IndexT>
+	std::vector<Index> BasicUniqueSearchLookup<IndexT>::itemsContainedIn(const Span<const Index> items, const FindResult result) const {
+		std::vector<Index> res;
+		if(items.empty())
+			return res;
+
+		// A bit per item between the first and the last one, cheaper than the visit of the range if it is big enough.
+		// Otherwise a binary search per visited item.
+		const auto first = size_t(items.front());
+		const auto words = (size_t(items.back()) - first) / 64 + 1;
+		if(words <= result.size()) {
+			std::vector<std::uint64_t> visited(words);
+			forEachUnique(result, [&](const Value suffix) {
+				const auto item = size_t(getItem(size_t(suffix)));
+				if(item >= first && item - first < words * 64)
+					visited[(item - first) / 64] |= std::uint64_t(1) << (item - first) % 64;
+			});
+			std::copy_if(items.begin(), items.end(), std::back_inserter(res), [&](const Index item) {
+				return (visited[(size_t(item) - first) / 64] >> (size_t(item) - first) % 64) & 1;
+			});
+			return res;
+		}
+
+		std::vector<bool> contained(items.size());
+		forEachUnique(result, [&](const Value suffix) {
+			const auto item = getItem(size_t(suffix));
+			const auto it = std::lower_bound(items.begin(), items.end(), item);
+			if(it != items.end() && *it == item)
+				contained[size_t(std::distance(items.begin(), it))] = true;
+		});
+		for(size_t i = 0; i < items.size(); ++i) {
+			if(contained[i])
+				res.emplace_back(items[i]);
+		}
+		return res;
+	}
+
+	template<typename IndexT>
+	std::vector<std::pair<Index, ContainedInfo>> BasicUniqueSearchLookup<IndexT>::findUniquePatterns(const Span<const FindResult> results) const {
 		std::unordered_map<Index, ContainedInfo> containedInCountMap;
 		for(auto resultIt = results.begin(); resultIt != results.end(); ++resultIt) {
 			const auto &result = *resultIt;
 			const auto idx = std::distance(results.begin(), resultIt);
-			for(auto it = uniqueItemsInRange(result, 0); it != UniqueItemsIteratorEnd(); ++it) {
-				const auto suffix = *it;
-				const auto item = getItem(suffix);
+			forEachUnique(result, [&](const Value suffix) {
+				const auto item = getItem(size_t(suffix));
 				const auto cit = containedInCountMap.find(item);
 				if(cit == containedInCountMap.end()) {
 					containedInCountMap.emplace(item, ContainedInfo{1, unsigned(idx)});
 				} else {
 					++cit->second.Count;
 				}
-			}
+			});
 		}
 		
 		return {containedInCountMap.begin(), containedInCountMap.end()};
 	}
 
-	std::vector<Index> UniqueSearchLookup::findUniqueInAllPatterns(const Span<const FindResult> results) const {
+	template<typename IndexT>
+	std::vector<Index> BasicUniqueSearchLookup<IndexT>::findUniqueInAllPatterns(const Span<const FindResult> results) const {
 		std::vector<Index> indices;
 		if(results.empty())
 			return indices;
@@ -256,30 +734,28 @@ namespace stringsearch {
 		});
 
 		std::unordered_map<Index, unsigned> containedInCountMap;
-		for(auto it = uniqueItemsInRange(*minIt, 0); it != UniqueItemsIteratorEnd(); ++it) {
-			const auto suffix = *it;
-			const auto item = getItem(suffix);
+		forEachUnique(*minIt, [&](const Value suffix) {
+			const auto item = getItem(size_t(suffix));
 			const auto cit = containedInCountMap.find(item);
 			if(cit == containedInCountMap.end()) {
 				containedInCountMap.emplace(item, 1);
 			} else {
 				++cit->second;
 			}
-		}
+		});
 
 		for(auto resultIt = results.begin(); resultIt != results.end(); ++resultIt) {
 			if(resultIt == minIt)
 				continue;
 
 			const auto &result = *resultIt;
-			for(auto it = uniqueItemsInRange(result, 0); it != UniqueItemsIteratorEnd(); ++it) {
-				const auto suffix = *it;
-				const auto item = getItem(suffix);
+			forEachUnique(result, [&](const Value suffix) {
+				const auto item = getItem(size_t(suffix));
 				const auto cit = containedInCountMap.find(item);
 				// if it is not contained in the map it was not contained in the first result range and can therefore be ignored
 				if(cit != containedInCountMap.end())
 					++cit->second;
-			}
+			});
 		}
 
 		std::copy_if(containedInCountMap.begin(), containedInCountMap.end(), Map(std::back_inserter(indices), [](const std::unordered_map<Index, unsigned>::value_type &p) {
@@ -290,28 +766,185 @@ namespace stringsearch {
 		return indices;
 	}
 	
-	Search::Search(const std::u16string_view text)
-		: suffixArray_(text),
-			itemsLookup_(text, suffixArray()),
-			text_(text) {}
+	namespace {
+		template<typename IndexT>
+		[[nodiscard]] WaveletMatrix MakeDistinctItems(const BasicSearchData<IndexT> &data) {
+			if(data.DistinctWords.empty())
+				return {};
+
+			const auto size = data.Suffixes.size();
+			const auto levels = WaveletMatrix::LevelCount(size);
+			auto bits = BitVector(Storage<std::uint64_t>(data.DistinctWords), Storage<std::uint64_t>(data.DistinctRanks), size * levels);
+			return WaveletMatrix(std::move(bits), size, levels);
+		}
+
+		template<typename T>
+		[[nodiscard]] size_t Bytes(const Span<const T> array) noexcept {
+			return array.size() * sizeof(T);
+		}
 
-	FindResult Search::find(const std::u16string_view pattern) const {
+		[[nodiscard]] size_t BitVectorBytes(const size_t size) noexcept {
+			return (BitVector::WordCount(size) + BitVector::RankCount(size)) * sizeof(std::uint64_t);
+		}
+	}
+
+	size_t SuffixSortScratch(const size_t n, const size_t value, const BuildOptions &options) noexcept {
+		// Map of the LMS positions, the LMS positions, their sorted copy and the reduced text, three bucket arrays over
+		// all characters
+		const auto inducedSorting = n * value * 9 / 2 + 3 * 0x10001 * value;
+		// The radix sorts give up for SA-IS on repetitive text after freeing their buffers, the larger of both bounds them
+		switch(options.Algorithm) {
+			case SuffixSortAlgorithm::InducedSorting:
+				return inducedSorting;
+			case SuffixSortAlgorithm::AlphabetRadix:
+				// Buffer, offsets and the coded text, the frequency of every character
+				return std::max(n * (2 * value + 2) + 0x10000 * sizeof(size_t), inducedSorting);
+			case SuffixSortAlgorithm::CachedKeyRadix:
+				// Keys, their buffer and the buffer of the entries
+				return std::max(n * (2 * sizeof(std::uint64_t) + value), inducedSorting);
+			default:
+				return std::max(options.Threads == 1 ? 0 : n * value, inducedSorting);
+		}
+	}
+
+	template<typename IndexT>
+	MemoryUsage EstimateMemoryUsage(const size_t characters, const size_t items, const BuildOptions &options) {
+		using Value = IndexValue<IndexT>;
+		const auto n = characters;
+		MemoryUsage usage;
+		usage.Text = n * sizeof(char16_t);
+		usage.SuffixArray = n * sizeof(IndexT);
+		if(options.LcpSearch)
+			usage.LcpTable = n * 2 * sizeof(std::uint16_t);
+		if(options.PrefixSearch)
+			usage.PrefixTable = 0x10001 * sizeof(IndexT);
+		usage.ItemEnds = BitVectorBytes(n);
+		usage.PreviousEntryOfSameItem = n * sizeof(IndexT);
+		if(options.UniqueReporting)
+			usage.RangeMinimum = BasicRangeMinimum<IndexT>::SparseSize(n) * sizeof(IndexT);
+		if(options.DistinctCounting)
+			usage.DistinctItems = BitVectorBytes(WaveletMatrix::LevelCount(n) * n);
+
+		// Every step frees its temporary arrays before the next one starts. Entries narrower than Value are sorted as
+		// Value and packed into a copy.
+		auto peak = n * sizeof(Value) + SuffixSortScratch(n, sizeof(Value), options);
+		if constexpr(!std::is_same_v<IndexT, Value>)
+			peak = std::max(peak, n * (sizeof(Value) + sizeof(IndexT)));
+		auto built = usage.SuffixArray;
+		// The lcp array and the rank of every suffix, then the lcp array and the table
+		if(options.LcpSearch)
+			peak = std::max(peak, built + n * std::max(2 * sizeof(Value), sizeof(Value) + 2 * sizeof(std::uint16_t)));
+		built += usage.LcpTable;
+		if(options.PrefixSearch)
+			peak = std::max(peak, built + 0x10001 * (sizeof(Value) + sizeof(IndexT)));
+		built += usage.PrefixTable + usage.ItemEnds + usage.PreviousEntryOfSameItem;
+		// The last entry of every item
+		peak = std::max(peak, built + items * sizeof(Value));
+		// The values and their partitioned copy next to the bits
+		if(options.DistinctCounting)
+			peak = std::max(peak, built + 2 * n * sizeof(Value) + usage.DistinctItems);
+		built += usage.RangeMinimum + usage.DistinctItems;
+		usage.BuildPeak = std::max(peak, built);
+		return usage;
+	}
+
+	template<typename IndexT>
+	BasicSearch<IndexT>::BasicSearch(const std::u16string_view text, const BuildOptions &options)
+		: suffixArray_(text, options),
+			itemsLookup_(text, suffixArray(), options),
+			text_(text),
+			buildPeak_(EstimateMemoryUsage<IndexT>(text.size(), itemsLookup_.itemCount(), options).BuildPeak) {}
+
+	template<typename IndexT>
+	BasicSearch<IndexT>::BasicSearch(const BasicSearchData<IndexT> &data)
+		: suffixArray_(Storage<IndexT>(data.Suffixes),
+				LcpTable(Storage<std::uint16_t>(data.LcpLeft), Storage<std::uint16_t>(data.LcpRight)),
+				BasicPrefixTable<IndexT>(Storage<IndexT>(data.PrefixStarts), Storage<std::uint32_t>(data.PrefixBigrams),
+					Storage<IndexT>(data.PrefixBigramStarts))),
+			itemsLookup_(ItemsLookup(BitVector(Storage<std::uint64_t>(data.ItemEnds), Storage<std::uint64_t>(data.ItemEndRanks), data.Text.size()), data.ItemCount),
+				suffixArray(), Storage<IndexT>(data.PreviousEntryOfSameItem),
+				Storage<IndexT>(data.UniqueRangeMinimum),
+				MakeDistinctItems(data)),
+			text_(data.Text) {}
+
+	template<typename IndexT>
+	BasicFindResult<IndexT> BasicSearch<IndexT>::find(const std::u16string_view pattern) const {
 		return suffixArray_.find(text_, pattern);
 	}
 
-	void UniqueItemsIterator::next() noexcept {
+	template<typename IndexT>
+	BasicFindResult<IndexT> BasicSearch<IndexT>::refine(const BasicFindResult<IndexT> range, const size_t matched, const std::u16string_view pattern) const {
+		return suffixArray_.refine(text_, range, matched, pattern);
+	}
+
+	template<typename IndexT>
+	BasicSearchData<IndexT> BasicSearch<IndexT>::data() const noexcept {
+		return BasicSearchData<IndexT>{
+			text_,
+			suffixArray_.get(),
+			itemsLookup_.itemEnds().wordsArray(),
+			itemsLookup_.itemEnds().ranksArray(),
+			itemsLookup_.itemCount(),
+			itemsLookup_.previousEntryOfSameItem(),
+			suffixArray_.lcpTable().leftArray(),
+			suffixArray_.lcpTable().rightArray(),
+			suffixArray_.prefixTable().startsArray(),
+			suffixArray_.prefixTable().bigramsArray(),
+			suffixArray_.prefixTable().bigramStartsArray(),
+			itemsLookup_.rangeMinimum().sparseArray(),
+			itemsLookup_.distinctItems().bits().wordsArray(),
+			itemsLookup_.distinctItems().bits().ranksArray()
+		};
+	}
+
+	template<typename IndexT>
+	MemoryUsage BasicSearch<IndexT>::memoryUsage() const noexcept {
+		const auto arrays = data();
+		MemoryUsage usage;
+		usage.Text = arrays.Text.size() * sizeof(char16_t);
+		usage.SuffixArray = Bytes(arrays.Suffixes);
+		usage.LcpTable = Bytes(arrays.LcpLeft) + Bytes(arrays.LcpRight);
+		usage.PrefixTable = Bytes(arrays.PrefixStarts) + Bytes(arrays.PrefixBigrams) + Bytes(arrays.PrefixBigramStarts);
+		usage.ItemEnds = Bytes(arrays.ItemEnds) + Bytes(arrays.ItemEndRanks);
+		usage.PreviousEntryOfSameItem = Bytes(arrays.PreviousEntryOfSameItem);
+		usage.RangeMinimum = Bytes(arrays.UniqueRangeMinimum);
+		usage.DistinctItems = Bytes(arrays.DistinctWords) + Bytes(arrays.DistinctRanks);
+		usage.BuildPeak = buildPeak_;
+		return usage;
+	}
+
+	template<typename IndexT>
+	void BasicUniqueItemsIterator<IndexT>::next() noexcept {
 		while(++it_ != result_.end() && isDuplicate()) {}
 	}
 
-	bool UniqueItemsIterator::isDuplicate() const noexcept {
+	template<typename IndexT>
+	bool BasicUniqueItemsIterator<IndexT>::isDuplicate() const noexcept {
 		return itemsLookup_.isDuplicateInRange(result_.begin(), it_);
 	}
 
-	size_t UniqueItemsIterator::offsetFromResultBegin() const noexcept {
+	template<typename IndexT>
+	size_t BasicUniqueItemsIterator<IndexT>::offsetFromResultBegin() const noexcept {
 		return std::distance(result_.begin(), it_);
 	}
 
-	std::u16string_view GetSuffix(const std::u16string_view text, const Index index, const size_t length) {
+	std::u16string_view GetSuffix(const std::u16string_view text, const size_t index, const size_t length) {
 		return text.substr(index, length);
 	}
+
+	template LcpTable::LcpTable(std::u16string_view text, Span<const Index> sa);
+	template LcpTable::LcpTable(std::u16string_view text, Span<const std::int64_t> sa);
+	template LcpTable::LcpTable(std::u16string_view text, Span<const Index40> sa);
+
+#define INSTANTIATE_SEARCH(IndexT)\
+	template class BasicPrefixTable<IndexT>;\
+	template class BasicSuffixArray<IndexT>;\
+	template class BasicUniqueSearchLookup<IndexT>;\
+	template class BasicSearch<IndexT>;\
+	template class BasicUniqueItemsIterator<IndexT>;\
+	template MemoryUsage EstimateMemoryUsage<IndexT>(size_t characters, size_t items, const BuildOptions &options)
+
+	INSTANTIATE_SEARCH(Index);
+	INSTANTIATE_SEARCH(std::int64_t);
+	INSTANTIATE_SEARCH(Index40);
 }
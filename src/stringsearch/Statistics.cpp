@@ -0,0 +1,125 @@
+#include "Statistics.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace stringsearch {
+	namespace {
+		[[nodiscard]] size_t FloorLog2(const std::uint64_t value) noexcept {
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanReverse64(&index, value);
+			return index;
+#else
+			return size_t(63 - __builtin_clzll(value));
+#endif
+		}
+
+		constexpr size_t SubBucketBits = 2;
+		constexpr size_t SubBuckets = size_t(1) << SubBucketBits;
+
+		std::uint64_t Load(std::atomic<std::uint64_t> &value, const bool reset) noexcept {
+			return reset ? value.exchange(0, std::memory_order_relaxed) : value.load(std::memory_order_relaxed);
+		}
+
+		std::atomic<size_t> NextShard{0};
+	}
+
+	size_t HistogramBucket(const std::uint64_t value) noexcept {
+		if(value < SubBuckets)
+			return size_t(value);
+
+		const auto log = FloorLog2(value);
+		const auto bucket = (log - SubBucketBits + 1) * SubBuckets + size_t(value >> (log - SubBucketBits)) % SubBuckets;
+		return std::min(bucket, api::HistogramBuckets - 1);
+	}
+
+	std::uint64_t HistogramBucketLowerBound(const size_t bucket) noexcept {
+		if(bucket < SubBuckets)
+			return bucket;
+
+		const auto log = bucket / SubBuckets + SubBucketBits - 1;
+		return std::uint64_t(SubBuckets + bucket % SubBuckets) << (log - SubBucketBits);
+	}
+
+	std::uint64_t HistogramPercentile(const api::Histogram &histogram, const double percentile) noexcept {
+		if(histogram.Count == 0)
+			return 0;
+
+		// Rank of the value, 1 for the minimum
+		const auto rank = std::max<std::uint64_t>(1, std::uint64_t(std::ceil(std::clamp(percentile, 0.0, 100.0) / 100 * double(histogram.Count))));
+		std::uint64_t counted = 0;
+		for(size_t bucket = 0; bucket + 1 < api::HistogramBuckets; ++bucket) {
+			counted += histogram.Buckets[bucket];
+			if(counted >= rank)
+				return std::min(HistogramBucketLowerBound(bucket + 1) - 1, histogram.Max);
+		}
+		return histogram.Max;
+	}
+
+	void AtomicHistogram::record(const std::uint64_t value) noexcept {
+		count_.fetch_add(1, std::memory_order_relaxed);
+		sum_.fetch_add(value, std::memory_order_relaxed);
+		auto max = max_.load(std::memory_order_relaxed);
+		while(value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {}
+		buckets_[HistogramBucket(value)].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void AtomicHistogram::snapshot(api::Histogram &histogram, const bool reset) noexcept {
+		histogram = api::Histogram{};
+		addTo(histogram, reset);
+	}
+
+	void AtomicHistogram::addTo(api::Histogram &histogram, const bool reset) noexcept {
+		histogram.Count += Load(count_, reset);
+		histogram.Sum += Load(sum_, reset);
+		histogram.Max = std::max(histogram.Max, Load(max_, reset));
+		for(size_t i = 0; i < buckets_.size(); ++i)
+			histogram.Buckets[i] += Load(buckets_[i], reset);
+	}
+
+	QueryStatistics::Shard &QueryStatistics::shard() noexcept {
+		thread_local const auto index = NextShard.fetch_add(1, std::memory_order_relaxed) % ShardCount;
+		return shards_[index];
+	}
+
+	void QueryStatistics::recordRangeSize(const size_t size) noexcept {
+		if(enabled())
+			shard().rangeSizes.record(size);
+	}
+
+	void QueryStatistics::record(const QueryMeasurement &measurement) noexcept {
+		if(!enabled())
+			return;
+
+		auto &shard = this->shard();
+		shard.queries.fetch_add(1, std::memory_order_relaxed);
+		if(measurement.Status != api::Result::Ok)
+			shard.failures.fetch_add(1, std::memory_order_relaxed);
+		shard.itemsEmitted.fetch_add(measurement.ItemsEmitted, std::memory_order_relaxed);
+		for(size_t i = 0; i < QueryPhaseCount; ++i) {
+			if(measurement.Phases & (1u << i))
+				shard.phases[i].record(measurement.Nanoseconds[i]);
+		}
+		shard.total.record(measurement.TotalNanoseconds);
+	}
+
+	void QueryStatistics::snapshot(api::InstanceStatistics &statistics, const bool reset) noexcept {
+		statistics = api::InstanceStatistics{};
+		for(auto &shard : shards_) {
+			statistics.Queries += Load(shard.queries, reset);
+			statistics.Failures += Load(shard.failures, reset);
+			statistics.ItemsEmitted += Load(shard.itemsEmitted, reset);
+			shard.rangeSizes.addTo(statistics.RangeSizes, reset);
+			shard.phases[size_t(QueryPhase::Parse)].addTo(statistics.Parse, reset);
+			shard.phases[size_t(QueryPhase::Find)].addTo(statistics.Find, reset);
+			shard.phases[size_t(QueryPhase::Unique)].addTo(statistics.Unique, reset);
+			shard.phases[size_t(QueryPhase::Copy)].addTo(statistics.Copy, reset);
+			shard.total.addTo(statistics.Total, reset);
+		}
+	}
+}
\ No newline at end of file
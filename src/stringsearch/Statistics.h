@@ -0,0 +1,83 @@
+#pragma once
+#include "ApiDefinitions.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace stringsearch {
+	[[nodiscard]] size_t HistogramBucket(std::uint64_t value) noexcept;
+
+	// Smallest value counted in bucket
+	[[nodiscard]] std::uint64_t HistogramBucketLowerBound(size_t bucket) noexcept;
+
+	// Upper bound of the bucket of the value at percentile (0 to 100) of histogram, at most its maximum. 0 if it is empty.
+	[[nodiscard]] std::uint64_t HistogramPercentile(const api::Histogram &histogram, double percentile) noexcept;
+
+	// api::Histogram updated with relaxed atomics
+	class AtomicHistogram {
+		std::atomic<std::uint64_t> count_{0};
+		std::atomic<std::uint64_t> sum_{0};
+		std::atomic<std::uint64_t> max_{0};
+		std::array<std::atomic<std::uint64_t>, api::HistogramBuckets> buckets_{};
+
+	public:
+		void record(std::uint64_t value) noexcept;
+
+		// Values recorded concurrently may be missing from the buckets but already counted, or the other way around
+		void snapshot(api::Histogram &histogram, bool reset) noexcept;
+
+		// Adds the values to histogram like snapshot
+		void addTo(api::Histogram &histogram, bool reset) noexcept;
+	};
+
+	enum class QueryPhase {
+		Parse,
+		Find,
+		Unique,
+		Copy
+	};
+
+	constexpr size_t QueryPhaseCount = 4;
+
+	// Measurements of one query, only the phases in Phases were run
+	struct QueryMeasurement {
+		std::array<std::uint64_t, QueryPhaseCount> Nanoseconds{};
+		unsigned int Phases = 0;
+		std::uint64_t TotalNanoseconds = 0;
+		api::Result Status = api::Result::Ok;
+		size_t ItemsEmitted = 0;
+	};
+
+	// Statistics of the queries of an instance. Disabled ones ignore everything recorded. Every thread records into one
+	// of a few shards, which the threads take in turn, so concurrent queries don't write to the same cache lines.
+	class QueryStatistics {
+		struct alignas(64) Shard {
+			std::atomic<std::uint64_t> queries{0};
+			std::atomic<std::uint64_t> failures{0};
+			std::atomic<std::uint64_t> itemsEmitted{0};
+			AtomicHistogram rangeSizes;
+			std::array<AtomicHistogram, QueryPhaseCount> phases;
+			AtomicHistogram total;
+		};
+
+		static constexpr size_t ShardCount = 8;
+
+		// Read by every query, on a cache line of its own
+		alignas(64) std::atomic<bool> enabled_{false};
+		std::array<Shard, ShardCount> shards_;
+
+		[[nodiscard]] Shard &shard() noexcept;
+
+	public:
+		[[nodiscard]] bool enabled() const noexcept { return enabled_.load(std::memory_order_relaxed); }
+
+		void enable(const bool enabled) noexcept { enabled_.store(enabled, std::memory_order_relaxed); }
+
+		void recordRangeSize(size_t size) noexcept;
+
+		void record(const QueryMeasurement &measurement) noexcept;
+
+		void snapshot(api::InstanceStatistics &statistics, bool reset) noexcept;
+	};
+}
\ No newline at end of file
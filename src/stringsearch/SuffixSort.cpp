@@ -1,11 +1,23 @@
 #include "stringsearch/SuffixSort.hpp"
+#include "stringsearch/Compare.hpp"
 #include <algorithm>
 #include <numeric>
 #include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <optional>
 #include <vector>
 #include "stringsearch/Utf16Le.hpp"
 #include <cassert>
 #include <utility>
+#include "ThreadPool.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
 
 namespace stringsearch {
 	using TextIterator = Utf16LETextIterator;
@@ -28,7 +40,7 @@ namespace stringsearch {
 		return it.advanceDouble(distance);
 	}
 	
-	size_t ToBucketIndex(const TextIterator text, const TextIterator end, const Index suffix) {
+	size_t ToBucketIndex(const TextIterator text, const TextIterator end, const std::int64_t suffix) {
 		const auto it = AdvanceDouble(text, suffix);
 		RangeCheck(it, end);
 		const auto res = static_cast<size_t>(*it);
@@ -36,204 +48,1172 @@ namespace stringsearch {
 		return res;
 	}
 
-	void Count(const TextIterator text, const TextIterator end, const Span<const Index> sa, const Span<Index> buckets) {
-		for(const auto suffix : sa) {
-			const auto bucket = ToBucketIndex(text, end, suffix);
-			buckets[bucket]++;
+	// Taken from MSVCs implementation of std::exclusive_scan
+	template<typename InIt, typename OutIt, typename Ty, typename BinOp = std::plus<>>
+	OutIt ExclusiveScan(InIt first, const InIt last, OutIt dest, Ty val, BinOp reduceOp = BinOp()) {
+		RangeCheck(first, last);
+		if(first != last) {
+			for(;;) {
+				Ty tmp(reduceOp(val, *first));
+				*dest = val;
+				++dest;
+				++first;
+				if(first == last) {
+					break;
+				}
+
+				val = std::move(tmp);
+			}
 		}
+
+		return dest;
 	}
 
-	void MoveElements(const TextIterator text, const TextIterator end, const Span<Index> bucketStarts, const Span<Index> buffer,
-							const Span<Index> sa) {
-		for(const auto suffix : sa) {
-			const auto bucket = ToBucketIndex(text, end, suffix);
-			const auto off = bucketStarts[bucket]++;
-			buffer[off] = suffix;
-		}
+	void Prefetch(const void *address) noexcept {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+		_mm_prefetch(static_cast<const char *>(address), _MM_HINT_T0);
+#elif defined(__GNUC__)
+		__builtin_prefetch(address);
+#endif
+	}
 
-		std::copy(buffer.begin(), buffer.end(), sa.begin());
+	TextIterator ToTextIterator(const char16_t *characters) {
+		return Utf16LETextIterator(characters);
 	}
 
-	void MoveElementsInPlace(const TextIterator text, const TextIterator end, const Span<Index> bucketStarts, const Span<Index> sa) {
-		for(auto it = sa.begin(); it != sa.end();) {
-			const auto suffix = *it;
-			const auto bucket = ToBucketIndex(text, end, suffix);
-			const auto off = bucketStarts[bucket];
+	// The sorts for one index type, the public functions forward to SuffixSorter<Index> and SuffixSorter<std::int64_t>
+	template<typename IndexT>
+	struct SuffixSorter {
+		using Index = IndexT;
 
-			// Swap only with elements in front of the current element
-			if(off > it - sa.begin()) {
-				++it;
-				continue;
+		static void Count(const TextIterator text, const TextIterator end, const Span<const Index> sa, const Span<Index> buckets) {
+			for(const auto suffix : sa) {
+				const auto bucket = ToBucketIndex(text, end, suffix);
+				buckets[bucket]++;
 			}
+		}
 
-			if(off == it - sa.begin()) {
-				++it;
-			} else {
-				std::iter_swap(sa.begin() + off, it);
+		static void MoveElements(const TextIterator text, const TextIterator end, const Span<Index> bucketStarts, const Span<Index> buffer,
+								const Span<Index> sa) {
+			for(const auto suffix : sa) {
+				const auto bucket = ToBucketIndex(text, end, suffix);
+				const auto off = bucketStarts[bucket]++;
+				buffer[off] = suffix;
 			}
 
-			bucketStarts[bucket]++;
+			std::copy(buffer.begin(), buffer.end(), sa.begin());
 		}
-	}
 
-	void SuffixSortStd(const char16_t *text, const char16_t *end, const Span<Index> sa) {
-		std::sort(sa.begin(), sa.end(), [&](const Index a, const Index b) {
-			return std::lexicographical_compare(
-				text + a, end, 
-				text + b, end
-			);
-		});
-	}
+		static void MoveElementsInPlace(const TextIterator text, const TextIterator end, const Span<Index> bucketStarts, const Span<Index> sa) {
+			for(auto it = sa.begin(); it != sa.end();) {
+				const auto suffix = *it;
+				const auto bucket = ToBucketIndex(text, end, suffix);
+				const auto off = bucketStarts[bucket];
 
-	template<typename F>
-	void DispatchBuckets(const TextIterator text, const std::array<Index, 0x100> &buckets, const Span<Index> sa, F &&f) {
-		auto last = 0;
+				// Swap only with elements in front of the current element
+				if(off > it - sa.begin()) {
+					++it;
+					continue;
+				}
 
-		for(auto v : buckets) {
-			if(v == last)
-				continue;
-			if(v - last > 1)
-				f(text, sa.subspan(last, size_t(v) - size_t(last)));
+				if(off == it - sa.begin()) {
+					++it;
+				} else {
+					std::iter_swap(sa.begin() + off, it);
+				}
 
-			last = v;
+				bucketStarts[bucket]++;
+			}
 		}
-	}
 
-	struct SharedBuffer {
-		const Span<Index> Buffer;
+		// Bounds the sorts on repetitive text, where big buckets stay together for many levels, the recursion gets as
+		// deep as the longest repeat and comparing two suffixes reads the whole repeat. Levels below FreeLevels are always
+		// sorted by radix, they cost at most FreeLevels passes over sa. Deeper levels are paid from a budget shared by all
+		// buckets. A bucket deeper than DepthLimit or one that finds the budget spent, or two suffixes that are still equal
+		// after CompareLimit code units, give the radix sort up: the remaining buckets are left unsorted, and finish sorts
+		// the whole array by SA-IS after the sort freed its buffers. The fallback costs the time and memory of
+		// SuffixSortAlgorithm::InducedSorting on top of the radix work spent so far, which the budget bounds.
+		class RadixGuard {
+			std::u16string_view characters_;
+			std::atomic<std::int64_t> budget_;
+			std::atomic<bool> abandoned_{false};
+
+		public:
+			static constexpr size_t FreeLevels = 16;
+			static constexpr size_t DepthLimit = 512;
+			// Levels per suffix behind FreeLevels, catalogs need less than 8 even without small bucket sort
+			static constexpr std::int64_t WorkPerSuffix = 16;
+			static constexpr size_t CompareLimit = 1024;
+
+			explicit RadixGuard(const std::u16string_view characters) noexcept
+				: characters_(characters),
+					budget_(std::int64_t(characters.size()) * WorkPerSuffix + (1 << 20)) {}
+
+			DISABLE_COPY(RadixGuard);
+			DISABLE_MOVE(RadixGuard);
+
+			// Pays a radix pass over size suffixes at level, true if the sort has to be given up
+			[[nodiscard]] bool exceeded(const size_t level, const size_t size) noexcept {
+				if(abandoned())
+					return true;
+				if(level < FreeLevels)
+					return false;
+				if(level > DepthLimit)
+					return true;
+				return budget_.fetch_sub(std::int64_t(size), std::memory_order_relaxed) < std::int64_t(size);
+			}
+
+			[[nodiscard]] bool abandoned() const noexcept { return abandoned_.load(std::memory_order_relaxed); }
+
+			// Leaves the bucket unsorted, finish sorts everything
+			void abandon() noexcept { abandoned_.store(true, std::memory_order_relaxed); }
+
+			// Order of two suffixes equal for CompareLimit code units. Gives the sort up, the order by position keeps the
+			// comparison of the running std::sort a strict weak ordering.
+			[[nodiscard]] bool limitLess(const Index a, const Index b) noexcept {
+				abandon();
+				return a > b;
+			}
 
-		void moveElements(const TextIterator text, const TextIterator end, const Span<Index> bucketStarts, const Span<Index> sa) const {
-			MoveElements(text, end, bucketStarts, Buffer.subspan(0, sa.size()), sa);
+			// Sorts sa by SA-IS if the radix sort was given up
+			void finish(const Span<Index> sa) {
+				if(!abandoned())
+					return;
+
+				if(sa.size() == characters_.size()) {
+					SuffixSortInducedSorting(characters_, sa);
+					return;
+				}
+
+				// A sort of some of the suffixes picks them from the whole suffix array
+				std::vector<bool> contained(characters_.size());
+				for(const auto suffix : sa)
+					contained[size_t(suffix)] = true;
+				std::vector<Index> suffixes(characters_.size());
+				SuffixSortInducedSorting(characters_, suffixes);
+				std::copy_if(suffixes.begin(), suffixes.end(), sa.begin(), [&](const Index suffix) { return contained[size_t(suffix)]; });
+			}
+		};
+
+		// American flag sort permutation: every suffix is swapped directly to the next free place of its bucket. The bytes
+		// are read from the text into keys first, where the loads don't depend on each other, and are moved along with
+		// the suffixes, so the chains of swaps don't wait for the text. Needs a byte instead of an Index per suffix.
+		static void MoveElementsCycles(const TextIterator text, const TextIterator end, const Span<Index> bucketStarts, const Span<std::uint8_t> keys,
+										const Span<Index> sa) {
+			for(size_t i = 0; i < sa.size(); ++i)
+				keys[i] = std::uint8_t(ToBucketIndex(text, end, sa[i]));
+
+			std::array<Index, 0x100> bucketEnds;
+			std::copy(bucketStarts.begin() + 1, bucketStarts.end(), bucketEnds.begin());
+			bucketEnds.back() = Index(sa.size());
+
+			for(size_t bucket = 0; bucket < bucketEnds.size(); ++bucket) {
+				while(bucketStarts[bucket] < bucketEnds[bucket]) {
+					const auto start = size_t(bucketStarts[bucket]++);
+					auto suffix = sa[start];
+					auto key = keys[start];
+					while(key != bucket) {
+						const auto to = size_t(bucketStarts[key]++);
+						std::swap(suffix, sa[to]);
+						std::swap(key, keys[to]);
+					}
+					sa[start] = suffix;
+				}
+			}
 		}
-	};
 
-	struct OwnBuffer {
-		void moveElements(const TextIterator text, const TextIterator end, const Span<Index> bucketStarts, const Span<Index> sa) const {
+		// Compares the suffixes from depth on, the code units before have to be equal
+		[[nodiscard]] static bool SuffixLess(const char16_t *text, const size_t n, const size_t depth, const Index a, const Index b) noexcept {
+			// The suffix starting later is shorter, it is smaller if it is a prefix of the other one
+			const auto start = size_t(std::max(a, b)) + depth;
+			if(start >= n)
+				return a > b;
+
+			const auto count = n - start;
+			const auto length = MismatchLength(text + a + depth, text + b + depth, count);
+			return length == count ? a > b : text[size_t(a) + depth + length] < text[size_t(b) + depth + length];
+		}
+
+		// Suffixes that are equal for more than CompareLimit code units are ordered by their rank
+		[[nodiscard]] static bool SuffixLess(const char16_t *text, const size_t n, const size_t depth, const Index a, const Index b, RadixGuard &guard) {
+			const auto start = size_t(std::max(a, b)) + depth;
+			if(start >= n)
+				return a > b;
+
+			const auto count = std::min(n - start, RadixGuard::CompareLimit);
+			const auto length = MismatchLength(text + a + depth, text + b + depth, count);
+			if(length < count)
+				return text[size_t(a) + depth + length] < text[size_t(b) + depth + length];
+			return count == n - start ? a > b : guard.limitLess(a, b);
+		}
+
+		static void SuffixSortStd(const char16_t *text, const char16_t *end, const Span<Index> sa) {
+			const auto n = size_t(end - text);
+			std::sort(sa.begin(), sa.end(), [&](const Index a, const Index b) {
+				return SuffixLess(text, n, 0, a, b);
+			});
+		}
+
+		// Code unit of the suffix at depth, -1 behind the end
+		[[nodiscard]] static std::int32_t CodeUnitAt(const char16_t *text, const size_t n, const Index suffix, const size_t depth) noexcept {
+			const auto position = size_t(suffix) + depth;
+			return position < n ? std::int32_t(text[position]) : -1;
+		}
+
+		static constexpr size_t MultikeyInsertionMax = 8;
+
+		// Multikey quicksort (Bentley, Sedgewick: Fast Algorithms for Sorting and Searching Strings). Partitions by the code
+		// unit at depth into smaller, equal and bigger ones and goes on with the next code unit only for the equal ones, so
+		// the known common prefix is never compared again.
+		static void SuffixSortMultikey(const char16_t *text, const size_t n, Span<Index> sa, size_t depth, RadixGuard &guard) {
+			const auto limit = depth + RadixGuard::CompareLimit;
+			while(sa.size() > MultikeyInsertionMax) {
+				if(depth == limit) {
+					guard.abandon();
+					return;
+				}
+
+				const auto a = CodeUnitAt(text, n, sa[0], depth);
+				const auto b = CodeUnitAt(text, n, sa[sa.size() / 2], depth);
+				const auto c = CodeUnitAt(text, n, sa[sa.size() - 1], depth);
+				const auto pivot = std::max(std::min(a, b), std::min(std::max(a, b), c));
+
+				size_t less = 0;
+				size_t i = 0;
+				size_t greater = sa.size();
+				while(i < greater) {
+					const auto unit = CodeUnitAt(text, n, sa[i], depth);
+					if(unit < pivot)
+						std::swap(sa[less++], sa[i++]);
+					else if(unit > pivot)
+						std::swap(sa[i], sa[--greater]);
+					else
+						++i;
+				}
+
+				SuffixSortMultikey(text, n, sa.subspan(0, less), depth, guard);
+				SuffixSortMultikey(text, n, sa.subspan(greater), depth, guard);
+				// Only one suffix ends at depth
+				if(pivot == -1)
+					return;
+
+				sa = sa.subspan(less, greater - less);
+				++depth;
+			}
+
+			for(size_t i = 1; i < sa.size(); ++i) {
+				const auto suffix = sa[i];
+				auto j = i;
+				for(; j > 0 && SuffixLess(text, n, depth, suffix, sa[j - 1], guard); --j)
+					sa[j] = sa[j - 1];
+				sa[j] = suffix;
+			}
+		}
+
+		static void SuffixSortSmallBucket(const char16_t *text, const char16_t *end, const Span<Index> sa, const SmallBucketSort small,
+											RadixGuard &guard) {
+			const auto n = size_t(end - text);
+			if(small == SmallBucketSort::Multikey) {
+				SuffixSortMultikey(text, n, sa, 0, guard);
+				return;
+			}
+
+			std::sort(sa.begin(), sa.end(), [&](const Index a, const Index b) {
+				return SuffixLess(text, n, 0, a, b, guard);
+			});
+		}
+
+		template<typename F>
+		static void DispatchBuckets(const TextIterator text, const std::array<Index, 0x100> &buckets, const Span<Index> sa, F &&f) {
+			auto last = 0;
+
+			for(auto v : buckets) {
+				if(v == last)
+					continue;
+				if(v - last > 1)
+					f(text, sa.subspan(last, size_t(v) - size_t(last)));
+
+				last = v;
+			}
+		}
+
+		struct SharedBuffer {
+			const Span<Index> Buffer;
+
+			void moveElements(const TextIterator text, const TextIterator end, const Span<Index> bucketStarts, const Span<Index> sa) const {
+				MoveElements(text, end, bucketStarts, Buffer.subspan(0, sa.size()), sa);
+			}
+		};
+
+		struct OwnBuffer {
+			void moveElements(const TextIterator text, const TextIterator end, const Span<Index> bucketStarts, const Span<Index> sa) const {
+				std::vector<Index> buffer(sa.size());
+				MoveElements(text, end, bucketStarts, buffer, sa);
+			}
+		};
+
+		struct InPlace {
+			void moveElements(const TextIterator text, const TextIterator end, const Span<Index> bucketStarts, const Span<Index> sa) const {
+				MoveElementsInPlace(text, end, bucketStarts, sa);
+			}
+		};
+
+		// Buckets above this share of sa are moved in place by PooledBuffer
+		static constexpr size_t PooledBufferShare = 16;
+
+		// Scratch buffers of the PooledBuffer policy. Only one bucket is scattered at a time, so one buffer serves all of
+		// them. It grows by powers of two up to the biggest bucket that used it but never above max. The bytes for the
+		// buckets above max grow the same way.
+		class BufferPool {
+			std::vector<Index> buffer_;
+			std::vector<std::uint8_t> keys_;
+			const size_t max_;
+
+			template<typename T>
+			[[nodiscard]] static Span<T> Grow(std::vector<T> &buffer, const size_t size, const size_t max) {
+				if(buffer.size() < size) {
+					auto capacity = std::max<size_t>(buffer.size(), 0x100);
+					while(capacity < size)
+						capacity *= 2;
+					// The old elements are not needed, clearing first saves copying them
+					buffer.clear();
+					buffer.resize(std::min(capacity, max));
+				}
+				return Span<T>(buffer).subspan(0, size);
+			}
+
+		public:
+			explicit BufferPool(const size_t max) noexcept
+				: max_(max) {}
+
+			DISABLE_COPY(BufferPool);
+			DISABLE_MOVE(BufferPool);
+
+			[[nodiscard]] size_t max() const noexcept { return max_; }
+
+			// size must not exceed max
+			[[nodiscard]] Span<Index> buffer(const size_t size) { return Grow(buffer_, size, max_); }
+
+			[[nodiscard]] Span<std::uint8_t> keys(const size_t size) { return Grow(keys_, size, std::numeric_limits<size_t>::max()); }
+		};
+
+		// Like OwnBuffer without allocating at every node, and like SharedBuffer with a buffer of a fraction of the size.
+		// The few buckets too big for the buffer are permuted in place.
+		struct PooledBuffer {
+			BufferPool &Pool;
+
+			void moveElements(const TextIterator text, const TextIterator end, const Span<Index> bucketStarts, const Span<Index> sa) const {
+				if(sa.size() > Pool.max())
+					MoveElementsCycles(text, end, bucketStarts, Pool.keys(sa.size()), sa);
+				else
+					MoveElements(text, end, bucketStarts, Pool.buffer(sa.size()), sa);
+			}
+		};
+
+		// Moves the suffix that has no code unit left at text to the front and returns the others. It is a prefix of all
+		// of them, and only one suffix of a bucket can end at the same depth. text has to be at a code unit boundary.
+		[[nodiscard]] static Span<Index> SkipEnded(const TextIterator text, const TextIterator textEnd, const Span<Index> sa) {
+			const auto remaining = (textEnd.get() - text.get()) / 2;
+			const auto ended = std::find_if(sa.begin(), sa.end(), [&](const Index suffix) { return std::int64_t(suffix) >= remaining; });
+			if(ended == sa.end())
+				return sa;
+
+			std::iter_swap(sa.begin(), ended);
+			return sa.subspan(1);
+		}
+
+		// Goes to the next level as long as all suffixes are in one bucket. Returns false if sa is sorted already.
+		static bool SuffixSortMaxLevel(TextIterator &text, const TextIterator textEnd, Span<Index> &sa, size_t &depth, const size_t max,
+										const SmallBucketSort small, RadixGuard &guard, std::array<Index, 0x100> &buckets) {
+			while(true) {
+				RangeCheck(text, textEnd);
+				if(text.isOddAddress()) {
+					if(sa.size() < max) {
+						// We assume textEnd is always at an odd address by construction...
+						SuffixSortSmallBucket(reinterpret_cast<const char16_t *>(text.get() - 1), reinterpret_cast<const char16_t *>(textEnd.get() - 1), sa, small,
+												guard);
+						return false;
+					}
+
+					sa = SkipEnded(text, textEnd, sa);
+					if(sa.size() < 2)
+						return false;
+				}
+
+				if(guard.exceeded(depth, sa.size())) {
+					guard.abandon();
+					return false;
+				}
+
+				buckets.fill(0);
+				Count(text, textEnd, sa, buckets);
+				if(size_t(buckets[ToBucketIndex(text, textEnd, sa[0])]) != sa.size())
+					return true;
+				++text;
+				++depth;
+			}
+		}
+
+		// depth is the number of bytes all suffixes of sa have in common
+		template<typename Derived>
+		static void SuffixSortMax(TextIterator text, const TextIterator textEnd, Span<Index> sa, size_t depth, const size_t max, const SmallBucketSort small,
+									RadixGuard &guard, Derived derived) {
+			std::array<Index, 0x100> buckets;
+			if(!SuffixSortMaxLevel(text, textEnd, sa, depth, max, small, guard, buckets))
+				return;
+
+			const auto nextText = text++;
+			ExclusiveScan(buckets.begin(), buckets.end(), buckets.begin(), Index(0));
+			derived.moveElements(text, textEnd, buckets, sa);
+
+			DispatchBuckets(nextText, buckets, sa, [&](const auto newText, const auto range) {
+				SuffixSortMax<Derived>(newText, textEnd, range, depth + 1, max, small, guard, derived);
+			});
+		}
+
+		template<typename Derived>
+		static void SuffixSortMax(const std::u16string_view characters, const Span<Index> sa, const size_t max, const SmallBucketSort small, Derived derived) {
+			RadixGuard guard(characters);
+			SuffixSortMax(ToTextIterator(BeginPtr(characters)), ToTextIterator(EndPtr(characters)), sa, 0, max, small, guard, derived);
+			guard.finish(sa);
+		}
+
+		// Without a small bucket sort every bucket is sorted by radix down to single suffixes
+		template<typename Derived>
+		static void SuffixSort(const std::u16string_view characters, const Span<Index> sa, Derived derived) {
+			SuffixSortMax(characters, sa, 0, SmallBucketSort::Comparison, derived);
+		}
+
+		static void SuffixSortStd(const std::u16string_view characters, const Span<Index> sa) {
+			SuffixSortStd(BeginPtr(characters), EndPtr(characters), sa);
+		}
+
+		static void SuffixSortSharedBuffer(const std::u16string_view characters, const Span<Index> sa) {
 			std::vector<Index> buffer(sa.size());
-			MoveElements(text, end, bucketStarts, buffer, sa);
+			SuffixSort(characters, sa, SharedBuffer{buffer});
 		}
-	};
 
-	struct InPlace {
-		void moveElements(const TextIterator text, const TextIterator end, const Span<Index> bucketStarts, const Span<Index> sa) const {
-			MoveElementsInPlace(text, end, bucketStarts, sa);
+		static void SuffixSortOwnBuffer(const std::u16string_view characters, const Span<Index> sa) {
+			SuffixSort(characters, sa, OwnBuffer());
 		}
-	};
 
-	// Taken from MSVCs implementation of std::exclusive_scan
-	template<typename InIt, typename OutIt, typename Ty, typename BinOp = std::plus<>>
-	OutIt ExclusiveScan(InIt first, const InIt last, OutIt dest, Ty val, BinOp reduceOp = BinOp()) {
-		RangeCheck(first, last);
-		if(first != last) {
-			for(;;) {
-				Ty tmp(reduceOp(val, *first));
-				*dest = val;
-				++dest;
-				++first;
-				if(first == last) {
-					break;
+		static void SuffixSortInPlace(const std::u16string_view characters, const Span<Index> sa) {
+			SuffixSort(characters, sa, InPlace());
+		}
+
+		static void SuffixSortPooledBuffer(const std::u16string_view characters, const Span<Index> sa) {
+			BufferPool pool(sa.size() / PooledBufferShare);
+			SuffixSort(characters, sa, PooledBuffer{pool});
+		}
+
+		static void SuffixSortSharedBufferMax(const std::u16string_view characters, const Span<Index> sa, const size_t max, const SmallBucketSort small) {
+			std::vector<Index> buffer(sa.size());
+			SuffixSortMax(characters, sa, max, small, SharedBuffer{buffer});
+		}
+
+		static void SuffixSortOwnBufferMax(const std::u16string_view characters, const Span<Index> sa, const size_t max, const SmallBucketSort small) {
+			SuffixSortMax(characters, sa, max, small, OwnBuffer());
+		}
+
+		static void SuffixSortInPlaceMax(const std::u16string_view characters, const Span<Index> sa, const size_t max, const SmallBucketSort small) {
+			SuffixSortMax(characters, sa, max, small, InPlace());
+		}
+
+		static void SuffixSortPooledBufferMax(const std::u16string_view characters, const Span<Index> sa, const size_t max, const SmallBucketSort small) {
+			BufferPool pool(sa.size() / PooledBufferShare);
+			SuffixSortMax(characters, sa, max, small, PooledBuffer{pool});
+		}
+
+		// Settings of one parallel sort, shared by all its tasks
+		struct ParallelSort {
+			WorkStealingPool &Pool;
+			const TextIterator TextEnd;
+			const size_t Max;
+			const SmallBucketSort Small;
+			const size_t Grain;
+			RadixGuard &Guard;
+		};
+
+		// Sorts one bucket and hands the sub buckets to the pool. Buckets below grain are sorted sequentially by the task.
+		// buffer is the part of the shared buffer at the same offsets as sa, so concurrent tasks never overlap.
+		static void SuffixSortParallelBucket(const ParallelSort &sort, TextIterator text, Span<Index> sa, Span<Index> buffer, size_t depth) {
+			if(sa.size() <= sort.Grain) {
+				SuffixSortMax(text, sort.TextEnd, sa, depth, sort.Max, sort.Small, sort.Guard, SharedBuffer{buffer});
+				return;
+			}
+
+			std::array<Index, 0x100> buckets;
+			const auto size = sa.size();
+			if(!SuffixSortMaxLevel(text, sort.TextEnd, sa, depth, sort.Max, sort.Small, sort.Guard, buckets))
+				return;
+			buffer = buffer.subspan(size - sa.size());
+
+			const auto nextText = text++;
+			ExclusiveScan(buckets.begin(), buckets.end(), buckets.begin(), Index(0));
+			MoveElements(text, sort.TextEnd, buckets, buffer.subspan(0, sa.size()), sa);
+
+			DispatchBuckets(nextText, buckets, sa, [&](const auto newText, const auto range) {
+				const auto offset = size_t(range.data() - sa.data());
+				const auto rangeBuffer = buffer.subspan(offset, range.size());
+				sort.Pool.submit([&sort, newText, range, rangeBuffer, depth]() {
+					SuffixSortParallelBucket(sort, newText, range, rangeBuffer, depth + 1);
+				});
+			});
+		}
+
+		// First level of the parallel sort: every thread counts and scatters one chunk of sa. No suffix ends at the first
+		// level, if all of them are in one bucket the levels below are left to SuffixSortParallelBucket.
+		static void SuffixSortParallel(const ParallelSort &sort, TextIterator text, const Span<Index> sa, const Span<Index> buffer) {
+			auto &pool = sort.Pool;
+			const auto textEnd = sort.TextEnd;
+			const auto chunkCount = pool.threadCount();
+			const auto chunkSize = (sa.size() + chunkCount - 1) / chunkCount;
+			const auto chunk = [&](const size_t i) {
+				const auto begin = std::min(i * chunkSize, sa.size());
+				return sa.subspan(begin, std::min(chunkSize, sa.size() - begin));
+			};
+
+			std::vector<std::array<Index, 0x100>> counts(chunkCount);
+			pool.parallelFor(chunkCount, [&](const size_t i) {
+				counts[i].fill(0);
+				Count(text, textEnd, chunk(i), counts[i]);
+			});
+
+			const auto first = ToBucketIndex(text, textEnd, sa[0]);
+			Index total = 0;
+			for(const auto &c : counts)
+				total += c[first];
+			if(size_t(total) == sa.size()) {
+				SuffixSortParallelBucket(sort, text, sa, buffer, 0);
+				pool.wait();
+				return;
+			}
+
+			// Bucket b of chunk i starts after bucket b of all previous chunks
+			std::array<Index, 0x100> buckets{};
+			Index offset = 0;
+			for(size_t b = 0; b < buckets.size(); ++b) {
+				for(auto &c : counts) {
+					const auto count = c[b];
+					c[b] = offset;
+					offset += count;
 				}
+				buckets[b] = offset;
+			}
 
-				val = std::move(tmp);
+			pool.parallelFor(chunkCount, [&](const size_t i) {
+				for(const auto suffix : chunk(i)) {
+					const auto bucket = ToBucketIndex(text, textEnd, suffix);
+					buffer[counts[i][bucket]++] = suffix;
+				}
+			});
+			pool.parallelFor(chunkCount, [&](const size_t i) {
+				const auto part = chunk(i);
+				const auto begin = buffer.begin() + (part.data() - sa.data());
+				std::copy(begin, begin + part.size(), part.begin());
+			});
+
+			const auto nextText = text++;
+			DispatchBuckets(nextText, buckets, sa, [&](const auto newText, const auto range) {
+				const auto rangeOffset = size_t(range.data() - sa.data());
+				const auto rangeBuffer = buffer.subspan(rangeOffset, range.size());
+				pool.submit([&sort, newText, range, rangeBuffer]() {
+					SuffixSortParallelBucket(sort, newText, range, rangeBuffer, 1);
+				});
+			});
+			pool.wait();
+		}
+
+		static void SuffixSortParallel(const std::u16string_view characters, const Span<Index> sa, const unsigned int threads, const size_t max,
+										const SmallBucketSort small) {
+			if(sa.empty())
+				return;
+
+			RadixGuard guard(characters);
+			{
+				WorkStealingPool pool(threads);
+				std::vector<Index> buffer(sa.size());
+				if(pool.threadCount() == 1) {
+					SuffixSortMax(ToTextIterator(BeginPtr(characters)), ToTextIterator(EndPtr(characters)), sa, 0, max, small, guard, SharedBuffer{buffer});
+				} else {
+					const auto grain = std::max<size_t>(sa.size() / (pool.threadCount() * 16), 1 << 14);
+					const ParallelSort sort{pool, ToTextIterator(EndPtr(characters)), max, small, grain, guard};
+					SuffixSortParallel(sort, ToTextIterator(BeginPtr(characters)), sa, buffer);
+				}
 			}
+			// Without the buffer and the threads
+			guard.finish(sa);
 		}
 
-		return dest;
-	}
+		// Radix sort that reads the text once per KeyUnits code units instead of twice per byte. The next code units of
+		// every suffix are gathered into a key next to sa, the counting and the scattering read only the keys. The keys are
+		// moved with their suffixes.
+		using CachedKey = std::uint64_t;
+		static constexpr size_t KeyUnits = sizeof(CachedKey) / sizeof(char16_t);
+		static constexpr size_t GatherPrefetchDistance = 16;
 
-	template<typename Derived>
-	void SuffixSort(const TextIterator text, const TextIterator textEnd, const Span<Index> sa, Derived derived) {
-		RangeCheck(text, textEnd);
-		std::array<Index, 0x100> buckets{};
-		Count(text, textEnd, sa, buckets);
+		[[nodiscard]] static size_t KeyByte(const CachedKey key, const size_t byte) noexcept {
+			return size_t(key >> (8 * (sizeof(CachedKey) - 1 - byte))) & 0xFF;
+		}
 
-		const auto allInOne = size_t(buckets[ToBucketIndex(text, textEnd, sa[0])]) == sa.size();
-		const auto nextText = text++;
+		// Fills keys with the code units from position on, high byte first like Utf16LETextIterator. Code units behind the
+		// end are 0, so the suffixes that ended before position are moved to the front, shortest first: they are prefixes
+		// of the other suffixes of the bucket and of each other. Returns their count.
+		static size_t GatherKeys(const std::u16string_view characters, const size_t position, const Span<Index> sa, const Span<CachedKey> keys) {
+			const auto n = characters.size();
+			size_t ended = 0;
+			for(size_t i = 0; i < sa.size(); ++i) {
+				if(i + GatherPrefetchDistance < sa.size())
+					Prefetch(characters.data() + std::min(n, size_t(sa[i + GatherPrefetchDistance]) + position));
 
-		if(allInOne) {
-			SuffixSort(nextText, textEnd, sa, derived);
-			return;
+				const auto start = size_t(sa[i]) + position;
+				if(start >= n) {
+					std::swap(sa[i], sa[ended]);
+					std::swap(keys[i], keys[ended]);
+					++ended;
+					continue;
+				}
+
+				CachedKey key = 0;
+				for(size_t j = 0; j < KeyUnits; ++j)
+					key = (key << 16) | (start + j < n ? CachedKey(characters[start + j]) : 0);
+				keys[i] = key;
+			}
+
+			std::sort(sa.begin(), sa.begin() + ended, std::greater<>());
+			return ended;
 		}
 
-		ExclusiveScan(buckets.begin(), buckets.end(), buckets.begin(), Index(0));
-		derived.moveElements(text, textEnd, buckets, sa);
+		// Small buckets are sorted by the keys, the text is only read if they are equal
+		static void SortByKeys(const std::u16string_view characters, const size_t position, const Span<Index> sa, const Span<const CachedKey> keys,
+								std::vector<std::pair<CachedKey, Index>> &scratch, RadixGuard &guard) {
+			scratch.clear();
+			for(size_t i = 0; i < sa.size(); ++i)
+				scratch.emplace_back(keys[i], sa[i]);
 
-		DispatchBuckets(nextText, buckets, sa, [&](const auto newText, const auto range) {
-			SuffixSort(newText, textEnd, range, derived);
-		});
-	}
+			const auto from = position + KeyUnits;
+			const auto text = BeginPtr(characters);
+			std::sort(scratch.begin(), scratch.end(), [&](const auto &a, const auto &b) {
+				if(a.first != b.first)
+					return a.first < b.first;
 
-	TextIterator ToTextIterator(const char16_t *characters) {
-		return Utf16LETextIterator(characters);
-	}
+				// The suffix starting later is shorter, it is smaller if it ends in the key or is a prefix of the other one
+				const auto start = size_t(std::max(a.second, b.second)) + from;
+				if(start >= characters.size())
+					return a.second > b.second;
 
-	template<typename Derived>
-	void SuffixSort(const std::u16string_view characters, const Span<Index> sa, Derived derived) {
-		SuffixSort(ToTextIterator(BeginPtr(characters)), ToTextIterator(EndPtr(characters)), sa, derived);
-	}
-	
-	template<typename Derived>
-	void SuffixSortMax(const TextIterator text, const TextIterator textEnd, const Span<Index> sa, const size_t max, Derived derived) {
-		RangeCheck(text, textEnd);
-		if(sa.size() < max && text.isOddAddress()) {
-			// We assume textEnd is always at an odd address by construction...
-			SuffixSortStd(reinterpret_cast<const char16_t *>(text.get() - 1), reinterpret_cast<const char16_t *>(textEnd.get() - 1), sa);
-			return;
+				const auto count = std::min(characters.size() - start, RadixGuard::CompareLimit);
+				const auto length = MismatchLength(text + a.second + from, text + b.second + from, count);
+				if(length < count)
+					return text[a.second + from + length] < text[b.second + from + length];
+				return count == characters.size() - start ? a.second > b.second : guard.limitLess(a.second, b.second);
+			});
+
+			for(size_t i = 0; i < sa.size(); ++i)
+				sa[i] = scratch[i].second;
 		}
-		
-		std::array<Index, 0x100> buckets{};
 
-		Count(text, textEnd, sa, buckets);
+		// The first position code units and byte bytes of the keys of all suffixes in sa are equal. Every level scatters
+		// from sa to buffer and hands the buckets down with the roles swapped instead of copying back, the suffixes end up
+		// sorted in sa if sortedInSa and in buffer otherwise.
+		static void SuffixSortCachedKeys(const std::u16string_view characters, size_t position, size_t byte, Span<Index> sa, Span<CachedKey> keys,
+										Span<Index> buffer, Span<CachedKey> keyBuffer, const bool sortedInSa, const size_t max,
+										std::vector<std::pair<CachedKey, Index>> &scratch, RadixGuard &guard) {
+			const auto finish = [&](const size_t count) {
+				if(!sortedInSa)
+					std::copy(sa.begin(), sa.begin() + count, buffer.begin());
+			};
 
-		const auto allInOne = size_t(buckets[ToBucketIndex(text, textEnd, sa[0])]) == sa.size();
+			std::array<Index, 0x100> buckets{};
+			while(true) {
+				if(sa.size() < std::max<size_t>(max, 2)) {
+					if(sa.size() > 1)
+						SortByKeys(characters, position, sa, keys, scratch, guard);
+					finish(sa.size());
+					return;
+				}
 
-		const auto nextText = text++;
+				if(byte == sizeof(CachedKey)) {
+					position += KeyUnits;
+					byte = 0;
+					const auto ended = GatherKeys(characters, position, sa, keys);
+					finish(ended);
+					sa = sa.subspan(ended);
+					keys = keys.subspan(ended);
+					buffer = buffer.subspan(ended);
+					keyBuffer = keyBuffer.subspan(ended);
+					continue;
+				}
 
-		if(allInOne) {
-			SuffixSortMax<Derived>(nextText, textEnd, sa, max, derived);
-			return;
+				if(guard.exceeded(2 * position + byte, sa.size())) {
+					guard.abandon();
+					finish(sa.size());
+					return;
+				}
+
+				buckets.fill(0);
+				for(const auto key : keys)
+					++buckets[KeyByte(key, byte)];
+				if(size_t(buckets[KeyByte(keys[0], byte)]) != sa.size())
+					break;
+				++byte;
+			}
+
+			ExclusiveScan(buckets.begin(), buckets.end(), buckets.begin(), Index(0));
+			for(size_t i = 0; i < sa.size(); ++i) {
+				const auto off = size_t(buckets[KeyByte(keys[i], byte)]++);
+				buffer[off] = sa[i];
+				keyBuffer[off] = keys[i];
+			}
+
+			// Every bucket start was moved to the end of the bucket
+			Index last = 0;
+			for(const auto bucketEnd : buckets) {
+				const auto offset = size_t(last);
+				const auto size = size_t(bucketEnd - last);
+				if(size > 1) {
+					SuffixSortCachedKeys(characters, position, byte + 1, buffer.subspan(offset, size), keyBuffer.subspan(offset, size), sa.subspan(offset, size),
+										keys.subspan(offset, size), !sortedInSa, max, scratch, guard);
+				} else if(size == 1 && sortedInSa) {
+					sa[offset] = buffer[offset];
+				}
+				last = bucketEnd;
+			}
 		}
 
-		ExclusiveScan(buckets.begin(), buckets.end(), buckets.begin(), Index(0));
-		derived.moveElements(text, textEnd, buckets, sa);
+		static void SuffixSortCachedKeys(const std::u16string_view characters, const Span<Index> sa, const size_t max) {
+			RadixGuard guard(characters);
+			{
+				std::vector<CachedKey> keys(sa.size());
+				std::vector<CachedKey> keyBuffer(sa.size());
+				std::vector<Index> buffer(sa.size());
+				std::vector<std::pair<CachedKey, Index>> scratch;
+				scratch.reserve(max);
+				const auto ended = GatherKeys(characters, 0, sa, keys);
+				SuffixSortCachedKeys(characters, 0, 0, sa.subspan(ended), Span<CachedKey>(keys).subspan(ended), Span<Index>(buffer).subspan(ended),
+									Span<CachedKey>(keyBuffer).subspan(ended), true, max, scratch, guard);
+			}
+			// Without the keys and the buffers
+			guard.finish(sa);
+		}
 
-		DispatchBuckets(nextText, buckets, sa, [&](const auto newText, const auto range) {
-			SuffixSortMax<Derived>(newText, textEnd, range, max, derived);
-		});
-	}
+		// Characters coded as bytes in their order, 0 is the end of the text. Small alphabets pack PerKey characters into
+		// the byte a radix pass sorts by. If more than 255 different characters are used, the rare ones share a first byte
+		// per run of neighbouring characters and are told apart by a second one. The code is prefix free and keeps the
+		// order, so comparing the coded suffixes byte by byte gives the order of the suffixes.
+		struct DenseAlphabet {
+			// PerKey zeros behind the text, so keys near the end don't need a check
+			std::vector<std::uint8_t> Text;
+			// Position of every character in Text, empty if all characters have one byte
+			std::vector<Index> Offsets;
+			unsigned int Bits = 0;
+			size_t PerKey = 0;
+			// Keys are smaller, the radix passes only look at this many buckets
+			size_t KeyCount = 0;
+
+			[[nodiscard]] size_t position(const Index suffix) const noexcept {
+				return Offsets.empty() ? size_t(suffix) : size_t(Offsets[size_t(suffix)]);
+			}
+
+			[[nodiscard]] size_t key(const size_t position) const noexcept {
+				if(PerKey == 1)
+					return Text[position];
+
+				size_t res = 0;
+				for(size_t i = 0; i < PerKey; ++i)
+					res = (res << Bits) | Text[position + i];
+				return res;
+			}
+		};
+
+		// Empty if the characters don't fit into 255 first bytes, e.g. all 2^16 of them are used
+		static std::optional<DenseAlphabet> MakeDenseAlphabet(const std::u16string_view characters) {
+			std::vector<size_t> frequencies(0x10000);
+			for(const auto c : characters)
+				++frequencies[c];
+
+			std::vector<char16_t> used;
+			for(size_t c = 0; c < frequencies.size(); ++c) {
+				if(frequencies[c] != 0)
+					used.emplace_back(char16_t(c));
+			}
+
+			// The singles most frequent characters get a byte of their own
+			auto byFrequency = used;
+			std::stable_sort(byFrequency.begin(), byFrequency.end(), [&](const char16_t a, const char16_t b) {
+				return frequencies[a] > frequencies[b];
+			});
+			std::vector<bool> single(0x10000);
+			const auto firstByteCount = [&]() {
+				size_t count = 0;
+				size_t run = 0;
+				for(const auto c : used) {
+					if(!single[c] && run++ % 0xFF == 0)
+						++count;
+					if(single[c]) {
+						++count;
+						run = 0;
+					}
+				}
+				return count;
+			};
+
+			auto singles = std::min<size_t>(used.size(), 0xFF);
+			for(size_t i = 0; i < singles; ++i)
+				single[byFrequency[i]] = true;
+			while(firstByteCount() > 0xFF) {
+				if(singles == 0)
+					return std::nullopt;
+				single[byFrequency[--singles]] = false;
+			}
+
+			// First byte in the low, second byte (or 0) in the high half
+			std::vector<std::uint16_t> codes(0x10000);
+			std::uint16_t first = 0;
+			std::uint16_t second = 0;
+			for(const auto c : used) {
+				if(single[c]) {
+					codes[c] = ++first;
+					second = 0;
+					continue;
+				}
+
+				if(second == 0 || second == 0xFF) {
+					++first;
+					second = 0;
+				}
+				codes[c] = std::uint16_t(first | ++second << 8);
+			}
+
+			// Second bytes take all 8 bits
+			DenseAlphabet alphabet;
+			alphabet.Bits = singles == used.size() ? 1 : 8;
+			while((size_t(1) << alphabet.Bits) <= first)
+				++alphabet.Bits;
+			alphabet.PerKey = 8 / alphabet.Bits;
+			for(size_t i = 0; i < alphabet.PerKey; ++i)
+				alphabet.KeyCount = (alphabet.KeyCount << alphabet.Bits) | (alphabet.Bits == 8 ? 0xFF : first);
+			++alphabet.KeyCount;
+
+			if(singles == used.size()) {
+				alphabet.Text.resize(characters.size() + alphabet.PerKey);
+				std::transform(characters.begin(), characters.end(), alphabet.Text.begin(), [&](const char16_t c) {
+					return std::uint8_t(codes[c]);
+				});
+				return alphabet;
+			}
+
+			auto size = characters.size() + alphabet.PerKey;
+			for(const auto c : used)
+				size += single[c] ? 0 : frequencies[c];
+			if(size > size_t(std::numeric_limits<Index>::max()))
+				return std::nullopt;
+
+			alphabet.Offsets.reserve(characters.size());
+			alphabet.Text.reserve(size);
+			for(const auto c : characters) {
+				alphabet.Offsets.emplace_back(Index(alphabet.Text.size()));
+				alphabet.Text.emplace_back(std::uint8_t(codes[c]));
+				if(codes[c] > 0xFF)
+					alphabet.Text.emplace_back(std::uint8_t(codes[c] >> 8));
+			}
+			alphabet.Text.resize(alphabet.Text.size() + alphabet.PerKey);
+			return alphabet;
+		}
+
+		// The first depth bytes of all suffixes in sa are equal. A bucket that contains the end of the text holds a single
+		// suffix, the suffixes with equal keys have the same length.
+		static void SuffixSortAlphabet(const DenseAlphabet &alphabet, size_t depth, const Span<Index> sa, const Span<Index> buffer,
+										const size_t max, RadixGuard &guard) {
+			if(sa.size() < 2)
+				return;
+			if(sa.size() < max) {
+				// Coded suffixes differ at the latest at the end of the shorter one
+				const auto text = alphabet.Text.data() + depth;
+				std::sort(sa.begin(), sa.end(), [&](const Index a, const Index b) {
+					if(a == b)
+						return false;
+
+					auto pa = text + alphabet.position(a);
+					auto pb = text + alphabet.position(b);
+					const auto limit = pa + RadixGuard::CompareLimit;
+					while(*pa == *pb) {
+						++pa;
+						++pb;
+						if(pa == limit)
+							return guard.limitLess(a, b);
+					}
+					return *pa < *pb;
+				});
+				return;
+			}
+
+			std::array<Index, 0x100> storage;
+			const auto buckets = Span<Index>(storage.data(), alphabet.KeyCount);
+			while(true) {
+				if(guard.exceeded(depth, sa.size())) {
+					guard.abandon();
+					return;
+				}
+
+				std::fill(buckets.begin(), buckets.end(), Index(0));
+				for(const auto suffix : sa)
+					++buckets[alphabet.key(alphabet.position(suffix) + depth)];
+				if(size_t(buckets[alphabet.key(alphabet.position(sa[0]) + depth)]) != sa.size())
+					break;
+				depth += alphabet.PerKey;
+			}
+
+			ExclusiveScan(buckets.begin(), buckets.end(), buckets.begin(), Index(0));
+			for(const auto suffix : sa)
+				buffer[size_t(buckets[alphabet.key(alphabet.position(suffix) + depth)]++)] = suffix;
+			std::copy(buffer.begin(), buffer.begin() + sa.size(), sa.begin());
+
+			// Every bucket start was moved to the end of the bucket
+			Index last = 0;
+			for(const auto bucketEnd : buckets) {
+				if(bucketEnd - last > 1)
+					SuffixSortAlphabet(alphabet, depth + alphabet.PerKey, sa.subspan(size_t(last), size_t(bucketEnd - last)), buffer, max, guard);
+				last = bucketEnd;
+			}
+		}
+
+		static void SuffixSortAlphabet(const std::u16string_view characters, const Span<Index> sa, const size_t max) {
+			RadixGuard guard(characters);
+			{
+				const auto alphabet = MakeDenseAlphabet(characters);
+				if(!alphabet) {
+					SuffixSortSharedBufferMax(characters, sa, max, SmallBucketSort::Multikey);
+					return;
+				}
+
+				std::vector<Index> buffer(sa.size());
+				SuffixSortAlphabet(*alphabet, 0, sa, buffer, max, guard);
+			}
+			// Without the alphabet and the buffer
+			guard.finish(sa);
+		}
+
+		// SA-IS (Nong, Zhang, Chan: Linear Suffix Array Construction by Almost Pure Induced-Sorting).
+		// Characters are in [0, upper], the end of the text is a virtual sentinel smaller than every character.
+		template<typename Character>
+		static void SuffixSortInducedSorting(const Character *s, const Index n, const size_t upper, const Span<Index> sa) {
+			if(n == 0)
+				return;
+
+			if(n < 8) {
+				std::iota(sa.begin(), sa.end(), Index(0));
+				std::sort(sa.begin(), sa.end(), [&](const Index a, const Index b) {
+					return std::lexicographical_compare(s + a, s + n, s + b, s + n);
+				});
+				return;
+			}
+
+			// S-type suffixes are smaller than their successor, L-type ones larger
+			std::vector<bool> isS(static_cast<size_t>(n), false);
+			for(auto i = n - 2; i >= 0; --i)
+				isS[i] = s[i] == s[i + 1] ? isS[i + 1] : s[i] < s[i + 1];
+
+			// Start of the S-part and of the L-part of every bucket
+			std::vector<Index> startS(upper + 1), startL(upper + 1);
+			for(Index i = 0; i < n; ++i) {
+				if(!isS[i])
+					++startS[s[i]];
+				else
+					++startL[size_t(s[i]) + 1];
+			}
+			for(size_t c = 0; c <= upper; ++c) {
+				startS[c] += startL[c];
+				if(c < upper)
+					startL[c + 1] += startS[c];
+			}
+
+			std::vector<Index> buckets(upper + 1);
+			const auto induce = [&](const std::vector<Index> &lms) {
+				std::fill(sa.begin(), sa.end(), Index(-1));
+				std::copy(startS.begin(), startS.end(), buckets.begin());
+				for(const auto i : lms)
+					sa[buckets[s[i]]++] = i;
+
+				std::copy(startL.begin(), startL.end(), buckets.begin());
+				sa[buckets[s[n - 1]]++] = n - 1;
+				for(Index i = 0; i < n; ++i) {
+					const auto v = sa[i];
+					if(v >= 1 && !isS[v - 1])
+						sa[buckets[s[v - 1]]++] = v - 1;
+				}
+
+				std::copy(startL.begin(), startL.end(), buckets.begin());
+				for(auto i = n - 1; i >= 0; --i) {
+					const auto v = sa[i];
+					if(v >= 1 && isS[v - 1])
+						sa[--buckets[size_t(s[v - 1]) + 1]] = v - 1;
+				}
+			};
+
+			// Leftmost S-type positions
+			std::vector<Index> lmsMap(size_t(n) + 1, Index(-1));
+			std::vector<Index> lms;
+			for(Index i = 1; i < n; ++i) {
+				if(!isS[i - 1] && isS[i]) {
+					lmsMap[i] = Index(lms.size());
+					lms.emplace_back(i);
+				}
+			}
+			const auto m = Index(lms.size());
+
+			induce(lms);
+			if(m == 0)
+				return;
+
+			std::vector<Index> sortedLms;
+			sortedLms.reserve(size_t(m));
+			for(const auto v : sa) {
+				if(lmsMap[v] != -1)
+					sortedLms.emplace_back(v);
+			}
+
+			// Name the LMS substrings, equal substrings get equal names
+			std::vector<Index> reduced(static_cast<size_t>(m));
+			Index name = 0;
+			reduced[lmsMap[sortedLms[0]]] = 0;
+			for(Index i = 1; i < m; ++i) {
+				auto l = sortedLms[i - 1];
+				auto r = sortedLms[i];
+				const auto endL = lmsMap[l] + 1 < m ? lms[lmsMap[l] + 1] : n;
+				const auto endR = lmsMap[r] + 1 < m ? lms[lmsMap[r] + 1] : n;
+				auto same = endL - l == endR - r;
+				if(same) {
+					while(l < endL && s[l] == s[r]) {
+						++l;
+						++r;
+					}
+					same = l != n && r != n && s[l] == s[r];
+				}
+
+				if(!same)
+					++name;
+				reduced[lmsMap[sortedLms[i]]] = name;
+			}
+
+			std::vector<Index> reducedSa(static_cast<size_t>(m));
+			SuffixSortInducedSorting(reduced.data(), m, size_t(name), Span<Index>(reducedSa));
+			for(Index i = 0; i < m; ++i)
+				sortedLms[i] = lms[reducedSa[i]];
+
+			induce(sortedLms);
+		}
+
+		static void SuffixSortInducedSorting(const std::u16string_view characters, const Span<Index> sa) {
+			assert(characters.size() == sa.size());
+			const auto upper = characters.empty() ? 0 : size_t(*std::max_element(characters.begin(), characters.end()));
+			SuffixSortInducedSorting(BeginPtr(characters), Index(characters.size()), upper, sa);
+		}
+	};
 
-	template<typename Derived>
-	void SuffixSortMax(const std::u16string_view characters, const Span<Index> sa, const size_t max, Derived derived) {
-		SuffixSortMax(ToTextIterator(BeginPtr(characters)), ToTextIterator(EndPtr(characters)), sa, max, derived);
-	}
-	
 	void SuffixSortStd(const std::u16string_view characters, const Span<Index> sa) {
-		SuffixSortStd(BeginPtr(characters), EndPtr(characters), sa);
+		SuffixSorter<Index>::SuffixSortStd(characters, sa);
 	}
-	
+
 	void SuffixSortSharedBuffer(const std::u16string_view characters, const Span<Index> sa) {
-		std::vector<Index> buffer(sa.size());
-		SuffixSort(characters, sa, SharedBuffer{buffer});
+		SuffixSorter<Index>::SuffixSortSharedBuffer(characters, sa);
 	}
 
 	void SuffixSortOwnBuffer(const std::u16string_view characters, const Span<Index> sa) {
-		SuffixSort(characters, sa, OwnBuffer());
+		SuffixSorter<Index>::SuffixSortOwnBuffer(characters, sa);
 	}
 
 	void SuffixSortInPlace(const std::u16string_view characters, const Span<Index> sa) {
-		SuffixSort(characters, sa, InPlace());
+		SuffixSorter<Index>::SuffixSortInPlace(characters, sa);
+	}
+
+	void SuffixSortPooledBuffer(const std::u16string_view characters, const Span<Index> sa) {
+		SuffixSorter<Index>::SuffixSortPooledBuffer(characters, sa);
+	}
+
+	void SuffixSortInducedSorting(const std::u16string_view characters, const Span<Index> sa) {
+		SuffixSorter<Index>::SuffixSortInducedSorting(characters, sa);
+	}
+
+	void SuffixSortSharedBufferMax(const std::u16string_view characters, const Span<Index> sa, const size_t max, const SmallBucketSort small) {
+		SuffixSorter<Index>::SuffixSortSharedBufferMax(characters, sa, max, small);
+	}
+
+	void SuffixSortOwnBufferMax(const std::u16string_view characters, const Span<Index> sa, const size_t max, const SmallBucketSort small) {
+		SuffixSorter<Index>::SuffixSortOwnBufferMax(characters, sa, max, small);
+	}
+
+	void SuffixSortInPlaceMax(const std::u16string_view characters, const Span<Index> sa, const size_t max, const SmallBucketSort small) {
+		SuffixSorter<Index>::SuffixSortInPlaceMax(characters, sa, max, small);
+	}
+
+	void SuffixSortPooledBufferMax(const std::u16string_view characters, const Span<Index> sa, const size_t max, const SmallBucketSort small) {
+		SuffixSorter<Index>::SuffixSortPooledBufferMax(characters, sa, max, small);
+	}
+
+	void SuffixSortParallel(const std::u16string_view characters, const Span<Index> sa, const unsigned int threads, const size_t max,
+							const SmallBucketSort small) {
+		SuffixSorter<Index>::SuffixSortParallel(characters, sa, threads, max, small);
+	}
+
+	void SuffixSortAlphabet(const std::u16string_view characters, const Span<Index> sa, const size_t max) {
+		SuffixSorter<Index>::SuffixSortAlphabet(characters, sa, max);
+	}
+
+	void SuffixSortCachedKeys(const std::u16string_view characters, const Span<Index> sa, const size_t max) {
+		SuffixSorter<Index>::SuffixSortCachedKeys(characters, sa, max);
+	}
+
+	void SuffixSortStd(const std::u16string_view characters, const Span<std::int64_t> sa) {
+		SuffixSorter<std::int64_t>::SuffixSortStd(characters, sa);
+	}
+
+	void SuffixSortSharedBuffer(const std::u16string_view characters, const Span<std::int64_t> sa) {
+		SuffixSorter<std::int64_t>::SuffixSortSharedBuffer(characters, sa);
+	}
+
+	void SuffixSortOwnBuffer(const std::u16string_view characters, const Span<std::int64_t> sa) {
+		SuffixSorter<std::int64_t>::SuffixSortOwnBuffer(characters, sa);
+	}
+
+	void SuffixSortInPlace(const std::u16string_view characters, const Span<std::int64_t> sa) {
+		SuffixSorter<std::int64_t>::SuffixSortInPlace(characters, sa);
+	}
+
+	void SuffixSortPooledBuffer(const std::u16string_view characters, const Span<std::int64_t> sa) {
+		SuffixSorter<std::int64_t>::SuffixSortPooledBuffer(characters, sa);
+	}
+
+	void SuffixSortInducedSorting(const std::u16string_view characters, const Span<std::int64_t> sa) {
+		SuffixSorter<std::int64_t>::SuffixSortInducedSorting(characters, sa);
+	}
+
+	void SuffixSortSharedBufferMax(const std::u16string_view characters, const Span<std::int64_t> sa, const size_t max, const SmallBucketSort small) {
+		SuffixSorter<std::int64_t>::SuffixSortSharedBufferMax(characters, sa, max, small);
+	}
+
+	void SuffixSortOwnBufferMax(const std::u16string_view characters, const Span<std::int64_t> sa, const size_t max, const SmallBucketSort small) {
+		SuffixSorter<std::int64_t>::SuffixSortOwnBufferMax(characters, sa, max, small);
+	}
+
+	void SuffixSortInPlaceMax(const std::u16string_view characters, const Span<std::int64_t> sa, const size_t max, const SmallBucketSort small) {
+		SuffixSorter<std::int64_t>::SuffixSortInPlaceMax(characters, sa, max, small);
+	}
+
+	void SuffixSortPooledBufferMax(const std::u16string_view characters, const Span<std::int64_t> sa, const size_t max, const SmallBucketSort small) {
+		SuffixSorter<std::int64_t>::SuffixSortPooledBufferMax(characters, sa, max, small);
 	}
 
-	void SuffixSortSharedBufferMax(const std::u16string_view characters, const Span<Index> sa, const size_t max) {
-		std::vector<Index> buffer(sa.size());
-		SuffixSortMax(characters, sa, max, SharedBuffer{buffer});
+	void SuffixSortParallel(const std::u16string_view characters, const Span<std::int64_t> sa, const unsigned int threads, const size_t max,
+							const SmallBucketSort small) {
+		SuffixSorter<std::int64_t>::SuffixSortParallel(characters, sa, threads, max, small);
 	}
 
-	void SuffixSortOwnBufferMax(const std::u16string_view characters, const Span<Index> sa, const size_t max) {
-		SuffixSortMax(characters, sa, max, OwnBuffer());
+	void SuffixSortAlphabet(const std::u16string_view characters, const Span<std::int64_t> sa, const size_t max) {
+		SuffixSorter<std::int64_t>::SuffixSortAlphabet(characters, sa, max);
 	}
 
-	void SuffixSortInPlaceMax(const std::u16string_view characters, const Span<Index> sa, const size_t max) {
-		SuffixSortMax(characters, sa, max, InPlace());
+	void SuffixSortCachedKeys(const std::u16string_view characters, const Span<std::int64_t> sa, const size_t max) {
+		SuffixSorter<std::int64_t>::SuffixSortCachedKeys(characters, sa, max);
 	}
-}
+}
\ No newline at end of file
@@ -6,11 +6,32 @@
 
 #include <catch2/catch.hpp>
 
+#include "stringsearch/Compare.hpp"
 #include "stringsearch/Search.hpp"
+#include "stringsearch/FmIndex.hpp"
 #include "stringsearch/SuffixSort.hpp"
 #include "stringsearch/Utf16Le.hpp"
+#include "stringsearch/IndexFile.hpp"
+#include "Corpus.h"
+#include "Statistics.h"
+#include "KeywordCache.h"
 
+#ifdef TEST_API
+#include "Api.h"
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <new>
+#include <memory>
 #include <numeric>
+#include <random>
+#include <thread>
 
 using namespace std::literals;
 
@@ -58,6 +79,22 @@ TEST_CASE("ItemsLookup getters work", "[ItemsLookup]") {
 	}
 }
 
+TEST_CASE("ItemsLookup getItem counts the item ends before", "[ItemsLookup]") {
+	std::mt19937 gen(41);
+	std::u16string text;
+	for(auto i = 0; i < 3000; ++i)
+		text += gen() % 4 == 0 ? u'\0' : u'x';
+	const ItemsLookup lookup(text);
+
+	Index item = 0;
+	for(size_t i = 0; i < text.size(); ++i) {
+		REQUIRE(lookup.getItem(Index(i)) == item);
+		if(text[i] == 0)
+			++item;
+	}
+	REQUIRE(lookup.itemCount() == size_t(item));
+}
+
 TEST_CASE("OldUniqueSearchLookup getters work", "[OldUniqueSearchLookup]") {
 	const OldUniqueSearchLookup array(TestString);
 
@@ -221,6 +258,30 @@ TEST_CASE("ordering strings", "[Utf16LETextIterator]") {
 	}
 }
 
+TEST_CASE("mismatch length matches std::mismatch", "[Compare]") {
+	INFO("Instruction set " << MismatchInstructionSet());
+	std::mt19937 gen(47);
+	std::vector<char16_t> a(100);
+	for(auto &c : a)
+		c = char16_t(gen());
+
+	for(size_t count = 0; count <= a.size(); ++count) {
+		for(size_t position = 0; position <= count; ++position) {
+			auto b = a;
+			if(position < count)
+				b[position] ^= char16_t(1 + gen() % 0xFFFF);
+			INFO("Count " << count << ", mismatch at " << position);
+			REQUIRE(MismatchLength(a.data(), b.data(), count) == position);
+
+			const auto av = std::u16string_view(a.data(), count);
+			const auto bv = std::u16string_view(b.data(), count);
+			REQUIRE(LessThan(av, bv) == std::lexicographical_compare(av.begin(), av.end(), bv.begin(), bv.end()));
+			REQUIRE(LessThan(bv, av) == std::lexicographical_compare(bv.begin(), bv.end(), av.begin(), av.end()));
+			REQUIRE(LessThan(av.substr(0, position), bv) == (position < count));
+		}
+	}
+}
+
 TEST_CASE("sort works", "[SuffixSort]") {
 	std::array<Index, TestString.size()> indices{};
 	std::iota(indices.begin(), indices.end(), Index(0));
@@ -239,12 +300,22 @@ TEST_CASE("sort works", "[SuffixSort]") {
 		SuffixSortInPlace(TestString, indices);
 		CollectionsEqual(indices.begin(), indices.end(), TestSuffixArray.begin(), TestSuffixArray.end());
 	}
+
+	SECTION("SuffixSortPooledBuffer") {
+		SuffixSortPooledBuffer(TestString, indices);
+		CollectionsEqual(indices.begin(), indices.end(), TestSuffixArray.begin(), TestSuffixArray.end());
+	}
 	
 	SECTION("SuffixSortStd") {
 		SuffixSortStd(TestString, indices);
 		CollectionsEqual(indices.begin(), indices.end(), TestSuffixArray.begin(), TestSuffixArray.end());
 	}
 
+	SECTION("SuffixSortInducedSorting") {
+		SuffixSortInducedSorting(TestString, indices);
+		CollectionsEqual(indices.begin(), indices.end(), TestSuffixArray.begin(), TestSuffixArray.end());
+	}
+
 	SECTION("SuffixSortOwnBufferMax") {
 		SuffixSortOwnBufferMax(TestString, indices, 2);
 		CollectionsEqual(indices.begin(), indices.end(), TestSuffixArray.begin(), TestSuffixArray.end());
@@ -261,21 +332,296 @@ TEST_CASE("sort works", "[SuffixSort]") {
 	}
 
 	SECTION("SuffixSortOwnBufferMax with SuffixSortStd") {
-		SuffixSortOwnBufferMax(TestString, indices, 4);
+		SuffixSortOwnBufferMax(TestString, indices, 4, SmallBucketSort::Comparison);
 		CollectionsEqual(indices.begin(), indices.end(), TestSuffixArray.begin(), TestSuffixArray.end());
 	}
 
 	SECTION("SuffixSortSharedBufferMax with SuffixSortStd") {
-		SuffixSortSharedBufferMax(TestString, indices, 4);
+		SuffixSortSharedBufferMax(TestString, indices, 4, SmallBucketSort::Comparison);
 		CollectionsEqual(indices.begin(), indices.end(), TestSuffixArray.begin(), TestSuffixArray.end());
 	}
 
 	SECTION("SuffixSortInPlaceMax with SuffixSortStd") {
-		SuffixSortInPlaceMax(TestString, indices, 4);
+		SuffixSortInPlaceMax(TestString, indices, 4, SmallBucketSort::Comparison);
+		CollectionsEqual(indices.begin(), indices.end(), TestSuffixArray.begin(), TestSuffixArray.end());
+	}
+
+	SECTION("SuffixSortOwnBufferMax with SuffixSortMultikey") {
+		SuffixSortOwnBufferMax(TestString, indices, 4, SmallBucketSort::Multikey);
+		CollectionsEqual(indices.begin(), indices.end(), TestSuffixArray.begin(), TestSuffixArray.end());
+	}
+
+	SECTION("SuffixSortSharedBufferMax with SuffixSortMultikey") {
+		SuffixSortSharedBufferMax(TestString, indices, 4, SmallBucketSort::Multikey);
+		CollectionsEqual(indices.begin(), indices.end(), TestSuffixArray.begin(), TestSuffixArray.end());
+	}
+
+	SECTION("SuffixSortInPlaceMax with SuffixSortMultikey") {
+		SuffixSortInPlaceMax(TestString, indices, 4, SmallBucketSort::Multikey);
+		CollectionsEqual(indices.begin(), indices.end(), TestSuffixArray.begin(), TestSuffixArray.end());
+	}
+
+	SECTION("SuffixSortPooledBufferMax") {
+		SuffixSortPooledBufferMax(TestString, indices, 4);
+		CollectionsEqual(indices.begin(), indices.end(), TestSuffixArray.begin(), TestSuffixArray.end());
+	}
+
+	SECTION("SuffixSortAlphabet") {
+		SuffixSortAlphabet(TestString, indices, 2);
+		CollectionsEqual(indices.begin(), indices.end(), TestSuffixArray.begin(), TestSuffixArray.end());
+	}
+
+	SECTION("SuffixSortAlphabet with SuffixSortStd") {
+		SuffixSortAlphabet(TestString, indices, 4);
+		CollectionsEqual(indices.begin(), indices.end(), TestSuffixArray.begin(), TestSuffixArray.end());
+	}
+
+	SECTION("SuffixSortCachedKeys") {
+		SuffixSortCachedKeys(TestString, indices, 2);
+		CollectionsEqual(indices.begin(), indices.end(), TestSuffixArray.begin(), TestSuffixArray.end());
+	}
+
+	SECTION("SuffixSortCachedKeys with SuffixSortStd") {
+		SuffixSortCachedKeys(TestString, indices, 4);
 		CollectionsEqual(indices.begin(), indices.end(), TestSuffixArray.begin(), TestSuffixArray.end());
 	}
 }
 
+// Items of random words over a small alphabet, so that buckets are big and prefixes are shared
+static std::u16string RandomItems(const size_t size, const char16_t firstCharacter, const unsigned seed) {
+	std::mt19937 gen(seed);
+	std::uniform_int_distribution<int> characterDistribution(0, 5);
+	std::uniform_int_distribution<int> lengthDistribution(1, 30);
+	std::u16string text;
+	while(text.size() < size) {
+		const auto length = lengthDistribution(gen);
+		for(auto i = 0; i < length; ++i)
+			text += char16_t(firstCharacter + characterDistribution(gen));
+		text += char16_t(0);
+	}
+	return text;
+}
+
+TEST_CASE("parallel sort matches sequential sort", "[SuffixSort]") {
+	const auto firstCharacter = GENERATE(char16_t(u'a'), char16_t(0x0430));
+	const auto text = RandomItems(200000, firstCharacter, 42);
+	std::vector<Index> expected(text.size());
+	std::iota(expected.begin(), expected.end(), Index(0));
+	SuffixSortSharedBufferMax(text, expected);
+
+	const auto threads = GENERATE(1u, 2u, 4u);
+	std::vector<Index> sa(text.size());
+	std::iota(sa.begin(), sa.end(), Index(0));
+	SuffixSortParallel(text, sa, threads);
+	REQUIRE(sa == expected);
+}
+
+TEST_CASE("pooled buffer sort matches shared buffer sort", "[SuffixSort]") {
+	// Only the first levels have buckets too big for the pooled buffer
+	const auto firstCharacter = GENERATE(char16_t(u'a'), char16_t(0x0430));
+	const auto text = RandomItems(100000, firstCharacter, 23);
+	const auto max = GENERATE(size_t(0), size_t(80));
+
+	std::vector<Index> expected(text.size());
+	std::iota(expected.begin(), expected.end(), Index(0));
+	SuffixSortSharedBufferMax(text, expected, max);
+
+	std::vector<Index> sa(text.size());
+	std::iota(sa.begin(), sa.end(), Index(0));
+	SuffixSortPooledBufferMax(text, sa, max);
+	REQUIRE(sa == expected);
+}
+
+TEST_CASE("induced sorting matches comparison sort", "[SuffixSort]") {
+	const auto text = GENERATE(
+		RandomItems(5000, u'a', 7),
+		RandomItems(5000, char16_t(0xFFF0), 7),
+		std::u16string(3000, u'a'),
+		[]() {
+			std::u16string repeated;
+			for(auto i = 0; i < 100; ++i)
+				repeated += u"song"s + char16_t(u'0' + i % 10) + u" (official video)"s + char16_t(0);
+			return repeated;
+		}()
+	);
+
+	std::vector<Index> expected(text.size());
+	std::iota(expected.begin(), expected.end(), Index(0));
+	SuffixSortStd(text, expected);
+
+	std::vector<Index> sa(text.size());
+	SuffixSortInducedSorting(text, sa);
+	REQUIRE(sa == expected);
+}
+
+TEST_CASE("multikey quicksort matches induced sorting", "[SuffixSort]") {
+	const auto text = GENERATE(
+		RandomItems(5000, u'a', 17),
+		RandomItems(5000, char16_t(0xFFF0), 17),
+		std::u16string(2000, u'a'),
+		std::u16string(2000, u'\0'),
+		[]() {
+			std::u16string repeated;
+			for(auto i = 0; i < 100; ++i)
+				repeated += u"abcab"s + char16_t(0);
+			return repeated;
+		}()
+	);
+
+	std::vector<Index> expected(text.size());
+	SuffixSortInducedSorting(text, expected);
+
+	// A max above the size sorts everything with the multikey quicksort
+	std::vector<Index> sa(text.size());
+	std::iota(sa.begin(), sa.end(), Index(0));
+	SuffixSortSharedBufferMax(text, sa, text.size() + 1, SmallBucketSort::Multikey);
+	REQUIRE(sa == expected);
+}
+
+TEST_CASE("small bucket sorts give the same order", "[SuffixSort]") {
+	const auto firstCharacter = GENERATE(char16_t(u'a'), char16_t(0x0430));
+	const auto text = RandomItems(100000, firstCharacter, 19);
+	const auto max = GENERATE(size_t(10), size_t(40), size_t(150));
+
+	std::vector<Index> expected(text.size());
+	std::iota(expected.begin(), expected.end(), Index(0));
+	SuffixSortSharedBufferMax(text, expected, max, SmallBucketSort::Comparison);
+
+	std::vector<Index> sa(text.size());
+	std::iota(sa.begin(), sa.end(), Index(0));
+	SuffixSortInPlaceMax(text, sa, max, SmallBucketSort::Multikey);
+	REQUIRE(sa == expected);
+}
+
+TEST_CASE("radix sorts handle repetitive text", "[SuffixSort]") {
+	const auto text = GENERATE(
+		std::u16string(2000, u'a'),
+		std::u16string(2000, u'\0'),
+		// Long enough for the budget of the deep levels to run out
+		[]() {
+			std::u16string periodic;
+			for(auto i = 0; i < 30000; ++i)
+				periodic += u"ab"s;
+			return periodic;
+		}(),
+		// Buckets deeper than the depth limit
+		[]() {
+			const auto item = RandomItems(300, u'a', 5);
+			std::u16string duplicated;
+			for(auto i = 0; i < 100; ++i)
+				duplicated += item;
+			return duplicated;
+		}(),
+		// Small buckets of suffixes that are equal for longer than the comparisons go
+		[]() {
+			const auto items = RandomItems(3000, u'a', 7);
+			std::u16string duplicated;
+			for(auto i = 0; i < 8; ++i)
+				duplicated += items;
+			return duplicated;
+		}()
+	);
+
+	std::vector<Index> expected(text.size());
+	SuffixSortInducedSorting(text, expected);
+
+	const auto sorted = [&](const auto sort) {
+		std::vector<Index> sa(text.size());
+		std::iota(sa.begin(), sa.end(), Index(0));
+		sort(sa);
+		return sa == expected;
+	};
+
+	SECTION("without small bucket sort") {
+		REQUIRE(sorted([&](auto &sa) { SuffixSortSharedBuffer(text, sa); }));
+		REQUIRE(sorted([&](auto &sa) { SuffixSortOwnBuffer(text, sa); }));
+		REQUIRE(sorted([&](auto &sa) { SuffixSortInPlace(text, sa); }));
+		REQUIRE(sorted([&](auto &sa) { SuffixSortPooledBuffer(text, sa); }));
+	}
+
+	SECTION("with small bucket sort") {
+		const auto max = GENERATE(size_t(10), size_t(80));
+		const auto small = GENERATE(SmallBucketSort::Comparison, SmallBucketSort::Multikey);
+		REQUIRE(sorted([&](auto &sa) { SuffixSortSharedBufferMax(text, sa, max, small); }));
+		REQUIRE(sorted([&](auto &sa) { SuffixSortOwnBufferMax(text, sa, max, small); }));
+		REQUIRE(sorted([&](auto &sa) { SuffixSortInPlaceMax(text, sa, max, small); }));
+		REQUIRE(sorted([&](auto &sa) { SuffixSortPooledBufferMax(text, sa, max, small); }));
+		REQUIRE(sorted([&](auto &sa) { SuffixSortParallel(text, sa, 2, max, small); }));
+	}
+
+	SECTION("other radix sorts") {
+		const auto max = GENERATE(size_t(0), size_t(80));
+		REQUIRE(sorted([&](auto &sa) { SuffixSortAlphabet(text, sa, max); }));
+		REQUIRE(sorted([&](auto &sa) { SuffixSortCachedKeys(text, sa, max); }));
+	}
+}
+
+TEST_CASE("alphabet sort matches comparison sort", "[SuffixSort]") {
+	const auto text = GENERATE(
+		// 7 characters, 2 per key
+		RandomItems(20000, u'a', 3),
+		RandomItems(20000, char16_t(0x0430), 3),
+		// 1 and 3 characters, 8 and 4 per key
+		std::u16string(3000, u'a'),
+		[]() {
+			std::u16string binary;
+			std::mt19937 gen(5);
+			for(auto i = 0; i < 20000; ++i)
+				binary += gen() % 8 == 0 ? char16_t(0) : char16_t(u'a' + gen() % 2);
+			return binary;
+		}(),
+		// More than 255 characters, the rare ones take two bytes
+		[]() {
+			std::u16string wide;
+			for(auto i = 0; i < 5000; ++i)
+				wide += char16_t(0x4E00 + (i * 7919) % 300);
+			return wide;
+		}(),
+		[]() {
+			auto latin = RandomItems(20000, u'a', 9);
+			for(size_t i = 0; i < latin.size(); i += 7)
+				latin[i] = char16_t(u'a' + 0x4000 + i % 700);
+			return latin;
+		}(),
+		// All characters, sorted by SuffixSortSharedBufferMax
+		[]() {
+			std::u16string all(0x10000, u'\0');
+			std::iota(all.begin(), all.end(), char16_t(0));
+			std::shuffle(all.begin(), all.end(), std::mt19937(11));
+			return all;
+		}()
+	);
+
+	std::vector<Index> expected(text.size());
+	SuffixSortInducedSorting(text, expected);
+
+	const auto max = GENERATE(size_t(0), size_t(80));
+	std::vector<Index> sa(text.size());
+	std::iota(sa.begin(), sa.end(), Index(0));
+	SuffixSortAlphabet(text, sa, max);
+	REQUIRE(sa == expected);
+}
+
+TEST_CASE("cached keys sort matches induced sorting", "[SuffixSort]") {
+	const auto text = GENERATE(
+		RandomItems(20000, u'a', 13),
+		RandomItems(20000, char16_t(0x3040), 13),
+		// Suffixes that end inside a key
+		u"ab\0\0\0\0\0ab\0\0\0ab\0\0"s,
+		std::u16string(1000, u'\0'),
+		std::u16string(1000, u'a') + u'\0'
+	);
+
+	std::vector<Index> expected(text.size());
+	SuffixSortInducedSorting(text, expected);
+
+	const auto max = GENERATE(size_t(0), size_t(80));
+	std::vector<Index> sa(text.size());
+	std::iota(sa.begin(), sa.end(), Index(0));
+	SuffixSortCachedKeys(text, sa, max);
+	REQUIRE(sa == expected);
+}
+
 constexpr auto Av = u"A"sv;
 constexpr auto Bv = u"B"sv;
 constexpr auto Cv = u"C"sv;
@@ -318,6 +664,90 @@ TEST_CASE("bound", "[SuffixArray]") {
 	}
 }
 
+TEST_CASE("lcp array", "[SuffixArray]") {
+	const auto expected = MakeArray<Index>(0, 1, 1, 1, 1, 0, 0, 1, 0, 1, 2, 0, 1, 0);
+	std::array<Index, TestString.size()> lcp{};
+	CreateLcpArray(TestString, TestSuffixArray, lcp);
+	CollectionsEqual(lcp.begin(), lcp.end(), expected.begin(), expected.end());
+}
+
+TEST_CASE("find matches bounds", "[SuffixArray]") {
+	const auto text = RandomItems(20000, u'a', 3);
+	const auto lcpSearch = GENERATE(false, true);
+	BuildOptions options;
+	options.LcpSearch = lcpSearch;
+	const SuffixArray array(text, options);
+	REQUIRE(array.lcpTable().empty() != lcpSearch);
+
+	std::mt19937 gen(5);
+	std::uniform_int_distribution<size_t> offsetDistribution(0, text.size() - 1);
+	std::uniform_int_distribution<size_t> lengthDistribution(0, 40);
+	for(auto i = 0; i < 500; ++i) {
+		auto pattern = std::u16string(text.substr(offsetDistribution(gen), lengthDistribution(gen)));
+		// Every other pattern probably doesn't occur
+		if(i % 2 == 1 && !pattern.empty())
+			pattern.back() = char16_t(pattern.back() + 1);
+
+		INFO("Pattern " << i << " of length " << pattern.size());
+		const auto result = array.find(text, pattern);
+		REQUIRE(result.begin() == SuffixArray::lowerBound(array.begin(), array.end(), text, pattern));
+		REQUIRE(result.end() == SuffixArray::upperBound(array.begin(), array.end(), text, pattern));
+	}
+}
+
+TEST_CASE("prefix table find matches bounds", "[SuffixArray]") {
+	const auto text = RandomItems(20000, u'a', 7);
+	std::vector<Index> sa(text.size());
+	CreateArray(text, sa);
+	// A low threshold gives most first characters bigrams
+	const auto threshold = GENERATE(size_t(16), PrefixTable::DefaultBigramThreshold, size_t(1) << 20);
+	const SuffixArray array(Storage<Index>(Span<const Index>(sa)), {}, PrefixTable(text, sa, threshold));
+
+	std::mt19937 gen(11);
+	std::uniform_int_distribution<size_t> offsetDistribution(0, text.size() - 1);
+	std::uniform_int_distribution<size_t> lengthDistribution(1, 6);
+	for(auto i = 0; i < 2000; ++i) {
+		auto pattern = std::u16string(text.substr(offsetDistribution(gen), lengthDistribution(gen)));
+		if(i % 2 == 1)
+			pattern.back() = char16_t(pattern.back() + 1);
+
+		INFO("Pattern " << i << " of length " << pattern.size());
+		const auto result = array.find(text, pattern);
+		REQUIRE(result.begin() == SuffixArray::lowerBound(array.begin(), array.end(), text, pattern));
+		REQUIRE(result.end() == SuffixArray::upperBound(array.begin(), array.end(), text, pattern));
+	}
+}
+
+TEST_CASE("refine matches find", "[SuffixArray]") {
+	const auto text = RandomItems(20000, u'a', 13);
+	const SuffixArray array(text);
+
+	std::mt19937 gen(17);
+	std::uniform_int_distribution<size_t> offsetDistribution(0, text.size() - 1);
+	std::uniform_int_distribution<size_t> lengthDistribution(1, 12);
+	for(auto i = 0; i < 500; ++i) {
+		auto pattern = std::u16string(text.substr(offsetDistribution(gen), lengthDistribution(gen)));
+		if(i % 2 == 1)
+			pattern.back() = char16_t(pattern.back() + 1);
+
+		// Typed one character at a time and in one step from every prefix
+		const auto expected = array.find(text, pattern);
+		auto range = array.find(text, u"");
+		for(size_t length = 1; length <= pattern.size(); ++length) {
+			const auto prefix = std::u16string_view(pattern).substr(0, length);
+			INFO("Pattern " << i << ", prefix of length " << length);
+			const auto refined = array.refine(text, array.find(text, prefix.substr(0, length - 1)), length - 1, pattern);
+			REQUIRE(refined.begin() == expected.begin());
+			REQUIRE(refined.end() == expected.end());
+
+			range = array.refine(text, range, length - 1, prefix);
+			const auto found = array.find(text, prefix);
+			REQUIRE(range.begin() == found.begin());
+			REQUIRE(range.end() == found.end());
+		}
+	}
+}
+
 TEST_CASE("OldUniqueSearchLookup findUnique", "[OldUniqueSearchLookup]") {
 	const auto array = SuffixArray(TestSuffixArray);
 	const OldUniqueSearchLookup oldSearch(TestString);
@@ -420,6 +850,369 @@ TEST_CASE("UniqueSearchLookup findUnique", "[UniqueSearchLookup]") {
 	}
 }
 
+TEST_CASE("range minimum", "[RangeMinimum]") {
+	std::mt19937 gen(13);
+	std::uniform_int_distribution<Index> valueDistribution(-1, 500);
+	const auto size = GENERATE(size_t(1), size_t(31), size_t(32), size_t(33), size_t(1000));
+	std::vector<Index> values(size);
+	for(auto &value : values)
+		value = valueDistribution(gen);
+
+	const RangeMinimum rangeMinimum(values);
+	REQUIRE(rangeMinimum.sparseArray().size() == RangeMinimum::SparseSize(size));
+	std::uniform_int_distribution<size_t> positionDistribution(0, size - 1);
+	for(auto i = 0; i < 1000; ++i) {
+		auto begin = positionDistribution(gen);
+		auto end = positionDistribution(gen);
+		if(begin > end)
+			std::swap(begin, end);
+		++end;
+
+		const auto expected = std::min_element(values.begin() + begin, values.begin() + end) - values.begin();
+		REQUIRE(rangeMinimum.minimum(Index(begin), Index(end)) == expected);
+	}
+}
+
+TEST_CASE("bit vector rank", "[BitVector]") {
+	const auto size = GENERATE(size_t(0), size_t(1), size_t(64), size_t(511), size_t(512), size_t(513), size_t(5000));
+	std::mt19937 gen(23);
+	std::vector<bool> bits(size);
+	std::vector<std::uint64_t> words(BitVector::WordCount(size));
+	for(size_t i = 0; i < size; ++i) {
+		bits[i] = gen() % 3 == 0;
+		if(bits[i])
+			words[i / BitVector::WordBits] |= std::uint64_t(1) << (i % BitVector::WordBits);
+	}
+
+	const BitVector vector(std::move(words), size);
+	size_t ones = 0;
+	for(size_t i = 0; i < size; ++i) {
+		REQUIRE(vector.rank(i) == ones);
+		REQUIRE(vector[i] == bits[i]);
+		ones += bits[i];
+	}
+	REQUIRE(vector.rank(size) == ones);
+}
+
+TEST_CASE("wavelet matrix countLess", "[WaveletMatrix]") {
+	std::mt19937 gen(29);
+	const auto maxValue = GENERATE(Index(1), Index(7), Index(1000));
+	std::vector<Index> values(777);
+	for(auto &value : values)
+		value = Index(gen() % (maxValue + 1));
+
+	const WaveletMatrix matrix(values, WaveletMatrix::LevelCount(size_t(maxValue)));
+	for(auto i = 0; i < 500; ++i) {
+		auto begin = gen() % values.size();
+		auto end = gen() % (values.size() + 1);
+		if(begin > end)
+			std::swap(begin, end);
+		const auto value = Index(gen() % (maxValue + 2));
+		const auto expected = std::count_if(values.begin() + begin, values.begin() + end, [&](const Index v) { return v < value; });
+		REQUIRE(matrix.countLess(begin, end, std::uint64_t(value)) == size_t(expected));
+	}
+}
+
+TEST_CASE("wavelet matrix rank and access", "[WaveletMatrix]") {
+	std::mt19937 gen(31);
+	const auto maxValue = GENERATE(Index(0), Index(5), Index(300));
+	std::vector<Index> values(777);
+	for(auto &value : values)
+		value = Index(gen() % (maxValue + 1));
+
+	const WaveletMatrix matrix(values, WaveletMatrix::LevelCount(size_t(maxValue)));
+	std::vector<size_t> seen(size_t(maxValue) + 1);
+	for(size_t i = 0; i < values.size(); ++i) {
+		const auto [value, rank] = matrix.accessRank(i);
+		REQUIRE(value == std::uint64_t(values[i]));
+		REQUIRE(rank == seen[size_t(value)]++);
+	}
+
+	for(auto i = 0; i < 500; ++i) {
+		auto begin = gen() % (values.size() + 1);
+		auto end = gen() % (values.size() + 1);
+		if(begin > end)
+			std::swap(begin, end);
+		const auto value = Index(gen() % (maxValue + 2));
+		const auto [rankBegin, rankEnd] = matrix.rank(std::uint64_t(value), begin, end);
+		REQUIRE(rankBegin == size_t(std::count(values.begin(), values.begin() + begin, value)));
+		REQUIRE(rankEnd == size_t(std::count(values.begin(), values.begin() + end, value)));
+	}
+}
+
+TEST_CASE("countDistinct matches unique items", "[UniqueSearchLookup]") {
+	const auto text = RandomItems(30000, u'a', 31);
+	BuildOptions options;
+	options.DistinctCounting = true;
+	const Search search(text, options);
+	const Search scanning(text);
+	REQUIRE_FALSE(search.itemsLookup().distinctItems().empty());
+
+	std::mt19937 gen(37);
+	for(auto i = 0; i < 300; ++i) {
+		const auto pattern = text.substr(gen() % text.size(), 1 + gen() % 4);
+		const auto scanned = scanning.find(pattern);
+		std::vector<Index> items;
+		for(auto it = scanning.itemsLookup().uniqueItemsInRange(scanned, 0); it != UniqueItemsIteratorEnd(); ++it)
+			items.emplace_back(*it);
+
+		INFO("Pattern " << i);
+		REQUIRE(search.itemsLookup().countDistinct(search.find(pattern)) == items.size());
+		REQUIRE(scanning.itemsLookup().countDistinct(scanned) == items.size());
+	}
+}
+
+TEST_CASE("reporting findUnique matches scan", "[UniqueSearchLookup]") {
+	const auto text = RandomItems(50000, u'a', 17);
+	const Search search(text, [] {
+		BuildOptions options;
+		options.UniqueReporting = true;
+		return options;
+	}());
+	const auto &lookup = search.itemsLookup();
+	REQUIRE_FALSE(lookup.rangeMinimum().empty());
+
+	std::mt19937 gen(19);
+	std::uniform_int_distribution<size_t> offsetDistribution(0, text.size() - 1);
+	std::uniform_int_distribution<size_t> lengthDistribution(1, 4);
+	std::uniform_int_distribution<size_t> outputDistribution(0, 300);
+	std::vector<Index> expected(300), output(300);
+	for(auto i = 0; i < 300; ++i) {
+		const auto result = search.find(text.substr(offsetDistribution(gen), lengthDistribution(gen)));
+		const auto outputSize = outputDistribution(gen);
+		const auto offset = unsigned(std::uniform_int_distribution<size_t>(0, result.size())(gen));
+
+		INFO("Range of " << result.size() << " entries, offset " << offset << ", output " << outputSize);
+		const auto scanned = lookup.findUnique(result, Span<Index>(expected).subspan(0, outputSize), offset, FindUniqueMode::Scan);
+		const auto mode = i % 2 == 0 ? FindUniqueMode::Report : FindUniqueMode::Auto;
+		const auto reported = lookup.findUnique(result, Span<Index>(output).subspan(0, outputSize), offset, mode);
+		REQUIRE(reported.Count == scanned.Count);
+		REQUIRE(reported.Consumed == scanned.Consumed);
+		CollectionsEqual(output.begin(), output.begin() + reported.Count, expected.begin(), expected.begin() + scanned.Count);
+	}
+
+	const Search scanning(text);
+	const std::array<FindResult, 2> results{search.find(u"ab"), search.find(u"ba")};
+	const std::array<FindResult, 2> scannedResults{scanning.find(u"ab"), scanning.find(u"ba")};
+	REQUIRE(lookup.findUniquePatterns(results).size() == scanning.itemsLookup().findUniquePatterns(scannedResults).size());
+	auto all = lookup.findUniqueInAllPatterns(results);
+	auto scannedAll = scanning.itemsLookup().findUniqueInAllPatterns(scannedResults);
+	std::sort(all.begin(), all.end());
+	std::sort(scannedAll.begin(), scannedAll.end());
+	CollectionsEqual(all.begin(), all.end(), scannedAll.begin(), scannedAll.end());
+}
+
+TEST_CASE("pages continued at consumed return every item once", "[UniqueSearchLookup]") {
+	const auto text = RandomItems(30000, u'a', 43);
+	BuildOptions options;
+	options.UniqueReporting = GENERATE(false, true);
+	const Search search(text, options);
+	const auto &lookup = search.itemsLookup();
+
+	std::mt19937 gen(47);
+	for(auto i = 0; i < 100; ++i) {
+		const auto result = search.find(text.substr(gen() % text.size(), 1 + gen() % 2));
+		const auto pageSize = 1 + gen() % 50;
+		std::vector<Index> paged, page(pageSize);
+		for(size_t position = 0; position < result.size();) {
+			const auto res = lookup.findUnique(result, page, position);
+			REQUIRE(res.Consumed > position);
+			std::transform(page.begin(), page.begin() + res.Count, std::back_inserter(paged), [&](const Index suffix) {
+				return lookup.getItem(size_t(suffix));
+			});
+			position = res.Consumed;
+		}
+
+		INFO("Pattern " << i << ", pages of " << pageSize);
+		std::sort(paged.begin(), paged.end());
+		const auto expected = lookup.uniqueItems(result);
+		CollectionsEqual(paged.begin(), paged.end(), expected.begin(), expected.end());
+	}
+}
+
+TEST_CASE("unique items match findUniqueInAllPatterns", "[UniqueSearchLookup]") {
+	const auto text = RandomItems(30000, u'a', 29);
+	BuildOptions options;
+	options.UniqueReporting = GENERATE(false, true);
+	const Search search(text, options);
+	const auto &lookup = search.itemsLookup();
+
+	std::mt19937 gen(41);
+	for(auto i = 0; i < 100; ++i) {
+		const std::array<FindResult, 2> results{search.find(text.substr(gen() % text.size(), 1 + gen() % 3)),
+			search.find(text.substr(gen() % text.size(), 1 + gen() % 3))};
+		const auto first = lookup.uniqueItems(results[0]);
+		const auto second = lookup.uniqueItems(results[1]);
+		auto expectedFirst = lookup.findUniqueInAllPatterns(Span<const FindResult>(results).subspan(0, 1));
+		auto expectedBoth = lookup.findUniqueInAllPatterns(results);
+		std::sort(expectedFirst.begin(), expectedFirst.end());
+		std::sort(expectedBoth.begin(), expectedBoth.end());
+
+		INFO("Pattern " << i);
+		CollectionsEqual(first.begin(), first.end(), expectedFirst.begin(), expectedFirst.end());
+		const auto both = lookup.itemsContainedIn(first, results[1]);
+		CollectionsEqual(both.begin(), both.end(), expectedBoth.begin(), expectedBoth.end());
+		std::vector<Index> intersection;
+		std::set_intersection(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(intersection));
+		CollectionsEqual(intersection.begin(), intersection.end(), expectedBoth.begin(), expectedBoth.end());
+	}
+}
+
+TEST_CASE("concurrent queries match sequential ones", "[Search]") {
+	const auto text = RandomItems(30000, u'a', 53);
+	BuildOptions options;
+	options.LcpSearch = true;
+	options.PrefixSearch = true;
+	options.UniqueReporting = true;
+	options.DistinctCounting = true;
+	const Search search(text, options);
+	const auto &lookup = search.itemsLookup();
+
+	std::mt19937 gen(59);
+	std::vector<std::u16string> patterns;
+	for(auto i = 0; i < 400; ++i)
+		patterns.emplace_back(text.substr(gen() % text.size(), 1 + gen() % 4));
+
+	// Size, distinct items and the first 30 unique items of every pattern
+	using Answer = std::tuple<size_t, size_t, std::vector<Index>>;
+	const auto answer = [&](const std::u16string &pattern) {
+		const auto result = search.find(pattern);
+		std::vector<Index> output(30);
+		output.resize(lookup.findUnique(result, output).Count);
+		return Answer(result.size(), lookup.countDistinct(result), std::move(output));
+	};
+
+	std::vector<Answer> expected;
+	for(const auto &pattern : patterns)
+		expected.emplace_back(answer(pattern));
+
+	// Every thread starts at another pattern, so different queries overlap
+	std::vector<std::vector<Answer>> answers(4);
+	std::vector<std::thread> threads;
+	for(size_t t = 0; t < answers.size(); ++t) {
+		threads.emplace_back([&, t]() {
+			for(size_t i = 0; i < patterns.size(); ++i)
+				answers[t].emplace_back(answer(patterns[(i + t * 101) % patterns.size()]));
+		});
+	}
+	for(auto &thread : threads)
+		thread.join();
+
+	for(size_t t = 0; t < answers.size(); ++t) {
+		for(size_t i = 0; i < patterns.size(); ++i) {
+			INFO("Thread " << t << ", pattern " << i);
+			REQUIRE(answers[t][i] == expected[(i + t * 101) % patterns.size()]);
+		}
+	}
+}
+
+TEST_CASE("fm index matches the suffix array", "[FmIndex]") {
+	const auto text = GENERATE(RandomItems(20000, u'a', 61), RandomItems(20000, char16_t(0x0430), 67), u"abra\0cad\0abra\0"s, u""s);
+	BuildOptions options;
+	options.SampleRate = GENERATE(size_t(1), size_t(5), size_t(32));
+	const Search search(text, options);
+	const FmSearch fm(text, options);
+	const auto &index = fm.index();
+	const auto sa = search.suffixArray().begin();
+	REQUIRE(index.size() == text.size() + 1);
+	REQUIRE(fm.itemsLookup().itemCount() == search.itemsLookup().itemCount());
+
+	for(size_t row = 1; row < index.size(); ++row) {
+		REQUIRE(index.locate(row) == size_t(sa[row - 1]));
+		REQUIRE(fm.itemsLookup().itemOf(row) == search.itemsLookup().getItem(size_t(sa[row - 1])));
+	}
+
+	std::mt19937 gen(71);
+	std::vector<Index> expected(25), output(25);
+	for(auto i = 0; i < 200 && !text.empty(); ++i) {
+		const auto pattern = i % 10 == 0 ? u"xyz"s : text.substr(gen() % text.size(), 1 + gen() % 4);
+		const auto result = search.find(pattern);
+		const auto range = fm.find(pattern);
+		INFO("Pattern " << i);
+		REQUIRE(range.size() == result.size());
+		if(!result.size())
+			continue;
+		REQUIRE(range.Begin - 1 == size_t(result.begin() - sa));
+
+		const auto offset = gen() % (result.size() + 1);
+		const auto scanned = search.itemsLookup().findUnique(result, expected, offset, FindUniqueMode::Scan);
+		for(auto &item : Span<Index>(expected).subspan(0, scanned.Count))
+			item = search.itemsLookup().getItem(size_t(item));
+		const auto found = fm.itemsLookup().findUnique(range, output, offset);
+		REQUIRE(found.Count == scanned.Count);
+		REQUIRE(found.Consumed == scanned.Consumed);
+		CollectionsEqual(output.begin(), output.begin() + found.Count, expected.begin(), expected.begin() + scanned.Count);
+
+		const auto items = search.itemsLookup().uniqueItems(result);
+		const auto fmItems = fm.itemsLookup().uniqueItems(range);
+		CollectionsEqual(fmItems.begin(), fmItems.end(), items.begin(), items.end());
+		REQUIRE(fm.itemsLookup().countDistinct(range) == items.size());
+	}
+	REQUIRE(fm.find(u"").size() == text.size());
+}
+
+TEST_CASE("fm index memory usage matches the estimate", "[FmIndex]") {
+	CatalogOptions catalogOptions;
+	catalogOptions.Characters = 20000;
+	const auto catalog = GenerateCatalog(catalogOptions);
+
+	BuildOptions options;
+	options.SampleRate = GENERATE(size_t(4), size_t(32));
+	const FmSearch search(catalog, options);
+	const auto usage = search.memoryUsage();
+	const auto alphabet = search.index().alphabetArray().size();
+	const auto estimate = EstimateFmMemoryUsage(catalog.size(), search.itemsLookup().itemCount(), alphabet, options);
+	REQUIRE(usage.Text == 0);
+	REQUIRE(usage.SuffixArray == estimate.SuffixArray);
+	REQUIRE(usage.ItemEnds == estimate.ItemEnds);
+	REQUIRE(usage.Bwt == estimate.Bwt);
+	REQUIRE(usage.BuildPeak == estimate.BuildPeak);
+	REQUIRE(usage.BuildPeak >= usage.total());
+	REQUIRE(EstimateFmMemoryUsage(catalog.size(), search.itemsLookup().itemCount(), 0x10000, options).total() > usage.total());
+
+	// Well below the suffix array and the previous entries alone
+	REQUIRE(usage.total() < catalog.size() * 2 * sizeof(Index) / 3);
+}
+
+TEST_CASE("Index40 stores 40 bit signed values", "[Index40]") {
+	const auto value = GENERATE(std::int64_t(0), std::int64_t(-1), std::int64_t(1) << 32, (std::int64_t(1) << 39) - 1, -(std::int64_t(1) << 39));
+	const Index40 packed = value;
+	REQUIRE(std::int64_t(packed) == value);
+}
+
+TEMPLATE_TEST_CASE("wide indices match Index", "[Search]", std::int64_t, Index40) {
+	const auto text = RandomItems(20000, u'a', 23);
+	BuildOptions options;
+	options.Algorithm = GENERATE(SuffixSortAlgorithm::Radix, SuffixSortAlgorithm::InducedSorting, SuffixSortAlgorithm::AlphabetRadix,
+		SuffixSortAlgorithm::CachedKeyRadix);
+	options.LcpSearch = true;
+	options.PrefixSearch = GENERATE(false, true);
+	options.UniqueReporting = true;
+	options.DistinctCounting = true;
+	const Search narrow(text, options);
+	const BasicSearch<TestType> wide(text, options);
+	CollectionsEqual(wide.suffixArray().begin(), wide.suffixArray().end(), narrow.suffixArray().begin(), narrow.suffixArray().end());
+
+	std::mt19937 gen(31);
+	std::vector<Index> expected(50);
+	std::vector<IndexValue<TestType>> output(50);
+	for(auto i = 0; i < 200; ++i) {
+		const auto pattern = text.substr(gen() % text.size(), 1 + gen() % 5);
+		const auto narrowResult = narrow.find(pattern);
+		const auto wideResult = wide.find(pattern);
+		INFO("Pattern " << i);
+		REQUIRE(size_t(wide.suffixArray().indexOf(wideResult.begin())) == size_t(narrow.suffixArray().indexOf(narrowResult.begin())));
+		REQUIRE(wideResult.size() == narrowResult.size());
+		REQUIRE(wide.itemsLookup().countDistinct(wideResult) == narrow.itemsLookup().countDistinct(narrowResult));
+
+		const auto narrowUnique = narrow.itemsLookup().findUnique(narrowResult, expected);
+		const auto wideUnique = wide.itemsLookup().findUnique(wideResult, output);
+		REQUIRE(wideUnique.Count == narrowUnique.Count);
+		REQUIRE(wideUnique.Consumed == narrowUnique.Consumed);
+		CollectionsEqual(output.begin(), output.begin() + wideUnique.Count, expected.begin(), expected.begin() + narrowUnique.Count);
+	}
+}
+
 TEST_CASE("iterate", "[UniqueItemsIterator]") {
 	const auto array = SuffixArray(TestSuffixArray);
 	const UniqueSearchLookup lookup(TestString, array);
@@ -440,4 +1233,772 @@ TEST_CASE("iterate", "[UniqueItemsIterator]") {
 	}
 }
 
+// Path of an index file in the temp directory, the file is removed at the end of the scope also if a REQUIRE fails
+class TempIndexFile {
+	std::string path_;
+
+public:
+	TempIndexFile()
+		: path_((std::filesystem::temp_directory_path() / ("teststringsearch-" + std::to_string(std::random_device()()) + ".index")).string()) {}
+
+	TempIndexFile(const TempIndexFile &) = delete;
+	TempIndexFile &operator=(const TempIndexFile &) = delete;
+
+	~TempIndexFile() {
+		std::remove(path_.c_str());
+	}
+
+	[[nodiscard]] const char *path() const noexcept { return path_.c_str(); }
+};
+
+TEST_CASE("round trip", "[IndexFile]") {
+	const TempIndexFile indexFile;
+	const auto path = indexFile.path();
+	const Search search(TestString);
+	WriteIndexFile(search, path);
+
+	SECTION("mapped instance matches") {
+		const MappedFile file(path);
+		REQUIRE_NOTHROW(VerifyIndexFile(ReadIndexFile(file.bytes())));
+		const Search mapped(ReadIndexFile(file.bytes()));
+		REQUIRE(mapped.text() == TestString);
+		REQUIRE(mapped.itemsLookup().itemCount() == search.itemsLookup().itemCount());
+		CollectionsEqual(mapped.suffixArray().begin(), mapped.suffixArray().end(), TestSuffixArray.begin(), TestSuffixArray.end());
+		CollectionsEqual(mapped.itemsLookup().previousEntryOfSameItem().begin(), mapped.itemsLookup().previousEntryOfSameItem().end(),
+			search.itemsLookup().previousEntryOfSameItem().begin(), search.itemsLookup().previousEntryOfSameItem().end());
+
+		const auto result = mapped.find(Cv);
+		REQUIRE(mapped.suffixArray().indexOf(result.begin()) == Cr.first);
+		REQUIRE(mapped.suffixArray().indexOf(result.end()) == Cr.second);
+		REQUIRE(mapped.itemsLookup().getItem(*result.begin()) == 2);
+	}
+
+	SECTION("lcp table is stored") {
+		BuildOptions options;
+		options.LcpSearch = true;
+		const Search withLcp(TestString, options);
+		WriteIndexFile(withLcp, path);
+
+		const MappedFile file(path);
+		REQUIRE_NOTHROW(VerifyIndexFile(ReadIndexFile(file.bytes())));
+		const Search mapped(ReadIndexFile(file.bytes()));
+		REQUIRE_FALSE(mapped.suffixArray().lcpTable().empty());
+		const auto result = mapped.find(Cv);
+		REQUIRE(mapped.suffixArray().indexOf(result.begin()) == Cr.first);
+		REQUIRE(mapped.suffixArray().indexOf(result.end()) == Cr.second);
+	}
+
+	SECTION("optional tables are stored") {
+		BuildOptions options;
+		options.PrefixSearch = true;
+		options.UniqueReporting = true;
+		options.DistinctCounting = true;
+		const Search withPrefix(TestString, options);
+		WriteIndexFile(withPrefix, path);
+
+		const MappedFile file(path);
+		REQUIRE_NOTHROW(VerifyIndexFile(ReadIndexFile(file.bytes())));
+		const Search mapped(ReadIndexFile(file.bytes()));
+		REQUIRE_FALSE(mapped.suffixArray().prefixTable().empty());
+		REQUIRE_FALSE(mapped.itemsLookup().rangeMinimum().empty());
+		REQUIRE(mapped.itemsLookup().countDistinct(mapped.find(Cv)) == withPrefix.itemsLookup().countDistinct(withPrefix.find(Cv)));
+		const auto result = mapped.find(Cv);
+		REQUIRE(mapped.suffixArray().indexOf(result.begin()) == Cr.first);
+		REQUIRE(mapped.suffixArray().indexOf(result.end()) == Cr.second);
+	}
+
+	SECTION("Index40 instance round trips") {
+		const BasicSearch<Index40> packed(TestString);
+		WriteIndexFile(packed, path);
+
+		const MappedFile file(path);
+		REQUIRE(ReadIndexFileIndexSize(file.bytes()) == sizeof(Index40));
+		REQUIRE_THROWS(ReadIndexFile(file.bytes()));
+		REQUIRE_NOTHROW(VerifyIndexFile(ReadIndexFile<Index40>(file.bytes())));
+		const BasicSearch<Index40> mapped(ReadIndexFile<Index40>(file.bytes()));
+		CollectionsEqual(mapped.suffixArray().begin(), mapped.suffixArray().end(), TestSuffixArray.begin(), TestSuffixArray.end());
+		const auto result = mapped.find(Cv);
+		REQUIRE(mapped.suffixArray().indexOf(result.begin()) == Cr.first);
+		REQUIRE(mapped.suffixArray().indexOf(result.end()) == Cr.second);
+	}
+
+	SECTION("invalid files are rejected") {
+		const MappedFile file(path);
+		const auto bytes = file.bytes();
+		REQUIRE_THROWS(ReadIndexFile(bytes.subspan(0, sizeof(IndexFileHeader) - 1)));
+		REQUIRE_THROWS(ReadIndexFile(bytes.subspan(0, bytes.size() - 1)));
+
+		std::vector<std::byte> copy(bytes.begin(), bytes.end());
+		copy[0] = std::byte('x');
+		REQUIRE_THROWS(ReadIndexFile(copy));
+	}
+
+	SECTION("corrupt values are only rejected by the verification") {
+		CatalogOptions catalogOptions;
+		catalogOptions.Characters = 2000;
+		const auto catalog = GenerateCatalog(catalogOptions);
+		BuildOptions options;
+		options.LcpSearch = true;
+		options.UniqueReporting = true;
+		options.DistinctCounting = true;
+		WriteIndexFile(Search(catalog, options), path);
+
+		const MappedFile file(path);
+		const auto bytes = file.bytes();
+		REQUIRE_NOTHROW(VerifyIndexFile(ReadIndexFile(bytes)));
+		IndexFileHeader header{};
+		std::memcpy(&header, bytes.data(), sizeof(header));
+		const auto id = GENERATE(IndexFileSectionId::SuffixArray, IndexFileSectionId::PreviousEntryOfSameItem, IndexFileSectionId::LcpLeft,
+			IndexFileSectionId::UniqueRangeMinimum, IndexFileSectionId::ItemEndRanks, IndexFileSectionId::DistinctRanks);
+		bool found = false;
+		for(std::uint32_t i = 0; i < header.SectionCount; ++i) {
+			IndexFileSection section{};
+			std::memcpy(&section, bytes.data() + sizeof(header) + i * sizeof(section), sizeof(section));
+			if(section.Id != id)
+				continue;
+
+			// Values which are in the text but break what queries assume of them
+			std::vector<std::byte> copy(bytes.begin(), bytes.end());
+			auto *const entry = copy.data() + section.Offset;
+			if(id == IndexFileSectionId::SuffixArray) {
+				const auto value = Index(catalog.size());
+				std::memcpy(entry, &value, sizeof(value));
+			} else if(id == IndexFileSectionId::PreviousEntryOfSameItem) {
+				const Index value = 0;
+				std::memcpy(entry, &value, sizeof(value));
+			} else if(id == IndexFileSectionId::LcpLeft) {
+				const std::uint16_t value = 0xFFFF;
+				std::memcpy(entry, &value, sizeof(value));
+			} else if(id == IndexFileSectionId::UniqueRangeMinimum) {
+				const auto value = Index(catalog.size() - 1);
+				std::memcpy(entry, &value, sizeof(value));
+			} else {
+				std::uint64_t value = 0;
+				std::memcpy(&value, entry + section.Count * section.ElementSize - sizeof(value), sizeof(value));
+				++value;
+				std::memcpy(entry + section.Count * section.ElementSize - sizeof(value), &value, sizeof(value));
+			}
+			REQUIRE_NOTHROW(ReadIndexFile(copy));
+			REQUIRE_THROWS(VerifyIndexFile(ReadIndexFile(copy)));
+			found = true;
+		}
+		REQUIRE(found);
+	}
+}
+
+TEMPLATE_TEST_CASE("memory usage matches the estimate", "[Search]", Index, std::int64_t, Index40) {
+	CatalogOptions catalogOptions;
+	catalogOptions.Characters = 20000;
+	const auto catalog = GenerateCatalog(catalogOptions);
+
+	BuildOptions options;
+	options.LcpSearch = GENERATE(false, true);
+	options.UniqueReporting = GENERATE(false, true);
+	options.DistinctCounting = GENERATE(false, true);
+	const BasicSearch<TestType> search(catalog, options);
+	const auto usage = search.memoryUsage();
+	const auto estimate = EstimateMemoryUsage<TestType>(catalog.size(), search.itemsLookup().itemCount(), options);
+	REQUIRE(usage.Text == catalog.size() * sizeof(char16_t));
+	REQUIRE(usage.SuffixArray == catalog.size() * sizeof(TestType));
+	REQUIRE(usage.total() == estimate.total());
+	REQUIRE(usage.BuildPeak == estimate.BuildPeak);
+	REQUIRE(usage.BuildPeak >= usage.total());
+	REQUIRE((usage.LcpTable != 0) == options.LcpSearch);
+	REQUIRE((usage.RangeMinimum != 0) == options.UniqueReporting);
+	REQUIRE((usage.DistinctItems != 0) == options.DistinctCounting);
+
+	SECTION("mapped instances have no build peak") {
+		const TempIndexFile indexFile;
+		WriteIndexFile(search, indexFile.path());
+		const MappedFile file(indexFile.path());
+		const BasicSearch<TestType> mapped(ReadIndexFile<TestType>(file.bytes()));
+		const auto mappedUsage = mapped.memoryUsage();
+		REQUIRE(mappedUsage.total() == usage.total());
+		REQUIRE(mappedUsage.BuildPeak == 0);
+	}
+}
+
+// Bytes allocated by every form of operator new, each allocation carries its size and its offset into the block of
+// malloc in front, so every form of operator delete can take any of them
+static std::atomic<size_t> AllocatedBytes{0};
+static std::atomic<size_t> PeakAllocatedBytes{0};
+
+// nullptr if malloc fails
+static void *CountedAllocate(const size_t size, const size_t alignment) noexcept {
+	constexpr size_t header = 2 * sizeof(size_t);
+	auto *const block = static_cast<char *>(std::malloc(size + header + alignment));
+	if(!block)
+		return nullptr;
+	// The first address behind the header with the alignment, a power of 2
+	const auto offset = ((std::uintptr_t(block) + header + alignment - 1) & ~std::uintptr_t(alignment - 1)) - std::uintptr_t(block);
+	auto *const pointer = block + offset;
+	reinterpret_cast<size_t *>(pointer)[-1] = offset;
+	reinterpret_cast<size_t *>(pointer)[-2] = size;
+	const auto allocated = AllocatedBytes += size;
+	auto peak = PeakAllocatedBytes.load();
+	while(allocated > peak && !PeakAllocatedBytes.compare_exchange_weak(peak, allocated)) {}
+	return pointer;
+}
+
+static void CountedFree(void *const pointer) noexcept {
+	if(!pointer)
+		return;
+	AllocatedBytes -= static_cast<size_t *>(pointer)[-2];
+	std::free(static_cast<char *>(pointer) - static_cast<size_t *>(pointer)[-1]);
+}
+
+static void *CountedAllocateOrThrow(const size_t size, const size_t alignment) {
+	if(const auto pointer = CountedAllocate(size, alignment))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void *operator new(const size_t size) { return CountedAllocateOrThrow(size, alignof(std::max_align_t)); }
+void *operator new[](const size_t size) { return CountedAllocateOrThrow(size, alignof(std::max_align_t)); }
+void *operator new(const size_t size, const std::nothrow_t &) noexcept { return CountedAllocate(size, alignof(std::max_align_t)); }
+void *operator new[](const size_t size, const std::nothrow_t &) noexcept { return CountedAllocate(size, alignof(std::max_align_t)); }
+void *operator new(const size_t size, const std::align_val_t alignment) { return CountedAllocateOrThrow(size, size_t(alignment)); }
+void *operator new[](const size_t size, const std::align_val_t alignment) { return CountedAllocateOrThrow(size, size_t(alignment)); }
+void *operator new(const size_t size, const std::align_val_t alignment, const std::nothrow_t &) noexcept { return CountedAllocate(size, size_t(alignment)); }
+void *operator new[](const size_t size, const std::align_val_t alignment, const std::nothrow_t &) noexcept { return CountedAllocate(size, size_t(alignment)); }
+
+void operator delete(void *pointer) noexcept { CountedFree(pointer); }
+void operator delete[](void *pointer) noexcept { CountedFree(pointer); }
+void operator delete(void *pointer, size_t) noexcept { CountedFree(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { CountedFree(pointer); }
+void operator delete(void *pointer, const std::nothrow_t &) noexcept { CountedFree(pointer); }
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept { CountedFree(pointer); }
+void operator delete(void *pointer, std::align_val_t) noexcept { CountedFree(pointer); }
+void operator delete[](void *pointer, std::align_val_t) noexcept { CountedFree(pointer); }
+void operator delete(void *pointer, size_t, std::align_val_t) noexcept { CountedFree(pointer); }
+void operator delete[](void *pointer, size_t, std::align_val_t) noexcept { CountedFree(pointer); }
+void operator delete(void *pointer, std::align_val_t, const std::nothrow_t &) noexcept { CountedFree(pointer); }
+void operator delete[](void *pointer, std::align_val_t, const std::nothrow_t &) noexcept { CountedFree(pointer); }
+
+// Most bytes allocated at once by f on top of what was allocated before
+template<typename F>
+static size_t PeakAllocation(F f) {
+	const auto before = AllocatedBytes.load();
+	PeakAllocatedBytes = before;
+	f();
+	return PeakAllocatedBytes - before;
+}
+
+TEST_CASE("build peak bounds the allocations on repetitive text", "[Search]") {
+	CatalogOptions catalogOptions;
+	catalogOptions.Characters = 20000;
+	const auto catalog = GenerateCatalog(catalogOptions);
+	// Duplicated items, the radix sorts give up for SA-IS
+	std::u16string text;
+	for(auto i = 0; i < 16; ++i)
+		text += catalog;
+
+	BuildOptions options;
+	options.Algorithm = GENERATE(SuffixSortAlgorithm::Radix, SuffixSortAlgorithm::AlphabetRadix, SuffixSortAlgorithm::CachedKeyRadix,
+		SuffixSortAlgorithm::InducedSorting);
+	options.Threads = GENERATE(1u, 2u);
+	options.LcpSearch = GENERATE(false, true);
+	std::vector<Index> expected(text.size());
+	SuffixSortInducedSorting(text, expected);
+
+	size_t buildPeak = 0;
+	bool sorted = false;
+	const auto allocated = PeakAllocation([&]() {
+		const Search search(text, options);
+		buildPeak = search.memoryUsage().BuildPeak;
+		sorted = std::equal(expected.begin(), expected.end(), search.suffixArray().begin());
+	});
+	REQUIRE(sorted);
+	REQUIRE(allocated <= buildPeak);
+}
+
+TEST_CASE("generated catalogs are deterministic", "[Corpus]") {
+	CatalogOptions options;
+	options.Characters = 50000;
+	const auto catalog = GenerateCatalog(options);
+	REQUIRE(catalog.size() >= options.Characters);
+	REQUIRE(catalog.back() == u'\0');
+	REQUIRE(GenerateCatalog(options) == catalog);
+
+	options.Seed = 7;
+	REQUIRE(GenerateCatalog(options) != catalog);
+
+	SECTION("queries are found in the catalog") {
+		const Search search(catalog);
+		const auto kind = GENERATE(CatalogQuery::Substring, CatalogQuery::WordPrefix);
+		const auto queries = GenerateCatalogQueries(catalog, kind, 200);
+		REQUIRE(queries.size() == 200);
+		REQUIRE(GenerateCatalogQueries(catalog, kind, 200) == queries);
+		for(const auto &query : queries)
+			REQUIRE(search.find(query).size() != 0);
+	}
+
+	SECTION("misses are not in the catalog") {
+		const Search search(catalog);
+		for(const auto &query : GenerateCatalogQueries(catalog, CatalogQuery::Miss, 200))
+			REQUIRE(search.find(query).size() == 0);
+	}
+
+	SECTION("keywords are words of one item") {
+		for(const auto &query : GenerateCatalogQueries(catalog, CatalogQuery::Keywords, 200)) {
+			REQUIRE_FALSE(query.empty());
+			REQUIRE(query.find(u'\0') == std::u16string::npos);
+		}
+	}
+}
+
+TEST_CASE("histogram buckets", "[Statistics]") {
+	std::vector<std::uint64_t> values(10000);
+	std::iota(values.begin(), values.end(), 0);
+	for(size_t shift = 14; shift < 40; ++shift)
+		values.insert(values.end(), {(std::uint64_t(1) << shift) - 1, std::uint64_t(1) << shift, (std::uint64_t(5) << shift) / 4});
+
+	for(const auto value : values) {
+		const auto bucket = HistogramBucket(value);
+		REQUIRE(HistogramBucketLowerBound(bucket) <= value);
+		REQUIRE(value < HistogramBucketLowerBound(bucket + 1));
+		REQUIRE(HistogramBucketLowerBound(bucket + 1) - HistogramBucketLowerBound(bucket) <= std::max<std::uint64_t>(1, value / 4));
+	}
+	REQUIRE(HistogramBucket(std::numeric_limits<std::uint64_t>::max()) == api::HistogramBuckets - 1);
+
+	AtomicHistogram atomic;
+	for(std::uint64_t value = 1; value <= 1000; ++value)
+		atomic.record(value);
+	api::Histogram histogram;
+	atomic.snapshot(histogram, true);
+	REQUIRE(histogram.Count == 1000);
+	REQUIRE(histogram.Sum == 500500);
+	REQUIRE(histogram.Max == 1000);
+	REQUIRE(HistogramPercentile(histogram, 0) == 1);
+	REQUIRE(HistogramPercentile(histogram, 50) >= 500);
+	REQUIRE(HistogramPercentile(histogram, 50) <= 625);
+	REQUIRE(HistogramPercentile(histogram, 99) >= 990);
+	REQUIRE(HistogramPercentile(histogram, 100) == 1000);
+
+	atomic.snapshot(histogram, false);
+	REQUIRE(histogram.Count == 0);
+	REQUIRE(HistogramPercentile(histogram, 50) == 0);
+}
+
+TEST_CASE("query statistics", "[Statistics]") {
+	QueryStatistics statistics;
+	QueryMeasurement measurement;
+	measurement.Phases = 1u << unsigned(QueryPhase::Find);
+	measurement.Nanoseconds[size_t(QueryPhase::Find)] = 100;
+	measurement.TotalNanoseconds = 150;
+	measurement.ItemsEmitted = 3;
+	statistics.record(measurement);
+	statistics.recordRangeSize(10);
+
+	api::InstanceStatistics snapshot;
+	statistics.snapshot(snapshot, false);
+	REQUIRE(snapshot.Queries == 0);
+	REQUIRE(snapshot.RangeSizes.Count == 0);
+
+	statistics.enable(true);
+	statistics.record(measurement);
+	measurement.Status = api::Result::OffsetOutOfBounds;
+	statistics.record(measurement);
+	statistics.recordRangeSize(10);
+
+	statistics.snapshot(snapshot, true);
+	REQUIRE(snapshot.Queries == 2);
+	REQUIRE(snapshot.Failures == 1);
+	REQUIRE(snapshot.ItemsEmitted == 6);
+	REQUIRE(snapshot.RangeSizes.Count == 1);
+	REQUIRE(snapshot.Find.Count == 2);
+	REQUIRE(snapshot.Find.Sum == 200);
+	REQUIRE(snapshot.Parse.Count == 0);
+	REQUIRE(snapshot.Total.Max == 150);
+
+	statistics.snapshot(snapshot, false);
+	REQUIRE(snapshot.Queries == 0);
+	REQUIRE(snapshot.Find.Count == 0);
+}
+
+TEST_CASE("query statistics of concurrent threads add up", "[Statistics]") {
+	QueryStatistics statistics;
+	statistics.enable(true);
+	QueryMeasurement measurement;
+	measurement.Phases = 1u << unsigned(QueryPhase::Find);
+	measurement.ItemsEmitted = 2;
+
+	std::vector<std::thread> threads;
+	for(std::uint64_t t = 1; t <= 12; ++t) {
+		threads.emplace_back([&, t]() {
+			auto own = measurement;
+			own.Nanoseconds[size_t(QueryPhase::Find)] = t;
+			own.TotalNanoseconds = t * 10;
+			for(auto i = 0; i < 1000; ++i)
+				statistics.record(own);
+		});
+	}
+	for(auto &thread : threads)
+		thread.join();
+
+	api::InstanceStatistics snapshot;
+	statistics.snapshot(snapshot, true);
+	REQUIRE(snapshot.Queries == 12000);
+	REQUIRE(snapshot.ItemsEmitted == 24000);
+	REQUIRE(snapshot.Find.Count == 12000);
+	REQUIRE(snapshot.Find.Sum == 78000);
+	REQUIRE(snapshot.Find.Max == 12);
+	REQUIRE(snapshot.Total.Max == 120);
+	REQUIRE(std::accumulate(std::begin(snapshot.Find.Buckets), std::end(snapshot.Find.Buckets), std::uint64_t(0)) == 12000);
+
+	statistics.snapshot(snapshot, false);
+	REQUIRE(snapshot.Queries == 0);
+	REQUIRE(snapshot.Find.Max == 0);
+}
+
+TEST_CASE("keyword cache", "[KeywordCache]") {
+	const auto items = [](const std::initializer_list<Index> list) {
+		return std::make_shared<const std::vector<Index>>(list);
+	};
+	api::KeywordCacheStatistics statistics;
+
+	SECTION("hits and misses are counted") {
+		KeywordCache cache(16, 1024);
+		REQUIRE_FALSE(cache.find(u"daft"));
+		cache.insert(u"daft", CachedKeyword{3, 7, nullptr});
+		const auto range = cache.find(u"daft");
+		REQUIRE(range);
+		REQUIRE(range->First == 3);
+		REQUIRE(range->Last == 7);
+		REQUIRE(range->Items == nullptr);
+
+		cache.insert(u"daft", CachedKeyword{3, 7, items({1, 2})});
+		const auto withItems = cache.find(u"daft");
+		REQUIRE(withItems->Items->size() == 2);
+
+		cache.snapshot(statistics, true);
+		REQUIRE(statistics.Hits == 2);
+		REQUIRE(statistics.ItemHits == 1);
+		REQUIRE(statistics.Misses == 1);
+		REQUIRE(statistics.Entries == 1);
+		REQUIRE(statistics.Items == 2);
+		REQUIRE(statistics.Capacity >= 16);
+
+		cache.snapshot(statistics, false);
+		REQUIRE(statistics.Hits == 0);
+		REQUIRE(statistics.Entries == 1);
+	}
+
+	SECTION("the least recently used keywords are evicted") {
+		KeywordCache cache(8, 1024);
+		std::vector<std::u16string> keywords;
+		for(char16_t c = u'a'; c <= u'z'; ++c)
+			keywords.emplace_back(1, c);
+		for(const auto &keyword : keywords)
+			cache.insert(keyword, CachedKeyword{0, 1, nullptr});
+
+		cache.snapshot(statistics, false);
+		REQUIRE(statistics.Entries <= statistics.Capacity);
+		REQUIRE(statistics.Entries > 0);
+		// Every shard keeps its newest keyword
+		REQUIRE(cache.find(keywords.back()));
+	}
+
+	SECTION("items are bounded") {
+		KeywordCache cache(64, 64);
+		REQUIRE(cache.maxItems() == 2);
+		cache.insert(u"big", CachedKeyword{0, 3, items({1, 2, 3})});
+		REQUIRE(cache.find(u"big")->Items == nullptr);
+
+		for(Index i = 0; i < 100; ++i)
+			cache.insert(std::u16string(1, char16_t(u'a' + i)), CachedKeyword{0, 2, items({i, i + 1})});
+		cache.snapshot(statistics, false);
+		REQUIRE(statistics.Items <= statistics.ItemCapacity);
+	}
+
+	SECTION("clear drops every entry") {
+		KeywordCache cache(16, 1024);
+		cache.insert(u"daft", CachedKeyword{0, 2, items({1, 2})});
+		cache.clear();
+		REQUIRE_FALSE(cache.find(u"daft"));
+		cache.snapshot(statistics, false);
+		REQUIRE(statistics.Entries == 0);
+		REQUIRE(statistics.Items == 0);
+
+		cache.insert(u"punk", CachedKeyword{0, 1, nullptr});
+		REQUIRE(cache.find(u"punk"));
+	}
+
+	SECTION("a cache without entries stays empty") {
+		KeywordCache cache(0, 0);
+		cache.insert(u"daft", CachedKeyword{0, 1, nullptr});
+		REQUIRE_FALSE(cache.find(u"daft"));
+	}
+}
+
+#ifdef TEST_API
+// Destroys the instance at the end of the scope, also if a REQUIRE fails
+using InstancePtr = std::unique_ptr<void, decltype(&DestroySearchInstance)>;
+
+static InstancePtr CreateInstance(const std::u16string &text, const api::InstanceOptions *options) {
+	return InstancePtr(CreateSearchInstanceFromText(text.data(), text.size(), options, [](const char *) {}), &DestroySearchInstance);
+}
+
+TEST_CASE("keyword queries without keywords find nothing", "[Api]") {
+	const auto text = RandomItems(2000, u'a', 73);
+	api::InstanceOptions options{};
+	options.QueryThreads = 2;
+	const auto instance = CreateInstance(text, &options);
+	const auto matching = GENERATE(api::KeywordsMatch::All, api::KeywordsMatch::AtLeastOne);
+	const auto pattern = GENERATE(u""s, u" "s, u"   "s);
+
+	std::vector<Index> output(10);
+	api::FindUniqueItemsResult result{1, 1, 1};
+	REQUIRE(FindUniqueItemsKeywords(instance.get(), pattern.data(), pattern.size(), output.data(), output.size(), matching, 0, &result, nullptr) == api::Result::Ok);
+	REQUIRE(result.TotalResults == 0);
+	REQUIRE(result.Count == 0);
+
+	// The queries of a batch run on the pool of the instance
+	const std::vector<api::BatchQuery> queries(8, api::BatchQuery{pattern.data(), pattern.size(), output.data(), output.size(), 0});
+	std::vector<api::BatchQueryResult> results(queries.size());
+	REQUIRE(FindUniqueItemsKeywordsBatch(instance.get(), queries.data(), queries.size(), matching, results.data()) == api::Result::Ok);
+	for(const auto &batchResult : results) {
+		REQUIRE(batchResult.Status == api::Result::Ok);
+		REQUIRE(batchResult.Items.TotalResults == 0);
+	}
+}
+
+TEST_CASE("batches match single queries", "[Api]") {
+	CatalogOptions catalogOptions;
+	catalogOptions.Characters = 50000;
+	const auto catalog = GenerateCatalog(catalogOptions);
+	api::InstanceOptions options{};
+	options.Threads = 1;
+	options.QueryThreads = GENERATE(0u, 1u, 3u);
+	const auto instance = CreateInstance(catalog, &options);
+	const auto matching = GENERATE(api::KeywordsMatch::All, api::KeywordsMatch::AtLeastOne);
+
+	const auto patterns = GenerateCatalogQueries(catalog, CatalogQuery::Keywords, 100);
+	std::vector<std::vector<Index>> outputs(patterns.size(), std::vector<Index>(20));
+	std::vector<api::BatchQuery> queries;
+	for(size_t i = 0; i < patterns.size(); ++i)
+		queries.push_back(api::BatchQuery{patterns[i].data(), patterns[i].size(), outputs[i].data(), outputs[i].size(), unsigned(i % 3)});
+	// Failed queries only fail their own result
+	queries[5].Pattern = nullptr;
+	queries[7].Output = nullptr;
+	std::vector<api::BatchQueryResult> results(queries.size());
+
+	const auto check = [&](const auto single) {
+		for(size_t i = 0; i < queries.size(); ++i) {
+			INFO("Query " << i);
+			if(i == 5 || (i == 7 && queries[i].Output == nullptr)) {
+				REQUIRE(results[i].Status == api::Result::NullPointer);
+				continue;
+			}
+			std::vector<Index> expected(outputs[i].size());
+			api::FindUniqueItemsResult expectedResult{};
+			REQUIRE(results[i].Status == single(patterns[i], expected, queries[i].Offset, expectedResult));
+			REQUIRE(results[i].Items.TotalResults == expectedResult.TotalResults);
+			REQUIRE(results[i].Items.Count == expectedResult.Count);
+			CollectionsEqual(outputs[i].begin(), outputs[i].begin() + results[i].Items.Count, expected.begin(), expected.begin() + expectedResult.Count);
+		}
+	};
+
+	SECTION("CountOccurencesBatch") {
+		// Only the pattern is needed
+		queries[7].Output = outputs[7].data();
+		REQUIRE(CountOccurencesBatch(instance.get(), queries.data(), queries.size(), results.data()) == api::Result::Ok);
+		check([&](const std::u16string &pattern, std::vector<Index> &, unsigned int, api::FindUniqueItemsResult &result) {
+			int count = 0;
+			const auto status = CountOccurences(instance.get(), pattern.data(), pattern.size(), &count);
+			result.TotalResults = size_t(count);
+			return status;
+		});
+	}
+
+	SECTION("FindUniqueItemsBatch") {
+		REQUIRE(FindUniqueItemsBatch(instance.get(), queries.data(), queries.size(), results.data()) == api::Result::Ok);
+		check([&](const std::u16string &pattern, std::vector<Index> &output, const unsigned int offset, api::FindUniqueItemsResult &result) {
+			return FindUniqueItems(instance.get(), pattern.data(), pattern.size(), output.data(), output.size(), &result, offset, nullptr);
+		});
+	}
+
+	SECTION("FindUniqueItemsKeywordsBatch") {
+		REQUIRE(FindUniqueItemsKeywordsBatch(instance.get(), queries.data(), queries.size(), matching, results.data()) == api::Result::Ok);
+		check([&](const std::u16string &pattern, std::vector<Index> &output, const unsigned int offset, api::FindUniqueItemsResult &result) {
+			return FindUniqueItemsKeywords(instance.get(), pattern.data(), pattern.size(), output.data(), output.size(), matching, offset, &result, nullptr);
+		});
+	}
+
+	SECTION("missing arrays") {
+		REQUIRE(CountOccurencesBatch(instance.get(), nullptr, queries.size(), results.data()) == api::Result::NullPointer);
+		REQUIRE(FindUniqueItemsBatch(instance.get(), queries.data(), queries.size(), nullptr) == api::Result::NullPointer);
+		REQUIRE(FindUniqueItemsKeywordsBatch(instance.get(), queries.data(), 0, matching, results.data()) == api::Result::Ok);
+	}
+}
+
+TEST_CASE("options are read as far as their size goes", "[Api]") {
+	api::InstanceOptions options{};
+	options.Engine = api::SearchEngine::FmIndex;
+	api::MemoryUsage usage{};
+	REQUIRE(EstimateInstanceMemoryUsage(100000, 1000, &options, &usage) == api::Result::Ok);
+	REQUIRE(usage.Bwt != 0);
+
+	// A caller from before Engine builds suffix arrays
+	options.StructSize = offsetof(api::InstanceOptions, Engine);
+	REQUIRE(EstimateInstanceMemoryUsage(100000, 1000, &options, &usage) == api::Result::Ok);
+	REQUIRE(usage.Bwt == 0);
+	api::MemoryUsage defaults{};
+	REQUIRE(EstimateInstanceMemoryUsage(100000, 1000, nullptr, &defaults) == api::Result::Ok);
+	REQUIRE(usage.Total == defaults.Total);
+}
+
+TEST_CASE("query sessions match searching every pattern", "[Api]") {
+	CatalogOptions catalogOptions;
+	catalogOptions.Characters = 50000;
+	const auto catalog = GenerateCatalog(catalogOptions);
+	api::InstanceOptions options{};
+	options.Threads = 1;
+	options.LcpSearch = GENERATE(false, true);
+	options.Engine = GENERATE(api::SearchEngine::SuffixArray, api::SearchEngine::FmIndex);
+	const auto instance = CreateInstance(catalog, &options);
+	const std::unique_ptr<void, decltype(&EndQuerySession)> session(BeginQuerySession(instance.get()), &EndQuerySession);
+	REQUIRE(session);
+
+	std::vector<Index> expected(20);
+	std::vector<Index> output(20);
+	const auto check = [&](const std::u16string &pattern, const size_t occurrences) {
+		INFO("Pattern " << std::string(pattern.begin(), pattern.end()));
+		int count = 0;
+		REQUIRE(CountOccurences(instance.get(), pattern.data(), pattern.size(), &count) == api::Result::Ok);
+		REQUIRE(occurrences == size_t(count));
+
+		for(const auto offset : {0u, 20u}) {
+			api::FindUniqueItemsResult expectedResult{};
+			api::FindUniqueItemsResult result{};
+			// Offsets behind the items fail the same way
+			const auto status = FindUniqueItems(instance.get(), pattern.data(), pattern.size(), expected.data(), expected.size(), &expectedResult, offset,
+				nullptr);
+			REQUIRE(FindSessionItems(session.get(), output.data(), output.size(), offset, &result) == status);
+			REQUIRE(result.TotalResults == expectedResult.TotalResults);
+			REQUIRE(result.Count == expectedResult.Count);
+			REQUIRE(result.Consumed == expectedResult.Consumed);
+			CollectionsEqual(output.begin(), output.begin() + result.Count, expected.begin(), expected.begin() + expectedResult.Count);
+		}
+	};
+
+	std::mt19937 gen(41);
+	for(const auto &query : GenerateCatalogQueries(catalog, CatalogQuery::WordPrefix, 50)) {
+		std::u16string typed;
+		size_t occurrences = 0;
+		REQUIRE(SetQuery(session.get(), typed.data(), typed.size(), &occurrences) == api::Result::Ok);
+		// Typed one character at a time, now and then a character is deleted again
+		for(const auto character : query) {
+			typed += character;
+			REQUIRE(ExtendQuery(session.get(), &character, 1, &occurrences) == api::Result::Ok);
+			check(typed, occurrences);
+			if(gen() % 4 == 0 && typed.size() > 1) {
+				typed.pop_back();
+				REQUIRE(SetQuery(session.get(), typed.data(), typed.size(), &occurrences) == api::Result::Ok);
+				check(typed, occurrences);
+				typed += character;
+				REQUIRE(ExtendQuery(session.get(), &character, 1, &occurrences) == api::Result::Ok);
+			}
+		}
+		check(typed, occurrences);
+	}
+}
+
+TEST_CASE("cursor pages add up to the unique items", "[Api]") {
+	CatalogOptions catalogOptions;
+	catalogOptions.Characters = 50000;
+	const auto catalog = GenerateCatalog(catalogOptions);
+	api::InstanceOptions options{};
+	options.Threads = 1;
+	options.Engine = GENERATE(api::SearchEngine::SuffixArray, api::SearchEngine::FmIndex);
+	const auto instance = CreateInstance(catalog, &options);
+	const auto pageSize = GENERATE(size_t(1), size_t(7), size_t(100));
+
+	for(const auto &pattern : GenerateCatalogQueries(catalog, CatalogQuery::WordPrefix, 50)) {
+		INFO("Pattern " << std::string(pattern.begin(), pattern.end()));
+		int occurrences = 0;
+		REQUIRE(CountOccurences(instance.get(), pattern.data(), pattern.size(), &occurrences) == api::Result::Ok);
+		std::vector<Index> expected(static_cast<size_t>(occurrences));
+		api::FindUniqueItemsResult result{};
+		REQUIRE(FindUniqueItems(instance.get(), pattern.data(), pattern.size(), expected.data(), expected.size(), &result, 0, nullptr) == api::Result::Ok);
+		expected.resize(result.Count);
+
+		const std::unique_ptr<void, decltype(&CursorClose)> cursor(OpenCursor(instance.get(), pattern.data(), pattern.size(), nullptr), &CursorClose);
+		REQUIRE(cursor);
+		std::vector<Index> pages;
+		std::vector<Index> page(pageSize);
+		size_t written = 0;
+		do {
+			REQUIRE(CursorNext(cursor.get(), page.data(), page.size(), &written) == api::Result::Ok);
+			REQUIRE(written <= page.size());
+			pages.insert(pages.end(), page.begin(), page.begin() + written);
+		} while(written != 0);
+		REQUIRE(pages == expected);
+
+		std::sort(pages.begin(), pages.end());
+		REQUIRE(std::adjacent_find(pages.begin(), pages.end()) == pages.end());
+	}
+}
+
+TEST_CASE("the keyword cache can be replaced while queries run", "[Api]") {
+	CatalogOptions catalogOptions;
+	catalogOptions.Characters = 50000;
+	const auto catalog = GenerateCatalog(catalogOptions);
+	const auto patterns = GenerateCatalogQueries(catalog, CatalogQuery::Keywords, 200, 5);
+	const auto instance = CreateInstance(catalog, nullptr);
+
+	using Answer = std::vector<Index>;
+	const auto answer = [&](const std::u16string &pattern) {
+		Answer output(20);
+		api::FindUniqueItemsResult result{};
+		FindUniqueItemsKeywords(instance.get(), pattern.data(), pattern.size(), output.data(), output.size(), api::KeywordsMatch::All, 0, &result, nullptr);
+		output.resize(result.Count);
+		return output;
+	};
+	std::vector<Answer> expected;
+	for(const auto &pattern : patterns)
+		expected.emplace_back(answer(pattern));
+
+	std::vector<std::vector<Answer>> answers(3);
+	std::vector<std::thread> threads;
+	for(size_t t = 0; t < answers.size(); ++t) {
+		threads.emplace_back([&, t]() {
+			for(auto round = 0; round < 3; ++round) {
+				for(const auto &pattern : patterns)
+					answers[t].emplace_back(answer(pattern));
+			}
+		});
+	}
+	for(auto i = 0; i < 50; ++i)
+		SetKeywordCacheCapacity(instance.get(), size_t(i % 3) * 64, 4096);
+	for(auto &thread : threads)
+		thread.join();
+
+	for(const auto &threadAnswers : answers) {
+		for(size_t i = 0; i < threadAnswers.size(); ++i)
+			REQUIRE(threadAnswers[i] == expected[i % patterns.size()]);
+	}
+}
+
+TEST_CASE("replaced keyword caches are freed", "[Api]") {
+	const auto instance = CreateInstance(RandomItems(2000, u'a', 73), nullptr);
+	SetKeywordCacheCapacity(instance.get(), 64, 4096);
+	const auto allocated = AllocatedBytes.load();
+	for(auto i = 0; i < 100; ++i)
+		SetKeywordCacheCapacity(instance.get(), 64, 4096);
+	REQUIRE(AllocatedBytes.load() == allocated);
+}
+
+TEST_CASE("saved instances are verified", "[Api]") {
+	const auto instance = CreateInstance(RandomItems(2000, u'a', 73), nullptr);
+	const TempIndexFile indexFile;
+	REQUIRE(SaveSearchInstance(instance.get(), indexFile.path()) == api::Result::Ok);
+	REQUIRE(VerifySearchInstanceFile(indexFile.path(), nullptr) == api::Result::Ok);
+	REQUIRE(VerifySearchInstanceFile(nullptr, nullptr) == api::Result::NullPointer);
+
+	const TempIndexFile missing;
+	REQUIRE(VerifySearchInstanceFile(missing.path(), [](const char *) {}) == api::Result::IoError);
+}
+#endif
+
 #pragma warning(pop)
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace stringsearch {
+	namespace {
+		// Pool and queue of the current thread, used to push tasks submitted from a task to the own deque
+		thread_local const WorkStealingPool *CurrentPool = nullptr;
+		thread_local size_t CurrentQueue = 0;
+	}
+
+	unsigned int ResolveThreadCount(const unsigned int threads) noexcept {
+		if(threads != 0)
+			return threads;
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	WorkStealingPool::WorkStealingPool(const unsigned int threads) {
+		const auto count = ResolveThreadCount(threads);
+		queues_.reserve(count);
+		for(size_t i = 0; i < count; ++i)
+			queues_.emplace_back(std::make_unique<Queue>());
+
+		workers_.reserve(count - 1);
+		for(size_t i = 1; i < count; ++i)
+			workers_.emplace_back([this, i]() { work(i); });
+	}
+
+	WorkStealingPool::~WorkStealingPool() noexcept {
+		{
+			std::lock_guard lock(sleepMutex_);
+			stop_ = true;
+		}
+		sleep_.notify_all();
+		for(auto &worker : workers_)
+			worker.join();
+	}
+
+	size_t WorkStealingPool::currentQueue() const noexcept {
+		return CurrentPool == this ? CurrentQueue : 0;
+	}
+
+	void WorkStealingPool::submit(std::function<void()> task) {
+		pending_.fetch_add(1, std::memory_order_relaxed);
+		{
+			auto &queue = *queues_[currentQueue()];
+			std::lock_guard lock(queue.Mutex);
+			queue.Tasks.emplace_back(std::move(task));
+		}
+		queued_.fetch_add(1, std::memory_order_release);
+
+		// Taking the lock orders the notification after a worker checked its wait condition
+		{ std::lock_guard lock(sleepMutex_); }
+		sleep_.notify_one();
+	}
+
+	bool WorkStealingPool::tryPop(const size_t queue, std::function<void()> &task) {
+		auto &q = *queues_[queue];
+		std::lock_guard lock(q.Mutex);
+		if(q.Tasks.empty())
+			return false;
+
+		task = std::move(q.Tasks.back());
+		q.Tasks.pop_back();
+		return true;
+	}
+
+	bool WorkStealingPool::trySteal(const size_t thief, std::function<void()> &task) {
+		for(size_t i = 1; i < queues_.size(); ++i) {
+			auto &q = *queues_[(thief + i) % queues_.size()];
+			std::lock_guard lock(q.Mutex);
+			if(q.Tasks.empty())
+				continue;
+
+			task = std::move(q.Tasks.front());
+			q.Tasks.pop_front();
+			return true;
+		}
+		return false;
+	}
+
+	bool WorkStealingPool::tryRunOne(const size_t queue) {
+		std::function<void()> task;
+		if(!tryPop(queue, task) && !trySteal(queue, task))
+			return false;
+
+		queued_.fetch_sub(1, std::memory_order_relaxed);
+		task();
+		pending_.fetch_sub(1, std::memory_order_acq_rel);
+		return true;
+	}
+
+	void WorkStealingPool::work(const size_t queue) {
+		CurrentPool = this;
+		CurrentQueue = queue;
+
+		while(true) {
+			if(tryRunOne(queue))
+				continue;
+
+			std::unique_lock lock(sleepMutex_);
+			sleep_.wait(lock, [&]() { return stop_ || queued_.load(std::memory_order_acquire) != 0; });
+			if(stop_)
+				return;
+		}
+	}
+
+	void WorkStealingPool::wait() {
+		const auto previousPool = CurrentPool;
+		const auto previousQueue = CurrentQueue;
+		CurrentPool = this;
+		CurrentQueue = 0;
+
+		while(pending_.load(std::memory_order_acquire) != 0) {
+			if(!tryRunOne(0))
+				std::this_thread::yield();
+		}
+
+		CurrentPool = previousPool;
+		CurrentQueue = previousQueue;
+	}
+}
\ No newline at end of file
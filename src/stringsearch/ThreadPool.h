@@ -0,0 +1,65 @@
+#pragma once
+#include "stringsearch/Definitions.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace stringsearch {
+	// Fork-join pool. Every thread owns a deque of tasks: tasks submitted from a worker are pushed to and popped from
+	// the back of its own deque, idle threads steal from the front of the others. The thread calling wait() participates.
+	class WorkStealingPool {
+		struct Queue {
+			std::mutex Mutex;
+			std::deque<std::function<void()>> Tasks;
+		};
+
+		std::vector<std::unique_ptr<Queue>> queues_;
+		std::vector<std::thread> workers_;
+		std::atomic<size_t> queued_{0};
+		std::atomic<size_t> pending_{0};
+		std::mutex sleepMutex_;
+		std::condition_variable sleep_;
+		bool stop_ = false;
+
+		[[nodiscard]] size_t currentQueue() const noexcept;
+
+		bool tryPop(size_t queue, std::function<void()> &task);
+
+		bool trySteal(size_t thief, std::function<void()> &task);
+
+		bool tryRunOne(size_t queue);
+
+		void work(size_t queue);
+
+	public:
+		// threads includes the thread calling wait(), 0 uses all hardware threads
+		explicit WorkStealingPool(unsigned int threads);
+		~WorkStealingPool() noexcept;
+
+		DISABLE_COPY(WorkStealingPool);
+		DISABLE_MOVE(WorkStealingPool);
+
+		[[nodiscard]] size_t threadCount() const noexcept { return queues_.size(); }
+
+		void submit(std::function<void()> task);
+
+		// Runs tasks until all submitted tasks, including the ones they submitted, are done
+		void wait();
+
+		// Calls f(i) for every i in [0, count) and waits for all of them. Must not be called from inside a task.
+		template<typename F>
+		void parallelFor(const size_t count, F &&f) {
+			for(size_t i = 0; i < count; ++i)
+				submit([&f, i]() { f(i); });
+			wait();
+		}
+	};
+
+	[[nodiscard]] unsigned int ResolveThreadCount(unsigned int threads) noexcept;
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "stringsearch/WaveletMatrix.hpp"
+
+namespace stringsearch {
+	size_t WaveletMatrix::LevelCount(size_t maxValue) noexcept {
+		size_t levels = 0;
+		for(; maxValue != 0; maxValue >>= 1)
+			++levels;
+		return levels;
+	}
+
+	template<typename T>
+	WaveletMatrix::WaveletMatrix(std::vector<T> values, const size_t levels)
+		: size_(values.size()),
+			levels_(levels) {
+		std::vector<std::uint64_t> words(BitVector::WordCount(levels * size_));
+		std::vector<T> partitioned(size_);
+		for(size_t level = 0; level < levels; ++level) {
+			const auto shift = levels - 1 - level;
+			const auto offset = level * size_;
+			size_t zeros = 0;
+			for(size_t i = 0; i < size_; ++i) {
+				if((values[i] >> shift & 1) == 0) {
+					partitioned[zeros++] = values[i];
+				} else {
+					const auto bit = offset + i;
+					words[bit / BitVector::WordBits] |= std::uint64_t(1) << (bit % BitVector::WordBits);
+				}
+			}
+
+			auto ones = zeros;
+			for(size_t i = 0; i < size_; ++i) {
+				if((values[i] >> shift & 1) != 0)
+					partitioned[ones++] = values[i];
+			}
+			values.swap(partitioned);
+		}
+
+		bits_ = BitVector(std::move(words), levels * size_);
+		countLevels();
+	}
+
+	template WaveletMatrix::WaveletMatrix(std::vector<Index> values, size_t levels);
+	template WaveletMatrix::WaveletMatrix(std::vector<std::int64_t> values, size_t levels);
+
+	WaveletMatrix::WaveletMatrix(BitVector bits, const size_t size, const size_t levels)
+		: bits_(std::move(bits)),
+			size_(size),
+			levels_(levels) {
+		countLevels();
+	}
+
+	void WaveletMatrix::countLevels() {
+		levelRanks_.resize(levels_ + 1);
+		zeros_.resize(levels_);
+		for(size_t level = 0; level <= levels_; ++level)
+			levelRanks_[level] = bits_.empty() ? 0 : bits_.rank(level * size_);
+		for(size_t level = 0; level < levels_; ++level)
+			zeros_[level] = size_ - (levelRanks_[level + 1] - levelRanks_[level]);
+	}
+
+	size_t WaveletMatrix::countLess(size_t begin, size_t end, const std::uint64_t value) const noexcept {
+		if(levels_ < 64 && value >> levels_ != 0)
+			return end - begin;
+
+		size_t count = 0;
+		for(size_t level = 0; level < levels_ && begin < end; ++level) {
+			const auto offset = level * size_;
+			const auto onesBegin = bits_.rank(offset + begin) - levelRanks_[level];
+			const auto onesEnd = bits_.rank(offset + end) - levelRanks_[level];
+			if((value >> (levels_ - 1 - level) & 1) != 0) {
+				// Values with a 0 bit are smaller, continue with the ones
+				count += (end - begin) - (onesEnd - onesBegin);
+				begin = zeros_[level] + onesBegin;
+				end = zeros_[level] + onesEnd;
+			} else {
+				begin -= onesBegin;
+				end -= onesEnd;
+			}
+		}
+		return count;
+	}
+
+	std::pair<size_t, size_t> WaveletMatrix::rank(const std::uint64_t value, size_t begin, size_t end) const noexcept {
+		if(levels_ < 64 && value >> levels_ != 0)
+			return {0, 0};
+
+		// The values equal to value end up in one run after the last level, first is where it starts
+		size_t first = 0;
+		for(size_t level = 0; level < levels_; ++level) {
+			const auto offset = level * size_;
+			const auto onesFirst = bits_.rank(offset + first) - levelRanks_[level];
+			const auto onesBegin = bits_.rank(offset + begin) - levelRanks_[level];
+			const auto onesEnd = bits_.rank(offset + end) - levelRanks_[level];
+			if((value >> (levels_ - 1 - level) & 1) != 0) {
+				first = zeros_[level] + onesFirst;
+				begin = zeros_[level] + onesBegin;
+				end = zeros_[level] + onesEnd;
+			} else {
+				first -= onesFirst;
+				begin -= onesBegin;
+				end -= onesEnd;
+			}
+		}
+		return {begin - first, end - first};
+	}
+
+	std::pair<std::uint64_t, size_t> WaveletMatrix::accessRank(size_t index) const noexcept {
+		std::uint64_t value = 0;
+		size_t first = 0;
+		for(size_t level = 0; level < levels_; ++level) {
+			const auto offset = level * size_;
+			const auto onesFirst = bits_.rank(offset + first) - levelRanks_[level];
+			const auto onesIndex = bits_.rank(offset + index) - levelRanks_[level];
+			value <<= 1;
+			if(bits_[offset + index]) {
+				value |= 1;
+				first = zeros_[level] + onesFirst;
+				index = zeros_[level] + onesIndex;
+			} else {
+				first -= onesFirst;
+				index -= onesIndex;
+			}
+		}
+		return {value, index - first};
+	}
+}
\ No newline at end of file